@@ -11,6 +11,7 @@
 #include"TFile.h"
 #include"TChain.h"
 #include"TopoAnaReader.h"
+#include"OutputWriter.h"
 
 int main(int argc, char *argv[]) {
   if(argc != 5) {
@@ -29,6 +30,7 @@ int main(int argc, char *argv[]) {
   std::cout << "Saving TTrees...\n";
   TChain Chain(argv[4]);
   Chain.Add(argv[3]);
+  OutputWriter::EnableParallelCompression();
   Reader.SaveAllTrees(&Chain);
   std::cout << "All trees saved\n";
   return 0;
@@ -8,12 +8,15 @@
 #include<memory>
 #include<string>
 #include<utility>
+#include<vector>
 #include<stdexcept>
 #include"TChain.h"
 #include"TTree.h"
 #include"TFile.h"
 #include"Utilities.h"
 #include"Settings.h"
+#include"Instrumentation.h"
+#include"OutputWriter.h"
 #include"PhaseSpace/KKpipi_PhaseSpace.h"
 
 int main(int argc, char *argv[]) {
@@ -30,7 +33,10 @@ int main(int argc, char *argv[]) {
   int SignalBin, TagBin, SignalBin_true, TagBin_true;
   std::vector<std::string> DalitzVariables{"s01", "s03", "s12", "s23", "s012"};
   std::map<std::string, double> DalitzCoordinates, RecDalitzCoordinates;
-  TFile OutputFile(OutputFilename.c_str(), "RECREATE");
+  OutputWriter::EnableParallelCompression();
+  auto OutputFile = OutputWriter::OpenFile(OutputFilename, OutputWriter::Stage::Intermediate);
+  // All branches are copied to the output, so the truth branches must be read for every event
+  InputChain.SetBranchStatus("*", 1);
   TTree *OutputTree = InputChain.CloneTree(0);
   if(settings.getB("Bin_reconstructed")) {
     OutputTree->Branch(SignalBin_Name.c_str(), &SignalBin);
@@ -48,11 +54,16 @@ int main(int argc, char *argv[]) {
       OutputTree->Branch(DalitzVariable.c_str(), &DalitzCoordinates[DalitzVariable]);
     }
   }
+  std::vector<std::string> HotBranches = OutputWriter::GetHotBranches();
+  HotBranches.insert(HotBranches.end(), {SignalBin_Name, TagBin_Name, SignalBin_Name + "_true", TagBin_Name + "_true"});
+  OutputWriter::ConfigureTree(OutputTree, HotBranches);
   int EventsOutsidePhaseSpace = 0;
   int EventsOutsidePhaseSpace_true = 0;
   int NumberExceptions = 0;
   std::cout << "Ready to bin phase space\n";
   int Entries = InputChain.GetEntries();
+  Instrumentation::ScopedTimer Timer("BinDoubleTags::Binning");
+  Timer.AddEvents(Entries);
   for(int i = 0; i < Entries; i++) {
     InputChain.GetEntry(i);
     if(settings.getB("Bin_reconstructed")) {
@@ -93,7 +104,7 @@ int main(int argc, char *argv[]) {
 	DalitzCoordinates[DalitzVariable] = TrueDalitzCoordinates[DalitzVariable];
       }
     }
-    OutputTree->Fill();
+    OutputWriter::FillTree(OutputTree, HotBranches);
   }
   if(settings.getB("Bin_reconstructed")) {
     std::cout << "Reconstructed events outside of phase space: " << EventsOutsidePhaseSpace << "\n";
@@ -102,8 +113,13 @@ int main(int argc, char *argv[]) {
     std::cout << "True events outside of phase space: " << EventsOutsidePhaseSpace_true << "\n";
   }
   std::cout << "Number of events caught and elegantly skipped: " << NumberExceptions << "\n";
+  Timer.Stop();
+  Instrumentation::AddCount("EventsOutsidePhaseSpace", EventsOutsidePhaseSpace);
+  Instrumentation::AddCount("EventsOutsidePhaseSpace_true", EventsOutsidePhaseSpace_true);
+  Instrumentation::AddCount("BinningExceptions", NumberExceptions);
+  Instrumentation::ScopedTimer WriteTimer("BinDoubleTags::Write");
   OutputTree->Write();
-  OutputFile.Close();
+  OutputFile->Close();
   std::cout << "Binning complete\n";
   return 0;
 }
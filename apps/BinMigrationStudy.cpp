@@ -1,7 +1,11 @@
 // Martin Duy Tat 3rd December 2021
 /**
  * BinMigrationStudy is an application that takes in a set of D daughter momenta and smears them before determining the amplitude ratio \f$r_D\f$ and phase difference \f$\delta_D\f$ using the LHCb amplitude model
- * The momenta are space-separated numbers read line by line from a file, and for each line a new TTree is created
+ * The momenta are space-separated numbers read line by line from a file, and all smeared points are saved in a single TTree with the point number and smearing number
+ * Smearing number 0 is the point without smearing, and the entries are in order so that entry PointNumber*(NumberSmearings + 1) + SmearingNumber is that smearing
+ * The smearings are generated and evaluated in chunks in parallel, and every chunk has its own random number generator seeded by the point and chunk number, so the results don't depend on the number of threads
+ * Each thread has its own amplitude model, which assumes that evaluating different instances concurrently is safe
+ * This is checked on the first point by evaluating one chunk again with a single instance, and the study stops if the results differ
  */
 
 #include<iostream>
@@ -10,12 +14,18 @@
 #include<fstream>
 #include<sstream>
 #include<complex>
+#include<cmath>
+#include<algorithm>
+#include<stdexcept>
+#include<omp.h>
 #include"TTree.h"
 #include"TFile.h"
 #include"TH1D.h"
-#include"TRandom.h"
+#include"TRandom3.h"
 #include"Settings.h"
 #include"Utilities.h"
+#include"Instrumentation.h"
+#include"OutputWriter.h"
 #include"Amplitude.h"
 
 int main(int argc, char *argv[]) {
@@ -24,66 +34,120 @@ int main(int argc, char *argv[]) {
   // Vectors defining the order of the particles
   std::vector<std::string> Particles{"Kplus", "Kminus", "piplus", "piminus"};
   std::vector<std::string> Components{"PX", "PY", "PZ", "PE"};
-  std::cout << "Getting the resolution from the resolution histograms...\n";
   std::vector<double> Resolutions;
-  std::string ResolutionFilename = settings.get("ResolutionFilename");
-  TFile ResolutionFile(ResolutionFilename.c_str(), "READ");
-  for(const auto &Particle : Particles) {
-    for(const auto &Component : Components) {
-      TH1D *Histogram = nullptr;
-      ResolutionFile.GetObject((Particle + Component + "_h").c_str(), Histogram);
-      Resolutions.push_back(Histogram->GetStdDev());
+  if(settings.contains("ResolutionSummaryFilename")) {
+    // The summary from MakeResolutionHistograms has the standard deviation of the full sample
+    std::cout << "Getting the resolution from the resolution summary...\n";
+    Settings ResolutionSummary("ResolutionSummary", settings.get("ResolutionSummaryFilename"));
+    for(const auto &Particle : Particles) {
+      for(const auto &Component : Components) {
+	Resolutions.push_back(ResolutionSummary.getD(Particle + Component + "_StdDev"));
+      }
+    }
+  } else {
+    // The statistics of the resolution histograms are the moments of the full sample, including the tails outside the histogram range
+    std::cout << "Getting the resolution from the resolution histograms...\n";
+    std::string ResolutionFilename = settings.get("ResolutionFilename");
+    TFile ResolutionFile(ResolutionFilename.c_str(), "READ");
+    for(const auto &Particle : Particles) {
+      for(const auto &Component : Components) {
+	TH1D *Histogram = nullptr;
+	ResolutionFile.GetObject((Particle + Component + "_h").c_str(), Histogram);
+	Resolutions.push_back(Histogram->GetStdDev());
+      }
     }
+    ResolutionFile.Close();
   }
-  ResolutionFile.Close();
   std::cout << "Resolutions loaded\n";
   std::cout << "Preparing input and output files...\n";
   std::string OutputFilename = settings.get("OutputFilename");
-  TFile OutputFile(OutputFilename.c_str(), "RECREATE");
+  auto OutputFile = OutputWriter::OpenFile(OutputFilename, OutputWriter::Stage::Archival);
   // Open file with initial D daughter momenta
   std::string DaughterMomentaFilename = settings.get("DaughterMomentaFilename");
   std::ifstream DaughterMomentaFile(DaughterMomentaFilename);
   std::cout << "Files open and ready\n";
+  const int NumberSmearings = settings.getI("NumberSmearings");
+  const int ChunkSize = settings.contains("SmearingChunkSize") ? settings.getI("SmearingChunkSize") : 10000;
+  const int NumberChunks = (NumberSmearings + ChunkSize - 1)/ChunkSize;
+  const unsigned int Seed = settings.contains("Seed") ? settings.getI("Seed") : 0;
+  const int NumberThreads = settings.contains("NumberThreads") ? settings.getI("NumberThreads") : omp_get_max_threads();
+  // Each thread has its own amplitude model
+  std::vector<Amplitude> Amplitudes(NumberThreads);
+  // One merged TTree with all points
+  TTree *Tree = new TTree("BinMigrationTree", "");
+  int PointNumber = 0, SmearingNumber;
+  double rD, deltaD;
+  Tree->Branch("PointNumber", &PointNumber);
+  Tree->Branch("SmearingNumber", &SmearingNumber);
+  Tree->Branch("rD", &rD);
+  Tree->Branch("deltaD", &deltaD);
+  // The results of all smearings of one point
+  std::vector<double> Smeared_rD(NumberSmearings), Smeared_deltaD(NumberSmearings);
   std::string Line;
-  // Prepare phase space
-  Amplitude amplitude;
-  int TreeNumber = 0;
+  Instrumentation::ScopedTimer Timer("BinMigrationStudy::Smearing");
   while(std::getline(DaughterMomentaFile, Line)) {
-    std::cout << "Smearing point number " << TreeNumber << "\n";
+    std::cout << "Smearing point number " << PointNumber << "\n";
     // Parse momentum components
     std::stringstream ss(Line);
     std::vector<double> Momentum(16);
     for(int i = 0; i < 16; i++) {
       ss >> Momentum[i];
     }
-    // Create TTree containing the smeared components
-    TTree Tree(("BinMigrationTree" + std::to_string(TreeNumber)).c_str(), "");
-    double rD, deltaD;
-    Tree.Branch("rD", &rD);
-    Tree.Branch("deltaD", &deltaD);
     // First entry is without smearing
-    std::complex<double> Amp_D0 = amplitude(Momentum, +1);
-    std::complex<double> Amp_D0bar = amplitude(Momentum, -1);
-    rD = std::abs(Amp_D0/Amp_D0bar);
-    deltaD = std::arg(Amp_D0/Amp_D0bar);
-    Tree.Fill();
-    for(int i = 0; i < settings.getI("NumberSmearings"); i++) {
-      if(i%(settings.getI("NumberSmearings")/10) == 0) {
-	std::cout << "Smearing " << i << "\n";
+    SmearingNumber = 0;
+    std::complex<double> AmpRatio = Amplitudes[0](Momentum, +1)/Amplitudes[0](Momentum, -1);
+    rD = std::abs(AmpRatio);
+    deltaD = std::arg(AmpRatio);
+    Tree->Fill();
+    // Smear and evaluate one chunk, with reproducible random numbers for each point and chunk
+    auto SmearChunk = [&] (int Chunk, Amplitude &amplitude, double *rD_Chunk, double *deltaD_Chunk) {
+      TRandom3 Generator(Seed*1000003u + static_cast<unsigned int>(PointNumber)*100003u + static_cast<unsigned int>(Chunk) + 1u);
+      const int First = Chunk*ChunkSize;
+      const int Last = std::min(NumberSmearings, First + ChunkSize);
+      // All smeared momenta of the chunk are generated as one matrix before the amplitudes are evaluated
+      std::vector<std::vector<double>> SmearedMomenta(Last - First, Momentum);
+      for(auto &Row : SmearedMomenta) {
+	for(int j = 0; j < 16; j++) {
+	  Row[j] += Generator.Gaus(0.0, Resolutions[j]);
+	}
       }
-      std::vector<double> SmearedMomenta = Momentum;
-      for(int j = 0; j < 16; j++) {
-	SmearedMomenta[j] += gRandom->Gaus(0.0, Resolutions[j]);
+      for(int i = 0; i < Last - First; i++) {
+	std::complex<double> SmearedAmpRatio = amplitude(SmearedMomenta[i], +1)/amplitude(SmearedMomenta[i], -1);
+	rD_Chunk[i] = std::abs(SmearedAmpRatio);
+	deltaD_Chunk[i] = std::arg(SmearedAmpRatio);
       }
-      Amp_D0 = amplitude(SmearedMomenta, +1);
-      amplitude(SmearedMomenta, -1);
-      rD = std::abs(Amp_D0/Amp_D0bar);
-      deltaD = std::arg(Amp_D0/Amp_D0bar);
-      Tree.Fill();
+    };
+    #pragma omp parallel for schedule(dynamic) num_threads(NumberThreads)
+    for(int Chunk = 0; Chunk < NumberChunks; Chunk++) {
+      SmearChunk(Chunk, Amplitudes[omp_get_thread_num()], &Smeared_rD[Chunk*ChunkSize], &Smeared_deltaD[Chunk*ChunkSize]);
+    }
+    if(PointNumber == 0 && NumberThreads > 1 && NumberChunks > 0) {
+      // Evaluate the first chunk, which ran while all threads were busy, again on a single instance
+      // The results must agree exactly if the amplitude model is re-entrant
+      const int Size = std::min(NumberSmearings, ChunkSize);
+      std::vector<double> rD_Check(Size), deltaD_Check(Size);
+      SmearChunk(0, Amplitudes[0], rD_Check.data(), deltaD_Check.data());
+      auto Identical = [] (double a, double b) {
+	return a == b || (std::isnan(a) && std::isnan(b));
+      };
+      if(!std::equal(rD_Check.begin(), rD_Check.end(), Smeared_rD.begin(), Identical) ||
+	 !std::equal(deltaD_Check.begin(), deltaD_Check.end(), Smeared_deltaD.begin(), Identical)) {
+	throw std::runtime_error("Amplitude model gives different results when evaluated in parallel, run with NumberThreads 1");
+      }
+    }
+    for(int i = 0; i < NumberSmearings; i++) {
+      SmearingNumber = i + 1;
+      rD = Smeared_rD[i];
+      deltaD = Smeared_deltaD[i];
+      Tree->Fill();
     }
-    TreeNumber++;
-    Tree.Write();
+    Timer.AddEvents(NumberSmearings);
+    PointNumber++;
   }
+  Timer.Stop();
+  OutputFile->cd();
+  Tree->Write();
+  OutputFile->Close();
   std::cout << "Bin migration study completed\n";
   return 0;
 }
@@ -1,16 +1,23 @@
 // Martin Duy Tat 1st December 2021
 /**
  * Correct flavour tag yields is an application that performs efficiency and DCS corrections to the \f$K_i\f$
+ * If DCS_CovMatrixFilename is given, the correlated uncertainties of the DCS corrections are propagated to the \f$K_i\f$ and their normalised values
+ * The resulting covariance matrices are saved as Ki_CovMatrix and Ki_Norm_CovMatrix if Ki_CovMatrixFilename is given
  */
 
 #include<iostream>
 #include<fstream>
+#include<memory>
+#include<vector>
+#include<string>
+#include<stdexcept>
 #include"TMatrixT.h"
 #include"TFile.h"
 #include"TMath.h"
 #include"Settings.h"
 #include"Utilities.h"
 #include"Category.h"
+#include"OutputWriter.h"
 
 int main(int argc, char *argv[]) {
   std::cout << "Making efficiency and DCS corrections to flavour tag yields\n";
@@ -37,10 +44,21 @@ int main(int argc, char *argv[]) {
   EffCorrectedYields = *EffMatrix*EffCorrectedYields;
   std::cout << "Yields efficiency corrected\n";
   std::cout << "Making DCS corrections...\n";
+  std::unique_ptr<TMatrixT<double>> DCS_CovMatrix;
+  if(settings.contains("DCS_CovMatrixFilename")) {
+    TFile DCS_CovMatrixFile(settings.get("DCS_CovMatrixFilename").c_str(), "READ");
+    TMatrixT<double> *CovMatrix = nullptr;
+    DCS_CovMatrixFile.GetObject((Mode + "_DCS_CovMatrix").c_str(), CovMatrix);
+    if(!CovMatrix) {
+      throw std::runtime_error("Cannot find " + Mode + "_DCS_CovMatrix in " + settings.get("DCS_CovMatrixFilename"));
+    }
+    DCS_CovMatrix = std::unique_ptr<TMatrixT<double>>{CovMatrix};
+  }
   std::ofstream Outfile(settings.get("Ki_Filename"));
+  std::vector<double> DCS_Corrections;
   i = 0;
   double Sum = 0.0;
-  // Ignore uncertainties from efficiency and DCS corrections for now, just scale them
+  // Efficiency correction uncertainties are ignored for now, and the yield uncertainties are just scaled
   for(int Bin = -NumberBins; Bin <= NumberBins; Bin++) {
     if(Bin == 0) {
       continue;
@@ -48,26 +66,59 @@ int main(int argc, char *argv[]) {
     std::string DCS_Name = Mode + "_DCS_Correction_";
     DCS_Name += Bin > 0 ? "P" : "M";
     DCS_Name += std::to_string(TMath::Abs(Bin));
-    EffCorrectedYields(i, 0) *= settings["DCS_Corrections"].getD(DCS_Name);
-    std::string VariableName = Mode + "_Ki_Bin" + (Bin > 0 ? "P" : "M") + std::to_string(TMath::Abs(Bin));
-    Outfile << VariableName << " " << EffCorrectedYields(i, 0) << "\n";
+    DCS_Corrections.push_back(settings["DCS_Corrections"].getD(DCS_Name));
+    EffCorrectedYields(i, 0) *= DCS_Corrections.back();
     YieldErrors(i, 0) = EffCorrectedYields(i, 0)*YieldErrors(i, 0)/Yields(i, 0);
-    Outfile << VariableName << "_err " << YieldErrors(i, 0) << "\n";
     Sum += EffCorrectedYields(i, 0);
     i++;
   }
+  // Covariance of Ki, where the DCS corrections are shared between bins through rD, R and deltaD
+  TMatrixT<double> KiCovMatrix(2*NumberBins, 2*NumberBins);
+  for(int j = 0; j < 2*NumberBins; j++) {
+    KiCovMatrix(j, j) = YieldErrors(j, 0)*YieldErrors(j, 0);
+    if(DCS_CovMatrix) {
+      for(int k = 0; k < 2*NumberBins; k++) {
+	KiCovMatrix(j, k) += EffCorrectedYields(j, 0)*EffCorrectedYields(k, 0)*(*DCS_CovMatrix)(j, k)/(DCS_Corrections[j]*DCS_Corrections[k]);
+      }
+    }
+  }
+  // Covariance of the normalised Ki from the Jacobian of Ki/Sum
+  TMatrixT<double> NormJacobian(2*NumberBins, 2*NumberBins);
+  for(int j = 0; j < 2*NumberBins; j++) {
+    for(int k = 0; k < 2*NumberBins; k++) {
+      NormJacobian(j, k) = (j == k ? 1.0/Sum : 0.0) - EffCorrectedYields(j, 0)/(Sum*Sum);
+    }
+  }
+  TMatrixT<double> NormJacobian_T(TMatrixT<double>::kTransposed, NormJacobian);
+  TMatrixT<double> KiNormCovMatrix = NormJacobian*KiCovMatrix*NormJacobian_T;
+  i = 0;
+  for(int Bin = -NumberBins; Bin <= NumberBins; Bin++) {
+    if(Bin == 0) {
+      continue;
+    }
+    std::string VariableName = Mode + "_Ki_Bin" + (Bin > 0 ? "P" : "M") + std::to_string(TMath::Abs(Bin));
+    Outfile << VariableName << " " << EffCorrectedYields(i, 0) << "\n";
+    Outfile << VariableName << "_err " << (DCS_CovMatrix ? TMath::Sqrt(KiCovMatrix(i, i)) : YieldErrors(i, 0)) << "\n";
+    i++;
+  }
   Outfile << "\n";
   i = 0;
   for(int Bin = -NumberBins; Bin <= NumberBins; Bin++) {
     if(Bin == 0) {
       continue;
     }
-    std::string VariableName = Mode + "_Ki_Norm_Bin" + (Bin > 0 ? "P" : "M" + std::to_string(TMath::Abs(Bin)));
+    std::string VariableName = Mode + "_Ki_Norm_Bin" + (Bin > 0 ? "P" : "M") + std::to_string(TMath::Abs(Bin));
     Outfile << VariableName << " " << EffCorrectedYields(i, 0)/Sum << "\n";
-    Outfile << VariableName << "_err " << YieldErrors(i, 0)/Sum << "\n";
+    Outfile << VariableName << "_err " << (DCS_CovMatrix ? TMath::Sqrt(KiNormCovMatrix(i, i)) : YieldErrors(i, 0)/Sum) << "\n";
     i++;
   }
   Outfile.close();
+  if(settings.contains("Ki_CovMatrixFilename")) {
+    auto KiCovMatrixFile = OutputWriter::OpenFile(settings.get("Ki_CovMatrixFilename"), OutputWriter::Stage::Archival);
+    KiCovMatrix.Write("Ki_CovMatrix");
+    KiNormCovMatrix.Write("Ki_Norm_CovMatrix");
+    KiCovMatrixFile->Close();
+  }
   std::cout << "Yields are now efficiency and DCS corrected!\n";
   return 0;
 }
@@ -1,28 +1,127 @@
 // Martin Duy Tat 31st March 2021
 /**
  * FitDeltaE performs a fit of \f$\Delta E\f$ on an input ROOT file with a TTree
+ * If the settings contain a list of Modes, all modes are fitted in parallel and the cuts are saved directly to the \f$\Delta E\f$ cuts database
+ * Optionally, each mode is refitted on BootstrapReplicas bootstrap replicas to estimate the stability of the cuts, where replicas with a failed fit are left out
+ * Otherwise a single Mode is fitted interactively, with the option of reloading the settings and fitting again
+ * The modes with photons, which have their lower cut at \f$4\sigma\f$ instead of \f$3\sigma\f$, must be listed in DeltaE_FourSigmaLowerCutModes
  */
 
 #include<iostream>
+#include<string>
+#include<vector>
+#include<map>
+#include<utility>
+#include<algorithm>
+#include<stdexcept>
 #include"TFile.h"
 #include"TChain.h"
+#include"TMath.h"
+#include"ROOT/TProcessExecutor.hxx"
 #include"DeltaEFit.h"
+#include"DeltaECut.h"
+#include"ParallelNLL.h"
 #include"Utilities.h"
 #include"Settings.h"
 
+/**
+ * Helper function that loads the datasets of one tag mode
+ * @param Chain The TChain to add files to
+ * @param settings The fit settings
+ * @param Mode The tag mode
+ */
+void LoadDatasets(TChain &Chain, const Settings &settings, const std::string &Mode) {
+  std::vector<std::string> Datasets = Utilities::ConvertStringToVector(settings.get("Datasets_to_include"));
+  for(const auto &Dataset : Datasets) {
+    std::string Filename = Utilities::ReplaceString(settings["Datasets_WithoutDeltaECuts"].get(Dataset), "TAG", Mode);
+    Chain.Add(Filename.c_str());
+  }
+}
+
+/**
+ * Fit all modes in parallel processes and save the cuts of the successful fits to the database
+ * The filenames of the plots and results must contain TAG, which is replaced by the tag mode
+ * @param settings The fit settings
+ */
+int FitAllModes(const Settings &settings) {
+  std::vector<std::string> Modes = Utilities::ConvertStringToVector(settings.get("Modes"));
+  std::string DataMC = settings.get("DataMC");
+  if(DataMC != "Data" && DataMC != "MC") {
+    throw std::invalid_argument("DataMC must be Data or MC");
+  }
+  const int BootstrapReplicas = settings.contains("BootstrapReplicas") ? settings.getI("BootstrapReplicas") : 0;
+  auto FitMode = [&] (const std::string &Mode) {
+    Settings ModeSettings = settings;
+    ModeSettings.set_value("Mode", Mode, "Tag mode of this fit", false);
+    ModeSettings.set_value("ResultsFilename", Utilities::ReplaceString(settings.get("ResultsFilename"), "TAG", Mode));
+    ModeSettings.set_value("PlotFilename", Utilities::ReplaceString(settings.get("PlotFilename"), "TAG", Mode));
+    TChain Chain(settings.get("TreeName").c_str());
+    LoadDatasets(Chain, ModeSettings, Mode);
+    DeltaEFit deltaEFit(&Chain, ModeSettings);
+    deltaEFit.FitDeltaE();
+    auto Cuts = deltaEFit.GetDeltaECuts();
+    std::vector<double> Result{Cuts.first, Cuts.second, static_cast<double>(deltaEFit.GetFitStatus()), 0.0, 0.0, 0.0};
+    // The spread of the cuts over bootstrap replicas measures their stability
+    double SumLow = 0.0, SumLow2 = 0.0, SumHigh = 0.0, SumHigh2 = 0.0;
+    int GoodReplicas = 0;
+    for(int Replica = 1; Replica <= BootstrapReplicas; Replica++) {
+      deltaEFit.FitDeltaE(Replica);
+      if(deltaEFit.GetFitStatus() != 0) {
+	continue;
+      }
+      GoodReplicas++;
+      auto ReplicaCuts = deltaEFit.GetDeltaECuts();
+      SumLow += ReplicaCuts.first;
+      SumLow2 += ReplicaCuts.first*ReplicaCuts.first;
+      SumHigh += ReplicaCuts.second;
+      SumHigh2 += ReplicaCuts.second*ReplicaCuts.second;
+    }
+    if(GoodReplicas > 1) {
+      Result[3] = TMath::Sqrt(std::max(0.0, (SumLow2 - SumLow*SumLow/GoodReplicas)/(GoodReplicas - 1)));
+      Result[4] = TMath::Sqrt(std::max(0.0, (SumHigh2 - SumHigh*SumHigh/GoodReplicas)/(GoodReplicas - 1)));
+    }
+    Result[5] = GoodReplicas;
+    return Result;
+  };
+  int Workers = ParallelNLL::GetAvailableCPUs(settings.contains("NumberCPUs") ? settings.getI("NumberCPUs") : 0);
+  Workers = std::max(1, std::min(Workers, static_cast<int>(Modes.size())));
+  std::cout << "Fitting Delta E of " << Modes.size() << " modes with " << Workers << " workers...\n";
+  ROOT::TProcessExecutor Executor(Workers);
+  std::vector<std::vector<double>> Results = Executor.Map(FitMode, Modes);
+  std::map<std::string, std::pair<double, double>> Cuts;
+  bool AllConverged = true;
+  for(std::size_t i = 0; i < Modes.size(); i++) {
+    if(Results[i][2] != 0.0) {
+      std::cout << "Delta E fit of " << Modes[i] << " has status " << Results[i][2] << ", cut not saved\n";
+      AllConverged = false;
+    } else {
+      std::cout << Modes[i] << ": " << Results[i][0] << " < DeltaE < " << Results[i][1];
+      if(BootstrapReplicas > 1) {
+	std::cout << " (bootstrap spread " << Results[i][3] << ", " << Results[i][4] << " from " << Results[i][5] << " of " << BootstrapReplicas << " replicas)";
+      }
+      std::cout << "\n";
+      Cuts.insert({Modes[i], {Results[i][0], Results[i][1]}});
+    }
+  }
+  if(!Cuts.empty()) {
+    DeltaECut::SaveDeltaECuts(Cuts, DataMC);
+    std::cout << "Delta E cuts of " << Cuts.size() << " modes saved\n";
+  }
+  return AllConverged ? 0 : 1;
+}
+
 int main(int argc, char *argv[]) {
   std::cout << "Fit of Delta E\n";
   std::cout << "Loading settings...\n";
   Settings settings = Utilities::parse_args(argc, argv);
   std::cout << "Settings ready\n";
+  if(settings.contains("Modes")) {
+    return FitAllModes(settings);
+  }
   std::cout << "Loading ROOT file\n";
   TChain Chain(settings.get("TreeName").c_str());
   std::string Mode = settings.get("Mode");
-  std::vector<std::string> Datasets = Utilities::ConvertStringToVector(settings.get("Datasets_to_include"));
-  for(const auto &Dataset : Datasets) {
-    std::string Filename = Utilities::ReplaceString(settings["Datasets_WithoutDeltaECuts"].get(Dataset), "TAG", Mode);
-    Chain.Add(Filename.c_str());
-  }
+  LoadDatasets(Chain, settings, Mode);
   DeltaEFit deltaEFit(&Chain, settings);
   bool DoFit;;
   do {
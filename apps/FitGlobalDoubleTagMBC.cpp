@@ -0,0 +1,17 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * FitGlobalDoubleTagMBC is an application that fits the double tag yields of several tag modes simultaneously, with some parameters shared between the tag modes, and saves the yields of each tag mode to a text file
+ */
+
+#include<iostream>
+#include"GlobalDoubleTagYield.h"
+#include"Settings.h"
+#include"Utilities.h"
+
+int main(int argc, char *argv[]) {
+  Settings settings = Utilities::parse_args(argc, argv);
+  std::cout << "Global double tag yield fit\n";
+  GlobalDoubleTagYield globalDoubleTagYield(settings);
+  globalDoubleTagYield.DoFit();
+  return 0;
+}
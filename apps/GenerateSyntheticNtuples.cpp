@@ -0,0 +1,318 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * GenerateSyntheticNtuples is an application that generates BESIII-like single tag or double tag ntuples without any BESIII data
+ * The \f$D\bar{D}\f$ pair is produced at threshold and each D meson decays according to phase space, followed by a simple momentum smearing
+ * All branches read by the phase space binning classes, the \f$\Delta E\f$ and \f$m_\text{BC}\f$ branches, the Kalman fit branches and the truth arrays are filled with the same names as the BOSS ntuples
+ * The events are split into files ending in _0.root, _1.root, etc, so that they can be loaded with Utilities::LoadChain
+ * This makes it possible to load test the whole analysis chain locally
+ */
+
+#include<iostream>
+#include<string>
+#include<vector>
+#include<map>
+#include<memory>
+#include<stdexcept>
+#include<cmath>
+#include<algorithm>
+#include"TFile.h"
+#include"TTree.h"
+#include"TRandom3.h"
+#include"TGenPhaseSpace.h"
+#include"TLorentzVector.h"
+#include"TVector3.h"
+#include"TMath.h"
+#include"Settings.h"
+#include"Utilities.h"
+#include"Instrumentation.h"
+#include"OutputWriter.h"
+#include"PhaseSpace/GeneratorKinematics.h"
+
+namespace {
+  /**
+   * Centre-of-mass energy at \f$\psi(3770)\f$
+   */
+  const double CMEnergy = 3.773;
+  /**
+   * Mass of the \f$D^0\f$ meson
+   */
+  const double D0Mass = 1.86484;
+  /**
+   * Maximum number of particles in the truth arrays
+   */
+  const int MaxParticles = 100;
+
+  /**
+   * A final state particle and the name it has in the ntuple branches
+   */
+  struct Particle {
+    std::string Name;
+    int ID;
+    double Mass;
+  };
+
+  /**
+   * The D decay of a tag mode, with the \f$D^0\f$ final state, where the \f$\bar{D^0}\f$ decay is the charge conjugate
+   */
+  std::vector<Particle> GetDecay(const std::string &Mode) {
+    const Particle KPlus{"KPlus", 321, 0.493677}, KMinus{"KMinus", -321, 0.493677};
+    const Particle PiPlus{"PiPlus", 211, 0.13957}, PiMinus{"PiMinus", -211, 0.13957};
+    const Particle Pi0{"Pi0", 111, 0.134977}, KS{"KS", 310, 0.497611}, KL{"KL", 130, 0.497611};
+    static const std::map<std::string, std::vector<Particle>> Decays{
+      {"KKpipi", {KPlus, KMinus, PiPlus, PiMinus}},
+      {"KK", {KPlus, KMinus}},
+      {"pipi", {PiPlus, PiMinus}},
+      {"Kpi", {KMinus, PiPlus}},
+      {"Kpipi0", {KMinus, PiPlus, Pi0}},
+      {"KSpi0", {KS, Pi0}},
+      {"KLpi0", {KL, Pi0}},
+      {"KSpipi", {KS, PiPlus, PiMinus}},
+      {"KLpipi", {KL, PiPlus, PiMinus}},
+      {"KSKK", {KS, KPlus, KMinus}},
+      {"KLKK", {KL, KPlus, KMinus}}};
+    auto Decay = Decays.find(Mode);
+    if(Decay == Decays.end()) {
+      throw std::invalid_argument("Synthetic ntuples not available for tag mode " + Mode);
+    }
+    return Decay->second;
+  }
+
+  /**
+   * Charge conjugate a particle ID, neutral particles that are their own antiparticle are unchanged
+   */
+  int ChargeConjugate(int ID) {
+    return (ID == 111 || ID == 310 || ID == 130) ? ID : -ID;
+  }
+
+  /**
+   * Class with the branch buffers of one side (signal or tag) of the event
+   */
+  class DecaySide {
+    public:
+      /**
+       * Constructor that creates all branches of one side
+       * @param Tree The output tree
+       * @param Prefix "Signal", "Tag" or "" for single tags
+       * @param Decay The final state particles of the \f$D^0\f$ decay
+       */
+      DecaySide(TTree *Tree, const std::string &Prefix, const std::vector<Particle> &Decay): m_Decay(Decay),
+											 m_Momenta(4*Decay.size()),
+											 m_MomentaKalmanFit(4*Decay.size()) {
+	const std::vector<std::string> Components{"px", "py", "pz", "energy"};
+	for(std::size_t i = 0; i < m_Decay.size(); i++) {
+	  for(std::size_t j = 0; j < Components.size(); j++) {
+	    std::string Name = Prefix + m_Decay[i].Name + Components[j];
+	    Tree->Branch(Name.c_str(), &m_Momenta[4*i + j]);
+	    Tree->Branch((Name + "KalmanFit").c_str(), &m_MomentaKalmanFit[4*i + j]);
+	  }
+	}
+	Tree->Branch((Prefix + "KalmanFitSuccess").c_str(), &m_KalmanFitSuccess);
+	Tree->Branch((Prefix + "MBC").c_str(), &m_MBC);
+	Tree->Branch((Prefix + "DeltaE").c_str(), &m_DeltaE);
+	std::vector<double> Masses;
+	for(const auto &Daughter : m_Decay) {
+	  Masses.push_back(Daughter.Mass);
+	}
+	m_Masses = Masses;
+	// In a D0bar decay each daughter is the charge conjugate, so it belongs in the branches of its conjugate partner if there is one
+	for(std::size_t i = 0; i < m_Decay.size(); i++) {
+	  auto Partner = std::find_if(m_Decay.begin(), m_Decay.end(), [&] (const Particle &Daughter) {
+	    return Daughter.ID == ChargeConjugate(m_Decay[i].ID);
+	  });
+	  m_ConjugateBranch.push_back(Partner == m_Decay.end() ? i : Partner - m_Decay.begin());
+	}
+      }
+      /**
+       * Generate the decay of a D meson and fill the reconstructed branches
+       * @param D Four-momentum of the D meson
+       * @param Signal Set to false to replace the \f$m_\text{BC}\f$ and \f$\Delta E\f$ with combinatorial background
+       * @param Conjugate Set to true for a \f$\bar{D^0}\f$ decay, so that the reconstructed branches match the conjugated truth IDs
+       * @return True four-momenta of the daughters, in the order of the \f$D^0\f$ decay
+       */
+      std::vector<TLorentzVector> Generate(TLorentzVector D, bool Signal, bool Conjugate) {
+	m_Generator.SetDecay(D, static_cast<int>(m_Masses.size()), m_Masses.data());
+	// Accept-reject so that the events are distributed uniformly in phase space
+	double MaxWeight = m_Generator.GetWtMax();
+	while(m_Generator.Generate() < gRandom->Uniform(0.0, MaxWeight)) {
+	}
+	std::vector<TLorentzVector> TrueMomenta;
+	TLorentzVector RecoD;
+	for(std::size_t i = 0; i < m_Decay.size(); i++) {
+	  TrueMomenta.push_back(*m_Generator.GetDecay(i));
+	  TLorentzVector Reco = Smear(TrueMomenta.back(), m_Decay[i].Mass, 0.005);
+	  TLorentzVector KalmanFit = Smear(TrueMomenta.back(), m_Decay[i].Mass, 0.002);
+	  const std::size_t Branch = Conjugate ? m_ConjugateBranch[i] : i;
+	  for(int j = 0; j < 4; j++) {
+	    m_Momenta[4*Branch + j] = Reco[j];
+	    m_MomentaKalmanFit[4*Branch + j] = KalmanFit[j];
+	  }
+	  RecoD += Reco;
+	}
+	m_KalmanFitSuccess = gRandom->Uniform() < 0.95 ? 1 : 0;
+	const double BeamEnergy = CMEnergy/2.0;
+	if(Signal) {
+	  m_MBC = std::sqrt(std::max(0.0, BeamEnergy*BeamEnergy - RecoD.Vect().Mag2()));
+	  m_DeltaE = RecoD.E() - BeamEnergy;
+	} else {
+	  m_MBC = GenerateArgus(BeamEnergy);
+	  m_DeltaE = gRandom->Uniform(-0.1, 0.1);
+	}
+	return TrueMomenta;
+      }
+    private:
+      std::vector<Particle> m_Decay;
+      std::vector<double> m_Masses;
+      std::vector<double> m_Momenta;
+      std::vector<double> m_MomentaKalmanFit;
+      std::vector<std::size_t> m_ConjugateBranch;
+      int m_KalmanFitSuccess = 0;
+      double m_MBC = 0.0;
+      double m_DeltaE = 0.0;
+      TGenPhaseSpace m_Generator;
+      /**
+       * Smear each momentum component and recalculate the energy from the mass
+       */
+      static TLorentzVector Smear(const TLorentzVector &Momentum, double Mass, double Resolution) {
+	TVector3 P(Momentum.Px() + gRandom->Gaus(0.0, Resolution),
+		   Momentum.Py() + gRandom->Gaus(0.0, Resolution),
+		   Momentum.Pz() + gRandom->Gaus(0.0, Resolution));
+	return TLorentzVector(P, std::sqrt(P.Mag2() + Mass*Mass));
+      }
+      /**
+       * Generate combinatorial background from an ARGUS distribution in the fit range
+       */
+      static double GenerateArgus(double EndPoint) {
+	const double c = -20.0;
+	auto Argus = [=] (double m) {
+	  double x = 1.0 - (m*m)/(EndPoint*EndPoint);
+	  return x > 0.0 ? m*std::sqrt(x)*std::exp(c*x) : 0.0;
+	};
+	// The ARGUS function is bounded by its value at the lower edge times a safety factor in this range
+	const double Low = 1.83;
+	const double Maximum = 1.5*Argus(1.87);
+	while(true) {
+	  double m = gRandom->Uniform(Low, EndPoint);
+	  if(gRandom->Uniform(0.0, Maximum) < Argus(m)) {
+	    return m;
+	  }
+	}
+      }
+  };
+
+  /**
+   * Add the D meson and its daughters to the truth arrays
+   */
+  void AddTruth(int DID, const TLorentzVector &D, const std::vector<Particle> &Decay, const std::vector<TLorentzVector> &Daughters, GeneratorKinematics &Truth) {
+    auto AddParticle = [&Truth] (int ID, int Mother, const TLorentzVector &P) {
+      int Index = Truth.NumberParticles++;
+      Truth.ParticleIDs[Index] = ID;
+      Truth.MotherIndex[Index] = Mother;
+      Truth.TruePx[Index] = P.Px();
+      Truth.TruePy[Index] = P.Py();
+      Truth.TruePz[Index] = P.Pz();
+      Truth.TrueEnergy[Index] = P.E();
+      return Index;
+    };
+    int DIndex = AddParticle(DID, -1, D);
+    for(std::size_t i = 0; i < Decay.size(); i++) {
+      int ID = DID > 0 ? Decay[i].ID : ChargeConjugate(Decay[i].ID);
+      int Index = AddParticle(ID, DIndex, Daughters[i]);
+      // The KS decay products follow the KS, as in the BOSS truth record
+      if(ID == 310) {
+	TGenPhaseSpace KSDecay;
+	const double PionMasses[2] = {0.13957, 0.13957};
+	TLorentzVector KS(Daughters[i]);
+	KSDecay.SetDecay(KS, 2, PionMasses);
+	KSDecay.Generate();
+	AddParticle(211, Index, *KSDecay.GetDecay(0));
+	AddParticle(-211, Index, *KSDecay.GetDecay(1));
+      }
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  Settings settings = Utilities::parse_args(argc, argv);
+  std::string TagType = settings.get("TagType");
+  std::string TagMode = settings.get("TagMode");
+  if(TagType != "ST" && TagType != "DT") {
+    throw std::invalid_argument("Unknown tag type " + TagType);
+  }
+  long long NumberEvents = std::stoll(settings.get("NumberEvents"));
+  long long EventsPerFile = settings.contains("EventsPerFile") ? std::stoll(settings.get("EventsPerFile")) : NumberEvents;
+  double SignalFraction = settings.contains("SignalFraction") ? settings.getD("SignalFraction") : 0.9;
+  gRandom->SetSeed(settings.contains("Seed") ? settings.getI("Seed") : 0);
+  std::vector<Particle> TagDecay = GetDecay(TagMode);
+  std::vector<Particle> SignalDecay = GetDecay("KKpipi");
+  std::cout << "Generating " << NumberEvents << " synthetic " << TagType << " events of ";
+  if(TagType == "DT") {
+    std::cout << "KKpipi vs ";
+  }
+  std::cout << TagMode << "\n";
+  OutputWriter::EnableParallelCompression();
+  Instrumentation::ScopedTimer Timer("GenerateSyntheticNtuples::Generate");
+  // The D mesons are produced back-to-back at threshold, with a random direction
+  const double DMomentum = std::sqrt(CMEnergy*CMEnergy/4.0 - D0Mass*D0Mass);
+  long long EventNumber = 0;
+  for(int FileNumber = 0; EventNumber < NumberEvents; FileNumber++) {
+    std::string Filename = settings.get("OutputFilenamePrefix") + "_" + std::to_string(FileNumber) + ".root";
+    auto OutputFile = OutputWriter::OpenFile(Filename, OutputWriter::Stage::Intermediate);
+    TTree *Tree = new TTree(settings.get("TreeName").c_str(), "");
+    int Run = 1, Event = 0, TagKCharge = 0;
+    GeneratorKinematics Truth(MaxParticles);
+    Tree->Branch("Run", &Run);
+    Tree->Branch("Event", &Event);
+    Tree->Branch("NumberOfParticles", &Truth.NumberParticles);
+    Tree->Branch("ParticleIDs", Truth.ParticleIDs.data(), "ParticleIDs[NumberOfParticles]/I");
+    Tree->Branch("MotherIndex", Truth.MotherIndex.data(), "MotherIndex[NumberOfParticles]/I");
+    Tree->Branch("True_Px", Truth.TruePx.data(), "True_Px[NumberOfParticles]/D");
+    Tree->Branch("True_Py", Truth.TruePy.data(), "True_Py[NumberOfParticles]/D");
+    Tree->Branch("True_Pz", Truth.TruePz.data(), "True_Pz[NumberOfParticles]/D");
+    Tree->Branch("True_Energy", Truth.TrueEnergy.data(), "True_Energy[NumberOfParticles]/D");
+    std::unique_ptr<DecaySide> Signal, Tag;
+    if(TagType == "DT") {
+      Signal = std::unique_ptr<DecaySide>(new DecaySide(Tree, "Signal", SignalDecay));
+      Tag = std::unique_ptr<DecaySide>(new DecaySide(Tree, "Tag", TagDecay));
+      Tree->Branch("TagKCharge", &TagKCharge);
+    } else {
+      Tag = std::unique_ptr<DecaySide>(new DecaySide(Tree, "", TagDecay));
+    }
+    OutputWriter::ConfigureTree(Tree);
+    long long LastEvent = std::min(NumberEvents, EventNumber + EventsPerFile);
+    for(; EventNumber < LastEvent; EventNumber++) {
+      Event = static_cast<int>(EventNumber%2147483647) + 1;
+      TVector3 Direction;
+      Direction.SetMagThetaPhi(DMomentum, std::acos(gRandom->Uniform(-1.0, 1.0)), gRandom->Uniform(0.0, 2.0*TMath::Pi()));
+      TLorentzVector D0(Direction, std::sqrt(DMomentum*DMomentum + D0Mass*D0Mass));
+      TLorentzVector D0bar(-Direction, D0.E());
+      // Randomly decide if the tag is a D0 or D0bar, the signal decay is self-conjugate
+      bool TagIsD0 = gRandom->Uniform() < 0.5;
+      bool IsSignal = gRandom->Uniform() < SignalFraction;
+      TLorentzVector TagD = TagIsD0 ? D0 : D0bar;
+      TLorentzVector SignalD = TagIsD0 ? D0bar : D0;
+      Truth.NumberParticles = 0;
+      std::vector<TLorentzVector> TagDaughters = Tag->Generate(TagD, IsSignal, !TagIsD0);
+      if(TagType == "DT") {
+	std::vector<TLorentzVector> SignalDaughters = Signal->Generate(SignalD, IsSignal, TagIsD0);
+	// The truth record always lists the D0 first
+	if(TagIsD0) {
+	  AddTruth(421, TagD, TagDecay, TagDaughters, Truth);
+	  AddTruth(-421, SignalD, SignalDecay, SignalDaughters, Truth);
+	} else {
+	  AddTruth(421, SignalD, SignalDecay, SignalDaughters, Truth);
+	  AddTruth(-421, TagD, TagDecay, TagDaughters, Truth);
+	}
+	TagKCharge = TagIsD0 ? -1 : +1;
+      } else {
+	AddTruth(TagIsD0 ? 421 : -421, TagD, TagDecay, TagDaughters, Truth);
+      }
+      OutputWriter::FillTree(Tree);
+      Timer.AddEvents();
+    }
+    Tree->Write();
+    OutputFile->Close();
+    std::cout << "Saved events to " << Filename << "\n";
+  }
+  std::cout << "Synthetic ntuples generated\n";
+  return 0;
+}
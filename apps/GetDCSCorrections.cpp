@@ -1,41 +1,78 @@
 // Martin Duy Tat 1st December 2021
 /**
  * GetDCSCorrections is an application that calculates the DCS corrections for the flavour tags
+ * The corrections of all bins are calculated together, for a single Mode or for each tag in Modes
+ * By default the uncertainties are propagated linearly with the analytic Jacobian, while DCS_Propagation set to MonteCarlo samples the DCS parameters in parallel instead
+ * If DCS_CovMatrixFilename is given, the full covariance matrix of the corrections in each tag mode is saved as <Mode>_DCS_CovMatrix in a ROOT file
  */
 
 #include<iostream>
 #include<fstream>
 #include<string>
 #include<vector>
+#include<memory>
+#include<stdexcept>
+#include<omp.h>
 #include"TMath.h"
+#include"TMatrixT.h"
+#include"TFile.h"
 #include"Utilities.h"
-#include"uncertainties/ureal.hpp"
-#include"uncertainties/math.hpp"
+#include"OutputWriter.h"
 #include"HadronicParameters/cisi.h"
 #include"HadronicParameters/Ki.h"
 #include"HadronicParameters/DCS_Parameters.h"
+#include"HadronicParameters/DCS_Correction.h"
 
 int main(int argc, char *argv[]) {
   std::cout << "Calculating DCS corrections\n";
   Settings settings = Utilities::parse_args(argc, argv);
-  std::string Mode = settings.get("Mode");
+  std::vector<std::string> Modes;
+  if(settings.contains("Modes")) {
+    Modes = Utilities::ConvertStringToVector(settings.get("Modes"));
+  } else {
+    Modes.push_back(settings.get("Mode"));
+  }
+  const std::string Propagation = settings.contains("DCS_Propagation") ? settings.get("DCS_Propagation") : "Linear";
+  if(Propagation != "Linear" && Propagation != "MonteCarlo") {
+    throw std::invalid_argument("DCS_Propagation must be Linear or MonteCarlo");
+  }
+  const int Samples = Propagation == "MonteCarlo" ? settings.getI("DCS_MonteCarloSamples") : 0;
+  const unsigned int Seed = settings.contains("Seed") ? settings.getI("Seed") : 0;
+  const int NumberThreads = settings.contains("NumberThreads") ? settings.getI("NumberThreads") : omp_get_max_threads();
   std::cout << "Initializing hadronic parameters...\n";
   cisi cisi_m(settings["BinningScheme"]);
   Ki Ki_m(settings["BinningScheme"]);
-  DCS_Parameters DCS(settings["DCS_Parameters_" + Mode]);
   std::cout << "Hadronic parameters ready\n";
-  std::vector<uncertainties::udouble> DCS_parameters = DCS.GetDCSParameters();
   std::ofstream Outfile(settings.get("DCS_Parameters_Filename"));
+  std::unique_ptr<TFile> CovMatrixFile;
+  if(settings.contains("DCS_CovMatrixFilename")) {
+    CovMatrixFile = OutputWriter::OpenFile(settings.get("DCS_CovMatrixFilename"), OutputWriter::Stage::Archival);
+  }
   int NumberBins = settings["BinningScheme"].getI("NumberBins");
   std::cout << "Calculating DCS corrections...\n";
-  for(int Bin = -NumberBins; Bin <= NumberBins; Bin++) {
-    if(Bin == 0) {
-      continue;
+  for(const auto &Mode : Modes) {
+    DCS_Parameters DCS(settings["DCS_Parameters_" + Mode]);
+    DCS_Correction Corrections(Ki_m, cisi_m, DCS, NumberBins);
+    std::vector<double> Correction = Corrections.GetCorrections();
+    TMatrixT<double> CovMatrix = Propagation == "MonteCarlo" ? Corrections.GetMonteCarloCovariance(Samples, Seed, NumberThreads) : Corrections.GetLinearCovariance();
+    int i = 0;
+    for(int Bin = -NumberBins; Bin <= NumberBins; Bin++) {
+      if(Bin == 0) {
+	continue;
+      }
+      std::string BinSign = Bin > 0 ? "P" : "M";
+      Outfile << Mode << "_DCS_Correction_" << BinSign << TMath::Abs(Bin) << "     " << Correction[i] << "\n";
+      Outfile << Mode << "_DCS_Correction_" << BinSign << TMath::Abs(Bin) << "_err " << TMath::Sqrt(CovMatrix(i, i)) << "\n";
+      i++;
     }
-    uncertainties::udouble Correction = Ki_m.Get_Ki(Bin)*Ki_m.Get_Ki(Bin)/(Ki_m.Get_Ki(Bin)*Ki_m.Get_Ki(Bin) + DCS_parameters[0]*DCS_parameters[0]*Ki_m.Get_Ki(-Bin)*Ki_m.Get_Ki(-Bin) - 2*DCS_parameters[0]*DCS_parameters[1]*Ki_m.Get_Ki(Bin)*Ki_m.Get_Ki(-Bin)*(cisi_m.Get_ci(Bin)*uncertainties::cos(TMath::Pi()*DCS_parameters[2]/180.0) - cisi_m.Get_si(Bin)*uncertainties::sin(TMath::Pi()*DCS_parameters[2]/180.0)));
-    std::string BinSign = Bin > 0 ? "P" : "M";
-    Outfile << Mode << "_DCS_Correction_" << BinSign << TMath::Abs(Bin) << "     " << uncertainties::nom(Correction) << "\n";
-    Outfile << Mode << "_DCS_Correction_" << BinSign << TMath::Abs(Bin) << "_err " << uncertainties::sdev(Correction) << "\n";
+    if(CovMatrixFile) {
+      CovMatrixFile->cd();
+      CovMatrix.Write((Mode + "_DCS_CovMatrix").c_str());
+    }
+  }
+  Outfile.close();
+  if(CovMatrixFile) {
+    CovMatrixFile->Close();
   }
   std::cout << "DCS corrections calculated!\n";
   return 0;
@@ -15,6 +15,7 @@
 #include"Utilities.h"
 #include"Settings.h"
 #include"Category.h"
+#include"OutputWriter.h"
 
 int main(int argc, char *argv[]) {
   std::cout << "Calculating double tag efficiency matrix from signal MC\n";
@@ -59,7 +60,7 @@ int main(int argc, char *argv[]) {
   }
   std::cout << "True bin yields counted\n";
   std::cout << "Counting reconstructed and true bin numbers...\n";
-  TFile Outfile(settings.get("EfficiencyMatrixFilename").c_str(), "RECREATE");
+  auto Outfile = OutputWriter::OpenFile(settings.get("EfficiencyMatrixFilename"), OutputWriter::Stage::Archival);
   TMatrixT<double> EffMatrix(NumberBins, NumberBins), EffMatrix_err(NumberBins, NumberBins);
   std::string TreeName = settings.get("TreeName");
   TChain Chain(TreeName.c_str());
@@ -108,8 +109,10 @@ int main(int argc, char *argv[]) {
       EffMatrix_err(i, j) = TMath::Sqrt(p*(1 - p)/GeneratedEvents[j]);
     }
   }
+  Outfile->cd();
   EffMatrix.Write("EffMatrix");
   EffMatrix_err.Write("EffMatrix_err");
+  Outfile->Close();
   std::cout << "Efficiency matrix ready\n";
   std::cout << "Double tag efficiency studies done!\n";
   return 0;
@@ -1,25 +1,42 @@
 // Martin Duy Tat 26th November 2021
 /**
  * GetSingleTagEfficiencies is an application that calculates all the single tag efficiencies using signal MC samples
+ * All modes are processed in parallel, and each sample is read in a single pass with only the weight branches enabled
+ * With ReweightMC the events are weighted by ModelWeight and with DataMCMismatchWeight by the data/MC correction, as for the double tag efficiencies
+ * When reweighting, the number of generated events is the sum of ModelWeight in the truth tuple TruthTupleFilename, where TAG is replaced by the tag mode
+ * If BootstrapSamples is given, the uncertainty is also estimated from Poisson bootstrap replicas of the reconstructed events
  */
 
 #include<iostream>
 #include<fstream>
 #include<string>
+#include<vector>
+#include<algorithm>
+#include<stdexcept>
 #include"TChain.h"
 #include"TMath.h"
+#include"TRandom3.h"
+#include"ROOT/TProcessExecutor.hxx"
+#include"ParallelNLL.h"
 #include"Utilities.h"
 #include"Settings.h"
 
 int main(int argc, char *argv[]) {
   std::cout << "Calculating single tag efficiencies from signal MC\n";
   Settings settings = Utilities::parse_args(argc, argv);
-  std::ofstream Outfile(settings.get("SingleTagEfficienciesFilename"));
-  Outfile << "* Single tag efficiencies\n\n";
   double SignalMC_SampleSize = static_cast<double>(settings["SignalMCSampleSize"].getI("SingleTag"));
   std::string ModeList = settings.get("ListModes");
   std::vector<std::string> Modes = Utilities::ConvertStringToVector(ModeList);
-  for(const auto &Mode : Modes) {
+  const bool ReweightMC = settings.contains("ReweightMC") && settings.getB("ReweightMC");
+  const bool DataMCMismatchWeight = settings.contains("DataMCMismatchWeight") && settings.getB("DataMCMismatchWeight");
+  const int BootstrapSamples = settings.contains("BootstrapSamples") ? settings.getI("BootstrapSamples") : 0;
+  const unsigned int Seed = settings.contains("Seed") ? settings.getI("Seed") : 1;
+  if(ReweightMC && !settings.contains("TruthTupleFilename")) {
+    throw std::invalid_argument("ReweightMC needs the truth tuple TruthTupleFilename to reweight the generated events");
+  }
+  // Returns the efficiency, its uncertainty and the bootstrap uncertainty of one mode
+  auto GetEfficiency = [&] (int ModeIndex) {
+    const std::string &Mode = Modes[ModeIndex];
     std::cout << "Analyzing " << Mode << " single tag efficiency...\n";
     std::string TreeName = settings.get("TreeName");
     TreeName = Utilities::ReplaceString(TreeName, "TAG", Mode);
@@ -27,10 +44,98 @@ int main(int argc, char *argv[]) {
     std::string Filename = settings["Datasets_WithDeltaECuts"].get("SignalMC_ST");
     Filename = Utilities::ReplaceString(Filename, "TAG", Mode);
     Chain.Add(Filename.c_str());
-    double Entries = static_cast<double>(Chain.GetEntries());
-    double Efficiency = Entries/SignalMC_SampleSize;
-    Outfile << Mode << "_SingleTagEfficiency     " << Efficiency << "\n";
-    Outfile << Mode << "_SingleTagEfficiency_err " << TMath::Sqrt(Efficiency*(1 - Efficiency)/SignalMC_SampleSize) << "\n";
+    Chain.SetBranchStatus("*", 0);
+    double ModelWeight = 1.0, DataMCWeight = 1.0;
+    if(ReweightMC) {
+      Chain.SetBranchStatus("ModelWeight", 1);
+      Chain.SetBranchAddress("ModelWeight", &ModelWeight);
+    }
+    if(DataMCMismatchWeight) {
+      Chain.SetBranchStatus("DataMCMismatchWeight", 1);
+      Chain.SetBranchAddress("DataMCMismatchWeight", &DataMCWeight);
+    }
+    const bool ReadWeights = ReweightMC || DataMCMismatchWeight;
+    // Sums over reconstructed events of the full weight, its square and the square of the model weight times the data/MC weight
+    double SumW = 0.0, SumW2 = 0.0, SumModelW2 = 0.0;
+    std::vector<double> BootstrapSumW(BootstrapSamples, 0.0);
+    TRandom3 Random(Seed + ModeIndex);
+    const Long64_t Entries = Chain.GetEntries();
+    if(!ReadWeights && BootstrapSamples == 0) {
+      SumW = SumW2 = SumModelW2 = static_cast<double>(Entries);
+    } else {
+      for(Long64_t i = 0; i < Entries; i++) {
+	if(ReadWeights) {
+	  Chain.GetEntry(i);
+	}
+	const double Weight = ModelWeight*DataMCWeight;
+	SumW += Weight;
+	SumW2 += Weight*Weight;
+	SumModelW2 += ModelWeight*ModelWeight*DataMCWeight;
+	for(auto &Sum : BootstrapSumW) {
+	  Sum += Weight*Random.Poisson(1.0);
+	}
+      }
+    }
+    Chain.ResetBranchAddresses();
+    // Sum of the model weights of the generated events and their squares
+    double GeneratedSumW = SignalMC_SampleSize, GeneratedSumW2 = SignalMC_SampleSize;
+    if(ReweightMC) {
+      TChain TruthChain("TruthTuple");
+      TruthChain.Add(Utilities::ReplaceString(settings.get("TruthTupleFilename"), "TAG", Mode).c_str());
+      TruthChain.SetBranchStatus("*", 0);
+      TruthChain.SetBranchStatus("ModelWeight", 1);
+      double TruthModelWeight = 1.0;
+      TruthChain.SetBranchAddress("ModelWeight", &TruthModelWeight);
+      GeneratedSumW = GeneratedSumW2 = 0.0;
+      const Long64_t TruthEntries = TruthChain.GetEntries();
+      for(Long64_t i = 0; i < TruthEntries; i++) {
+	TruthChain.GetEntry(i);
+	GeneratedSumW += TruthModelWeight;
+	GeneratedSumW2 += TruthModelWeight*TruthModelWeight;
+      }
+      TruthChain.ResetBranchAddresses();
+    }
+    const double Efficiency = SumW/GeneratedSumW;
+    // Variance of the ratio of weighted sums over the generated events, where events that are not reconstructed have zero weight in the numerator
+    // Without weights this reduces to the binomial variance
+    const double SumVariance = SumW2 - 2.0*Efficiency*SumModelW2 + Efficiency*Efficiency*GeneratedSumW2;
+    const double Efficiency_err = TMath::Sqrt(std::max(0.0, SumVariance))/GeneratedSumW;
+    double Efficiency_bootstrap_err = 0.0;
+    if(BootstrapSamples > 1) {
+      double Mean = 0.0, Variance = 0.0;
+      for(auto Sum : BootstrapSumW) {
+	Mean += Sum/BootstrapSamples;
+      }
+      for(auto Sum : BootstrapSumW) {
+	Variance += (Sum - Mean)*(Sum - Mean)/(BootstrapSamples - 1);
+      }
+      Efficiency_bootstrap_err = TMath::Sqrt(Variance)/GeneratedSumW;
+    }
+    return std::vector<double>{Efficiency, Efficiency_err, Efficiency_bootstrap_err};
+  };
+  int Workers = ParallelNLL::GetAvailableCPUs(settings.contains("NumberCPUs") ? settings.getI("NumberCPUs") : 0);
+  Workers = std::max(1, std::min(Workers, static_cast<int>(Modes.size())));
+  std::vector<int> ModeIndices(Modes.size());
+  for(std::size_t i = 0; i < Modes.size(); i++) {
+    ModeIndices[i] = i;
+  }
+  std::vector<std::vector<double>> Results;
+  if(Workers == 1) {
+    for(auto i : ModeIndices) {
+      Results.push_back(GetEfficiency(i));
+    }
+  } else {
+    ROOT::TProcessExecutor Executor(Workers);
+    Results = Executor.Map(GetEfficiency, ModeIndices);
+  }
+  std::ofstream Outfile(settings.get("SingleTagEfficienciesFilename"));
+  Outfile << "* Single tag efficiencies\n\n";
+  for(std::size_t i = 0; i < Modes.size(); i++) {
+    Outfile << Modes[i] << "_SingleTagEfficiency     " << Results[i][0] << "\n";
+    Outfile << Modes[i] << "_SingleTagEfficiency_err " << Results[i][1] << "\n";
+    if(BootstrapSamples > 1) {
+      Outfile << Modes[i] << "_SingleTagEfficiency_bootstrap_err " << Results[i][2] << "\n";
+    }
   }
   Outfile.close();
   std::cout << "Single tag efficiencies saved\n";
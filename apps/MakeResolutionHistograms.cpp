@@ -1,51 +1,103 @@
 // Martin Duy Tat 3rd December 2021
 /**
  * MakeResolutionHistograms will loop over an MC sample and create a histogram for each \f$D\f$ daughter in the \f$KK\pi\pi\f$ decay
+ * The entries are split into ranges that are processed in parallel, and the resolution of each component is accumulated in a single pass
+ * Optionally, a summary with the mean, standard deviation and quantiles of each component is saved, which BinMigrationStudy can read directly
  */
 
 #include<iostream>
+#include<fstream>
+#include<iomanip>
 #include<string>
-#include<map>
 #include<vector>
+#include<memory>
+#include<algorithm>
 #include"TChain.h"
 #include"TH1D.h"
 #include"TFile.h"
+#include"ROOT/TProcessExecutor.hxx"
+#include"ROOT/TSeq.hxx"
 #include"Utilities.h"
 #include"Settings.h"
+#include"ParallelNLL.h"
+#include"Instrumentation.h"
+#include"OutputWriter.h"
+#include"ResolutionAccumulator.h"
 #include"PhaseSpace/KKpipi_PhaseSpace.h"
 
 int main(int argc, char *argv[]) {
   std::cout << "Making D->KKpipi daughter resolution histograms\n";
   Settings settings = Utilities::parse_args(argc, argv);
   std::string TreeName = settings.get("TreeName");
-  std::cout << "Loading double tag events and setting up output TTree...\n";
+  std::cout << "Loading double tag events...\n";
   TChain InputChain(TreeName.c_str());
   InputChain.Add(settings.get("InputFilename").c_str());
-  std::unique_ptr<KKpipi_PhaseSpace> PhaseSpace = Utilities::GetPhaseSpaceBinning(settings, &InputChain);
-  std::cout << "TTree and phase space ready\n";
-  std::string HistogramsFilename = settings.get("HistogramsFilename");
-  TFile OutputFile(HistogramsFilename.c_str(), "RECREATE");
+  const Long64_t Entries = InputChain.GetEntries();
   std::vector<std::string> Particles{"Kplus", "Kminus", "piplus", "piminus"};
   std::vector<std::string> Components{"PX", "PY", "PZ", "PE"};
-  std::map<std::string, TH1D> Histograms;
-  std::cout << "Filling histograms...\n";
-  for(const auto &Particle : Particles) {
-    for(const auto &Component : Components) {
-      Histograms.insert({Particle + Component, TH1D((Particle + Component + "_h").c_str(), "", 100, 0.0, 0.0)});
+  const double Range = settings.contains("ResolutionRange") ? settings.getD("ResolutionRange") : 0.1;
+  int Workers = ParallelNLL::GetAvailableCPUs(settings.contains("NumberCPUs") ? settings.getI("NumberCPUs") : 0);
+  Workers = std::max(1, static_cast<int>(std::min<Long64_t>(Workers, Entries)));
+  std::cout << "Accumulating resolutions of " << Entries << " events with " << Workers << " workers...\n";
+  Instrumentation::ScopedTimer Timer("MakeResolutionHistograms::Accumulate");
+  Timer.AddEvents(Entries);
+  // Each worker has its own TChain and phase space, and returns its packed accumulator
+  auto AccumulateRange = [&] (int Worker) {
+    TChain Chain(TreeName.c_str());
+    Chain.Add(settings.get("InputFilename").c_str());
+    std::unique_ptr<KKpipi_PhaseSpace> PhaseSpace = Utilities::GetPhaseSpaceBinning(settings, &Chain);
+    ResolutionAccumulator Accumulator(Particles.size()*Components.size(), Range);
+    const Long64_t First = Worker*Entries/Workers;
+    const Long64_t Last = (Worker + 1)*Entries/Workers;
+    for(Long64_t i = First; i < Last; i++) {
+      Chain.GetEntry(i);
+      PhaseSpace->TrueBin();
+      Accumulator.Fill(PhaseSpace->GetMomentumResolution());
     }
+    return Accumulator.Serialize();
+  };
+  std::vector<std::vector<double>> Results;
+  if(Workers == 1) {
+    Results.push_back(AccumulateRange(0));
+  } else {
+    ROOT::TProcessExecutor Executor(Workers);
+    Results = Executor.Map(AccumulateRange, ROOT::TSeqI(Workers));
   }
-  for(int i = 0; i < InputChain.GetEntries(); i++) {
-    InputChain.GetEntry(i);
-    PhaseSpace->TrueBin();
-    auto Resolution = PhaseSpace->GetMomentumResolution();
-    for(int j = 0; j < 4; j++) {
-      for(int k = 0; k < 4; k++) {
-	Histograms.at(Particles[j] + Components[k]).Fill(Resolution[4*j + k]);
-      }
+  // Merge in worker order so that the result is independent of scheduling
+  ResolutionAccumulator Accumulator(Particles.size()*Components.size(), Range);
+  for(const auto &Result : Results) {
+    Accumulator.Merge(ResolutionAccumulator::Deserialize(Result));
+  }
+  Timer.Stop();
+  std::cout << "Saving histograms...\n";
+  std::string HistogramsFilename = settings.get("HistogramsFilename");
+  auto OutputFile = OutputWriter::OpenFile(HistogramsFilename, OutputWriter::Stage::Archival);
+  for(std::size_t j = 0; j < Particles.size(); j++) {
+    for(std::size_t k = 0; k < Components.size(); k++) {
+      TH1D Histogram = Accumulator.MakeHistogram(4*j + k, Particles[j] + Components[k] + "_h");
+      OutputFile->cd();
+      Histogram.Write();
     }
   }
-  OutputFile.Write();
-  OutputFile.Close();
+  OutputFile->Close();
   std::cout << "Resolution histograms saved\n";
+  if(settings.contains("ResolutionSummaryFilename")) {
+    std::ofstream Summary(settings.get("ResolutionSummaryFilename"));
+    Summary << "* D->KKpipi daughter momentum resolution from " << Accumulator.GetEntries() << " events\n\n";
+    Summary << std::scientific << std::setprecision(6);
+    for(std::size_t j = 0; j < Particles.size(); j++) {
+      for(std::size_t k = 0; k < Components.size(); k++) {
+	const int i = 4*j + k;
+	const std::string Name = Particles[j] + Components[k];
+	Summary << Name << "_Mean " << Accumulator.GetMean(i) << "\n";
+	Summary << Name << "_StdDev " << Accumulator.GetStdDev(i) << "\n";
+	Summary << Name << "_Q16 " << Accumulator.GetQuantile(i, 0.1587) << "\n";
+	Summary << Name << "_Q50 " << Accumulator.GetQuantile(i, 0.5) << "\n";
+	Summary << Name << "_Q84 " << Accumulator.GetQuantile(i, 0.8413) << "\n";
+      }
+    }
+    Summary.close();
+    std::cout << "Resolution summary saved\n";
+  }
   return 0;
 }
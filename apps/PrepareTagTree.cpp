@@ -17,6 +17,8 @@
 #include"Utilities.h"
 #include"ApplyCuts.h"
 #include"Settings.h"
+#include"Instrumentation.h"
+#include"OutputWriter.h"
 
 std::vector<std::string> ParseDatasets(std::string DatasetsString);
 
@@ -39,6 +41,7 @@ int main(int argc, char *argv[]) {
   bool TruthMatch = settings.getB("TruthMatch");
   std::string TreeName = settings.get("TreeName");
   std::vector<std::string> Datasets = Utilities::ConvertStringToVector(settings.get("Datasets_to_include"));
+  OutputWriter::EnableParallelCompression();
   std::cout << "Sample prepration of " << TagType << " ";
   if(TagType == "DT") {
     std::cout << SignalMode << "vs ";
@@ -82,16 +85,21 @@ int main(int argc, char *argv[]) {
 	NewFilename.replace(NewFilename.find("YEAR"), 4, Year);
       }
       Chain.Add(NewFilename.c_str());
-      if(Chain.GetEntries() == 0) {
+      const Long64_t Entries = Chain.GetEntries();
+      if(Entries == 0) {
 	std::cout << "WARNING: No entries in " << OutputFilename << "\n";
 	continue;
       }
       std::cout << "Applying cuts...\n";
-      TFile OutputFile(OutputFilename.c_str(), "RECREATE");
+      Instrumentation::ScopedTimer Timer("PrepareTagTree::ApplyCuts");
+      Timer.AddEvents(Entries);
+      auto OutputFile = OutputWriter::OpenFile(OutputFilename, OutputWriter::Stage::Intermediate);
       TTree *OutputTree = applyCuts(&Chain, DataSetType, LuminosityScale);
-      OutputTree->SetDirectory(&OutputFile);
+      Instrumentation::AddCount("EventsSelected", OutputTree->GetEntries());
+      OutputTree->SetDirectory(OutputFile.get());
       OutputTree->Write();
-      OutputFile.Close();
+      OutputFile->Close();
+      Timer.Stop();
       // I think this line prevents a seg fault for some reason
       gDirectory->Clear();
       std::cout << "Cuts applied and events saved to file " << OutputFilename << "\n";
@@ -0,0 +1,93 @@
+// Martin Duy Tat 19th October 2026
+
+#include<iostream>
+#include<iomanip>
+#include<fstream>
+#include<string>
+#include<vector>
+#include<utility>
+#include<algorithm>
+#include<chrono>
+#include<ctime>
+#include<functional>
+#include"Benchmark.h"
+
+namespace Benchmark {
+  namespace {
+    std::vector<std::pair<std::string, std::function<void(long long)>>>& GetBenchmarks() {
+      static std::vector<std::pair<std::string, std::function<void(long long)>>> Benchmarks;
+      return Benchmarks;
+    }
+    double GetCPUTime() {
+      timespec Time;
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &Time);
+      return Time.tv_sec + 1e-9*Time.tv_nsec;
+    }
+  }
+
+  void Register(const std::string &Name, std::function<void(long long)> Function) {
+    GetBenchmarks().push_back({Name, Function});
+  }
+
+  int RunAll(int argc, char *argv[]) {
+    std::string Filter, JSONFilename;
+    double MinTime = 0.5;
+    for(int i = 1; i < argc; i++) {
+      std::string Argument(argv[i]);
+      if(Argument == "--filter" && i + 1 < argc) {
+	Filter = argv[++i];
+      } else if(Argument == "--min_time" && i + 1 < argc) {
+	MinTime = std::stod(argv[++i]);
+      } else if(Argument == "--json" && i + 1 < argc) {
+	JSONFilename = argv[++i];
+      } else {
+	std::cout << "Usage: " << argv[0] << " [--filter <substring>] [--min_time <seconds>] [--json <filename>]\n";
+	return 1;
+      }
+    }
+    std::vector<Result> Results;
+    std::cout << std::left << std::setw(50) << "Benchmark" << std::right << std::setw(16) << "Time (ns)" << std::setw(16) << "CPU (ns)" << std::setw(14) << "Iterations" << "\n";
+    std::cout << std::string(96, '-') << "\n";
+    for(const auto &Benchmark : GetBenchmarks()) {
+      if(!Filter.empty() && Benchmark.first.find(Filter) == std::string::npos) {
+	continue;
+      }
+      // Warm up caches and lazy initialisation before timing
+      Benchmark.second(1);
+      long long Iterations = 1;
+      double WallTime = 0.0, CPUTime = 0.0;
+      while(true) {
+	auto WallStart = std::chrono::steady_clock::now();
+	double CPUStart = GetCPUTime();
+	Benchmark.second(Iterations);
+	WallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - WallStart).count();
+	CPUTime = GetCPUTime() - CPUStart;
+	if(WallTime >= MinTime || Iterations >= (1LL << 40)) {
+	  break;
+	}
+	// Aim directly for the minimum time, but never grow by more than a factor of 10
+	double Scale = WallTime > 0.0 ? 1.4*MinTime/WallTime : 10.0;
+	Iterations = static_cast<long long>(Iterations*std::min(10.0, std::max(2.0, Scale)));
+      }
+      Result result{Benchmark.first, Iterations, 1e9*WallTime/Iterations, 1e9*CPUTime/Iterations};
+      std::cout << std::left << std::setw(50) << result.Name << std::right << std::fixed << std::setprecision(1);
+      std::cout << std::setw(16) << result.WallTime << std::setw(16) << result.CPUTime << std::setw(14) << result.Iterations << "\n";
+      std::cout.unsetf(std::ios_base::floatfield);
+      Results.push_back(result);
+    }
+    if(!JSONFilename.empty()) {
+      std::ofstream Outfile(JSONFilename);
+      Outfile << "{\n  \"benchmarks\": [";
+      for(std::size_t i = 0; i < Results.size(); i++) {
+	Outfile << (i == 0 ? "\n" : ",\n");
+	Outfile << "    {\"name\": \"" << Results[i].Name << "\", ";
+	Outfile << "\"iterations\": " << Results[i].Iterations << ", ";
+	Outfile << "\"real_time\": " << Results[i].WallTime << ", ";
+	Outfile << "\"cpu_time\": " << Results[i].CPUTime << ", ";
+	Outfile << "\"time_unit\": \"ns\"}";
+      }
+      Outfile << "\n  ]\n}\n";
+    }
+    return 0;
+  }
+}
@@ -0,0 +1,57 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * Benchmark is a minimal benchmark harness in the style of Google Benchmark
+ * Each benchmark is a function that runs a given number of iterations, and the harness keeps doubling the number of iterations until the run takes long enough to give a stable time per iteration
+ */
+
+#ifndef BENCHMARK
+#define BENCHMARK
+
+#include<string>
+#include<vector>
+#include<functional>
+
+namespace Benchmark {
+  /**
+   * Result of a single benchmark
+   */
+  struct Result {
+    /**
+     * Name of the benchmark
+     */
+    std::string Name;
+    /**
+     * Number of iterations in the final run
+     */
+    long long Iterations;
+    /**
+     * Wall time per iteration in nanoseconds
+     */
+    double WallTime;
+    /**
+     * CPU time per iteration in nanoseconds
+     */
+    double CPUTime;
+  };
+  /**
+   * Prevent the compiler from optimising away a value that is computed in a benchmark
+   */
+  template<typename T>
+  inline void DoNotOptimize(const T &Value) {
+    asm volatile("" : : "r,m"(Value) : "memory");
+  }
+  /**
+   * Register a benchmark
+   * @param Name Name of the benchmark
+   * @param Function Function that runs the benchmark for the given number of iterations
+   */
+  void Register(const std::string &Name, std::function<void(long long)> Function);
+  /**
+   * Run all registered benchmarks and print the results
+   * Command line options are --filter <substring>, --min_time <seconds> and --json <filename>
+   * @return Exit code of the application
+   */
+  int RunAll(int argc, char *argv[]);
+}
+
+#endif
@@ -0,0 +1,319 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * BenchmarkSuite measures the time per call of the phase space binning and fit building blocks
+ * All input is synthetic and generated in memory, so no BESIII data is needed
+ */
+
+#include<iostream>
+#include<string>
+#include<vector>
+#include<memory>
+#include<cstdlib>
+#include<cstdio>
+#include<unistd.h>
+#include"TTree.h"
+#include"TFile.h"
+#include"TH2F.h"
+#include"TRandom3.h"
+#include"TGenPhaseSpace.h"
+#include"TLorentzVector.h"
+#include"TMatrixT.h"
+#include"RooRealVar.h"
+#include"RooDataSet.h"
+#include"RooSimultaneous.h"
+#include"RooMsgService.h"
+#include"Settings.h"
+#include"Utilities.h"
+#include"Category.h"
+#include"CholeskySmearing.h"
+#include"BinnedFitModel.h"
+#include"ParallelNLL.h"
+#include"PhaseSpace/KKpipi_vs_CP_PhaseSpace.h"
+#include"PhaseSpace/DalitzUtilities.h"
+#include"Benchmark.h"
+
+namespace {
+  /**
+   * Number of events in the synthetic trees
+   */
+  const int NumberEvents = 10000;
+
+  /**
+   * Phase space class that makes the KKpipi binning functions available to the benchmarks
+   */
+  class BenchmarkPhaseSpace: public KKpipi_vs_CP_PhaseSpace {
+    public:
+      BenchmarkPhaseSpace(TTree *Tree): KKpipi_vs_CP_PhaseSpace(Tree, 8, true, true) {}
+      using KKpipi_PhaseSpace::KKpipiBin;
+      using KKpipi_PhaseSpace::TrueKKpipiBin;
+      using KKpipi_PhaseSpace::FindDIndex;
+  };
+
+  /**
+   * Generate a tree of \f$D^0\to KK\pi\pi\f$ vs \f$\bar{D^0}\to KK\f$ events with the same branches as the double tag ntuples
+   */
+  std::unique_ptr<TTree> GenerateKKpipiTree() {
+    std::unique_ptr<TTree> Tree(new TTree("BenchmarkTree", ""));
+    Tree->SetDirectory(nullptr);
+    int KalmanFitSuccess = 1;
+    std::vector<double> Momenta(16), MomentaKalmanFit(16);
+    const std::vector<std::string> Particles{"KPlus", "KMinus", "PiPlus", "PiMinus"};
+    const std::vector<std::string> Components{"px", "py", "pz", "energy"};
+    Tree->Branch("SignalKalmanFitSuccess", &KalmanFitSuccess);
+    for(std::size_t i = 0; i < Particles.size(); i++) {
+      for(std::size_t j = 0; j < Components.size(); j++) {
+	std::string Name = "Signal" + Particles[i] + Components[j];
+	Tree->Branch(Name.c_str(), &Momenta[4*i + j]);
+	Tree->Branch((Name + "KalmanFit").c_str(), &MomentaKalmanFit[4*i + j]);
+      }
+    }
+    int NumberParticles = 9;
+    std::vector<int> ParticleIDs{421, 321, -321, 211, -211, -421, 321, -321, 22};
+    std::vector<int> MotherIndex{-1, 0, 0, 0, 0, -1, 5, 5, 5};
+    std::vector<double> TruePx(100), TruePy(100), TruePz(100), TrueEnergy(100);
+    Tree->Branch("NumberOfParticles", &NumberParticles);
+    Tree->Branch("ParticleIDs", ParticleIDs.data(), "ParticleIDs[NumberOfParticles]/I");
+    Tree->Branch("MotherIndex", MotherIndex.data(), "MotherIndex[NumberOfParticles]/I");
+    Tree->Branch("True_Px", TruePx.data(), "True_Px[NumberOfParticles]/D");
+    Tree->Branch("True_Py", TruePy.data(), "True_Py[NumberOfParticles]/D");
+    Tree->Branch("True_Pz", TruePz.data(), "True_Pz[NumberOfParticles]/D");
+    Tree->Branch("True_Energy", TrueEnergy.data(), "True_Energy[NumberOfParticles]/D");
+    TLorentzVector D0(0.0, 0.0, 0.0, 1.86484);
+    const double Masses[4] = {0.493677, 0.493677, 0.13957, 0.13957};
+    TGenPhaseSpace Generator;
+    Generator.SetDecay(D0, 4, Masses);
+    for(int i = 0; i < NumberEvents; i++) {
+      Generator.Generate();
+      for(int j = 0; j < 4; j++) {
+	const TLorentzVector *Daughter = Generator.GetDecay(j);
+	for(int k = 0; k < 4; k++) {
+	  MomentaKalmanFit[4*j + k] = (*Daughter)[k];
+	  Momenta[4*j + k] = (*Daughter)[k] + (k < 3 ? gRandom->Gaus(0.0, 0.005) : 0.0);
+	  (k == 0 ? TruePx : k == 1 ? TruePy : k == 2 ? TruePz : TrueEnergy)[j + 1] = (*Daughter)[k];
+	}
+      }
+      KalmanFitSuccess = gRandom->Uniform() < 0.9 ? 1 : 0;
+      Tree->Fill();
+    }
+    return Tree;
+  }
+
+  /**
+   * Generate a lookup histogram with 8 bins inside a triangular Dalitz region and zero outside
+   */
+  std::unique_ptr<TH2F> GenerateBinningScheme() {
+    std::unique_ptr<TH2F> BinningScheme(new TH2F("BenchmarkBinning", "", 300, 0.0, 3.0, 300, 0.0, 3.0));
+    BinningScheme->SetDirectory(nullptr);
+    for(int x = 1; x <= 300; x++) {
+      for(int y = 1; y <= 300; y++) {
+	double M2Plus = BinningScheme->GetXaxis()->GetBinCenter(x);
+	double M2Minus = BinningScheme->GetYaxis()->GetBinCenter(y);
+	if(M2Plus + M2Minus > 0.8 && M2Plus + M2Minus < 3.0) {
+	  BinningScheme->SetBinContent(x, y, 1 + static_cast<int>(4.0*(M2Plus + M2Minus - 0.8)/2.2)%8);
+	}
+      }
+    }
+    return BinningScheme;
+  }
+
+  /**
+   * Settings of a double tag yield fit of \f$KK\pi\pi\f$ vs \f$K_S\pi\pi\f$ with 8 bins
+   */
+  Settings GetFitSettings(const std::string &Mode, const std::string &SignalMCFilename) {
+    Settings settings("Benchmark");
+    settings.set_value("Mode", Mode, "benchmark", false);
+    settings.set_value("TagType", "DT", "benchmark", false);
+    settings.set_value("TreeName", "BenchmarkTree", "benchmark", false);
+    settings.set_value("FitVariable", "SignalMBC", "benchmark", false);
+    settings.set_value("FullyReconstructed", "true", "benchmark", false);
+    settings.set_value("Events_in_MC", "-1", "benchmark", false);
+    settings.set_value("BinningScheme/NumberBins", "8", "benchmark", false);
+    settings.set_value("Datasets_WithDeltaECuts/SignalMC_DT", SignalMCFilename, "benchmark", false);
+    settings.set_value("MBC_Shape/" + Mode + "_PeakingBackgrounds", "0", "benchmark", false);
+    settings.set_value("MBC_Shape/" + Mode + "_DoubleTag_Mean1", "0.0", "benchmark", false);
+    settings.set_value("MBC_Shape/" + Mode + "_DoubleTag_Sigma1", "0.001", "benchmark", false);
+    settings.set_value("MBC_Shape/" + Mode + "_DoubleTag_c", "-20.0", "benchmark", false);
+    settings.set_value("MBC_Shape/" + Mode + "_DoubleTag_c_limL", "-100.0", "benchmark", false);
+    settings.set_value("MBC_Shape/" + Mode + "_DoubleTag_c_limU", "0.0", "benchmark", false);
+    return settings;
+  }
+
+  /**
+   * Write a signal MC file with a peaking beam constrained mass distribution
+   */
+  void GenerateSignalMC(const std::string &Filename) {
+    TFile File(Filename.c_str(), "RECREATE");
+    TTree Tree("BenchmarkTree", "");
+    double SignalMBC;
+    Tree.Branch("SignalMBC", &SignalMBC);
+    for(int i = 0; i < 2000; i++) {
+      SignalMBC = gRandom->Gaus(1.8648, 0.0015);
+      if(SignalMBC < 1.8865) {
+	Tree.Fill();
+      }
+    }
+    Tree.Write();
+    File.Close();
+  }
+
+  void RegisterPhaseSpaceBenchmarks(TTree *Tree, BenchmarkPhaseSpace *PhaseSpace) {
+    Benchmark::Register("TTree::GetEntry", [=] (long long Iterations) {
+      for(long long i = 0; i < Iterations; i++) {
+	Tree->GetEntry(i%NumberEvents);
+      }
+    });
+    Benchmark::Register("KKpipi_PhaseSpace::KKpipiBin (with GetEntry)", [=] (long long Iterations) {
+      int Sum = 0;
+      for(long long i = 0; i < Iterations; i++) {
+	Tree->GetEntry(i%NumberEvents);
+	Sum += PhaseSpace->KKpipiBin();
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+    Benchmark::Register("KKpipi_PhaseSpace::TrueKKpipiBin (with GetEntry)", [=] (long long Iterations) {
+      int Sum = 0;
+      for(long long i = 0; i < Iterations; i++) {
+	Tree->GetEntry(i%NumberEvents);
+	PhaseSpace->FindDIndex();
+	Sum += PhaseSpace->TrueKKpipiBin();
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+  }
+
+  void RegisterDalitzBenchmarks(const TH2F *BinningScheme) {
+    std::vector<std::pair<double, double>> Points(NumberEvents);
+    for(auto &Point : Points) {
+      Point = std::make_pair(gRandom->Uniform(0.0, 3.0), gRandom->Uniform(0.0, 3.0));
+    }
+    Benchmark::Register("DalitzUtilities::LookUpBinNumber", [=] (long long Iterations) {
+      int Sum = 0;
+      for(long long i = 0; i < Iterations; i++) {
+	const auto &Point = Points[i%NumberEvents];
+	Sum += DalitzUtilities::LookUpBinNumber(Point.first, Point.second, BinningScheme);
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+    // Points just outside the boundary, where the mapping has to search for the nearest bin
+    std::vector<std::pair<double, double>> OutsidePoints(NumberEvents);
+    for(auto &Point : OutsidePoints) {
+      double Sum = gRandom->Uniform(3.0, 3.1);
+      double M2Plus = gRandom->Uniform(0.1, Sum - 0.1);
+      Point = std::make_pair(M2Plus, Sum - M2Plus);
+    }
+    Benchmark::Register("DalitzUtilities::GetMappedK0hhBin", [=] (long long Iterations) {
+      int Sum = 0;
+      for(long long i = 0; i < Iterations; i++) {
+	const auto &Point = OutsidePoints[i%NumberEvents];
+	Sum += DalitzUtilities::GetMappedK0hhBin(Point.first, Point.second, BinningScheme);
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+  }
+
+  void RegisterCategoryBenchmarks(const Settings &settings, const Category *category) {
+    std::vector<std::string> Categories = category->GetCategories();
+    std::vector<std::pair<int, int>> Bins = category->GetBinCombinations();
+    Benchmark::Register("Category::GetCategory", [=] (long long Iterations) {
+      std::size_t Sum = 0;
+      for(long long i = 0; i < Iterations; i++) {
+	const auto &Bin = Bins[i%Bins.size()];
+	Sum += category->GetCategory(Bin.first, Bin.second).size();
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+    Benchmark::Register("Category::GetCategoryIndex", [=] (long long Iterations) {
+      int Sum = 0;
+      for(long long i = 0; i < Iterations; i++) {
+	Sum += category->GetCategoryIndex(Categories[i%Categories.size()]);
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+    Benchmark::Register("Settings::getD", [&settings] (long long Iterations) {
+      double Sum = 0.0;
+      for(long long i = 0; i < Iterations; i++) {
+	Sum += settings["MBC_Shape"].getD("KSpipi_DoubleTag_Sigma1");
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+  }
+
+  void RegisterSmearingBenchmarks(CholeskySmearing *Smearing) {
+    Benchmark::Register("CholeskySmearing::Smear (128x128)", [=] (long long Iterations) {
+      double Sum = 0.0;
+      for(long long i = 0; i < Iterations; i++) {
+	Smearing->Smear();
+	Sum += Smearing->GetSmearing(0);
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+  }
+
+  void RegisterNLLBenchmarks(RooRealVar *Yield, RooAbsReal *NLL, const std::string &Name) {
+    Benchmark::Register(Name, [=] (long long Iterations) {
+      double Sum = 0.0;
+      for(long long i = 0; i < Iterations; i++) {
+	// Change a parameter so that the likelihood is evaluated again
+	Yield->setVal(Yield->getVal() == 10.0 ? 10.5 : 10.0);
+	Sum += NLL->getVal();
+      }
+      Benchmark::DoNotOptimize(Sum);
+    });
+  }
+}
+
+int main(int argc, char *argv[]) {
+  for(int i = 0; i < 2; i++) {
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Eval);
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Caching);
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Minimization);
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Plotting);
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Fitting);
+  }
+  gRandom->SetSeed(42);
+  // Phase space binning
+  std::unique_ptr<TTree> Tree = GenerateKKpipiTree();
+  BenchmarkPhaseSpace PhaseSpace(Tree.get());
+  RegisterPhaseSpaceBenchmarks(Tree.get(), &PhaseSpace);
+  std::unique_ptr<TH2F> BinningScheme = GenerateBinningScheme();
+  RegisterDalitzBenchmarks(BinningScheme.get());
+  // The signal MC of the fit model is read from a file, so put it in a temporary directory
+  char TemporaryDirectory[] = "/tmp/KKpipiBenchmarkXXXXXX";
+  if(!mkdtemp(TemporaryDirectory)) {
+    std::cout << "Cannot create temporary directory\n";
+    return 1;
+  }
+  std::string SignalMCFilename = std::string(TemporaryDirectory) + "/SignalMC_TAG.root";
+  GenerateSignalMC(Utilities::ReplaceString(SignalMCFilename, "TAG", "KSpipi"));
+  Settings settings = GetFitSettings("KSpipi", SignalMCFilename);
+  Category category(settings);
+  RegisterCategoryBenchmarks(settings, &category);
+  // Smearing with a covariance matrix of the size of a KSpipi binned fit
+  const int Size = 128;
+  TMatrixT<double> CovMatrix(Size, Size);
+  for(int i = 0; i < Size; i++) {
+    for(int j = 0; j < Size; j++) {
+      CovMatrix(i, j) = (i == j ? 1.0 : 0.2)*(1.0 + 0.01*i)*(1.0 + 0.01*j);
+    }
+  }
+  CholeskySmearing Smearing(CovMatrix);
+  RegisterSmearingBenchmarks(&Smearing);
+  // Likelihood of the binned double tag fit with a dataset generated from the model itself
+  RooRealVar SignalMBC("SignalMBC", "", 1.83, 1.8865);
+  SignalMBC.setBins(500, "cache");
+  BinnedFitModel FitModel(settings, &SignalMBC);
+  RooSimultaneous *Model = FitModel.GetPDF();
+  std::unique_ptr<RooDataSet> DataSet(Model->generate(RooArgSet(SignalMBC, *category.GetCategoryVariable()), 20*static_cast<int>(category.GetCategories().size())));
+  std::unique_ptr<RooArgSet> Parameters(Model->getParameters(*DataSet));
+  RooRealVar *Yield = static_cast<RooRealVar*>(Parameters->find((category.GetCategories()[0] + "_SignalYield").c_str()));
+  std::unique_ptr<RooAbsReal> RooFitNLL(Model->createNLL(*DataSet, RooFit::Extended(true)));
+  RegisterNLLBenchmarks(Yield, RooFitNLL.get(), "BinnedFitModel NLL evaluation (RooFit)");
+  ParallelNLL SerialNLL("BenchmarkNLL", *Model, *DataSet, 1);
+  RegisterNLLBenchmarks(Yield, &SerialNLL, "BinnedFitModel NLL evaluation (ParallelNLL, 1 CPU)");
+  ParallelNLL MultiNLL("BenchmarkNLL_Multi", *Model, *DataSet, ParallelNLL::GetAvailableCPUs());
+  RegisterNLLBenchmarks(Yield, &MultiNLL, "BinnedFitModel NLL evaluation (ParallelNLL, all CPUs)");
+  int ExitCode = Benchmark::RunAll(argc, argv);
+  std::remove((Utilities::ReplaceString(SignalMCFilename, "TAG", "KSpipi")).c_str());
+  rmdir(TemporaryDirectory);
+  return ExitCode;
+}
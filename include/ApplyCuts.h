@@ -20,6 +20,7 @@ class ApplyCuts {
     /**
      * () operator overload so that one can pass a TTree or TChain to this object and get a skimmed TTree back
      * If a dataset type and luminosity scale is given, these branches are also added to the final TTree
+     * The skimmed TTree is created in the current directory and configured by OutputWriter::ConfigureTree, so the current directory must be the output file
      * @param TTree or TChain with event
      * @param DataSetType Integer between \f$0\f$ and \f$9\f$, labelling the dataset (description in PrepareTagTree application)
      * @param LuminosityScale Luminosity scale of MC, TTree will be filled with the inverse of this to scale MC to that of data
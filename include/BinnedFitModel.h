@@ -20,6 +20,7 @@
 #include"RooShapes/FitShape.h"
 
 class DoubleTagYield;
+class GlobalDoubleTagYield;
 
 class BinnedFitModel {
   public:
@@ -27,8 +28,9 @@ class BinnedFitModel {
      * Constructor that takes in the signal MC TTree and sets up the signal shape for all the bins
      * @param settings Fit settings
      * @param SignalMBC The fit variable
+     * @param SharedParameters Map of parameters shared with other tag modes, where a nullptr is replaced by the parameter the first time it's loaded
      */
-    BinnedFitModel(const Settings &settings, RooRealVar *SignalMBC);
+    BinnedFitModel(const Settings &settings, RooRealVar *SignalMBC, std::map<std::string, RooRealVar*> *SharedParameters = nullptr);
     /**
      * Destructor that deletes the simultaneous PDF and the peaking background shapes
      */
@@ -45,6 +47,10 @@ class BinnedFitModel {
      * DoubleTagYield is a friend so that it can access the yield variables
      */
     friend class DoubleTagYield;
+    /**
+     * GlobalDoubleTagYield is a friend so that it can access the yield variables
+     */
+    friend class GlobalDoubleTagYield;
   private:
     /**
      * The fit variable
@@ -76,6 +82,7 @@ class BinnedFitModel {
     void InitializeSignalShape();
     /**
      * Create the combinatorial component for all bins
+     * Partially reconstructed tags use a Chebychev polynomial with coefficients <Mode>_Combinatorial_c<i> in MBC_Shape
      */
     void InitializeCombinatorialShape();
     /**
@@ -118,6 +125,15 @@ class BinnedFitModel {
      * Helper function that sets up all the Cholesky decompositions for smearing of correlated peaking backgrounds
      */
     void PrepareSmearing();
+    /**
+     * Parameters that are shared with other tag modes in a global fit
+     */
+    std::map<std::string, RooRealVar*> *m_SharedParameters;
+    /**
+     * Helper function that loads a signal shape or combinatorial parameter, or uses the shared parameter if it's shared between tag modes
+     * @param Name Name of parameter, such as "Mean1", "Sigma1" or "c"
+     */
+    RooRealVar* LoadParameter(const std::string &Name);
 };
 
 #endif
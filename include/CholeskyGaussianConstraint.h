@@ -0,0 +1,104 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * CholeskyGaussianConstraint is a multidimensional Gaussian PDF for constraining correlated parameters
+ * The Cholesky factor \f$L\f$ of the covariance matrix is computed once, and \f$\chi^2 = |L^{-1}(x - \mu)|^2\f$ is evaluated by forward substitution
+ * The gradient of \f$\chi^2/2\f$ is available directly, and the integral over any subset of the parameters is analytic
+ * The class has a dictionary, so that it can be streamed and imported into a RooWorkspace
+ */
+
+#ifndef CHOLESKYGAUSSIANCONSTRAINT
+#define CHOLESKYGAUSSIANCONSTRAINT
+
+#include<vector>
+#include"TMatrixT.h"
+#include"RooAbsPdf.h"
+#include"RooListProxy.h"
+#include"RooArgList.h"
+#include"RooArgSet.h"
+
+class CholeskyGaussianConstraint: public RooAbsPdf {
+  public:
+    /**
+     * Default constructor needed for streaming
+     */
+    CholeskyGaussianConstraint();
+    /**
+     * Constructor that takes in the parameters, their means and covariance matrix
+     * @param Name Name of PDF
+     * @param Title Title of PDF
+     * @param Parameters The constrained parameters
+     * @param Mean The central values of the parameters
+     * @param CovMatrix The covariance matrix of the parameters
+     */
+    CholeskyGaussianConstraint(const char *Name, const char *Title, const RooArgList &Parameters, const std::vector<double> &Mean, const TMatrixT<double> &CovMatrix);
+    /**
+     * Copy constructor
+     */
+    CholeskyGaussianConstraint(const CholeskyGaussianConstraint &Other, const char *Name = nullptr);
+    /**
+     * Clone function required by RooFit
+     */
+    virtual TObject* clone(const char *NewName) const;
+    /**
+     * Advertise the analytic integral over the parameters in AllVars, where each subset gets its own code
+     */
+    virtual Int_t getAnalyticalIntegral(RooArgSet &AllVars, RooArgSet &AnalVars, const char *RangeName = nullptr) const;
+    /**
+     * Calculate the analytic integral, which is a Gaussian in the parameters that are not integrated over
+     */
+    virtual Double_t analyticalIntegral(Int_t Code, const char *RangeName = nullptr) const;
+    /**
+     * Get \f$\chi^2\f$ at the current parameter values
+     */
+    double GetChi2() const;
+    /**
+     * Get the gradient of \f$\chi^2/2\f$ with respect to the parameters, which is \f$\Sigma^{-1}(x - \mu)\f$
+     */
+    std::vector<double> GetGradient() const;
+  protected:
+    /**
+     * Evaluate the unnormalised PDF \f$\exp(-\chi^2/2)\f$
+     */
+    virtual Double_t evaluate() const;
+  private:
+    /**
+     * The constrained parameters
+     */
+    RooListProxy m_Parameters;
+    /**
+     * The central values of the parameters
+     */
+    std::vector<double> m_Mean;
+    /**
+     * The lower triangular Cholesky factor of the covariance matrix, stored row by row
+     */
+    std::vector<double> m_CholeskyFactor;
+    /**
+     * The integral of \f$\exp(-\chi^2/2)\f$ over all parameters, which is \f$(2\pi)^{n/2}\det L\f$
+     */
+    double m_Normalisation;
+    /**
+     * The parameters that are left after integrating over the others, and the normalisation and Cholesky factor of their covariance sub-block
+     */
+    struct Marginal {
+      std::vector<int> Remaining;
+      std::vector<double> CholeskyFactor;
+      double Normalisation = 1.0;
+    };
+    /**
+     * Marginals of the integrals advertised so far, where the integration code is the index plus one
+     */
+    mutable std::vector<Marginal> m_Marginals; //!
+    /**
+     * Helper function that solves \f$Lz = x - \mu\f$ at the current parameter values
+     */
+    std::vector<double> GetWhitenedResiduals() const;
+    /**
+     * Helper function that sets up the marginal Gaussian of the remaining parameters
+     * @param Remaining Indices of the parameters that are not integrated over
+     */
+    Marginal GetMarginal(const std::vector<int> &Remaining) const;
+    ClassDef(CholeskyGaussianConstraint, 1)
+};
+
+#endif
@@ -1,13 +1,16 @@
 // Martin Duy Tat 2nd April 2021
 /**
- * DeltaECut is a class that loads the mode-dependent \f$\Delta E\f$ cuts from text files in the directory DeltaECuts and puts them together
- * The text files must have two space-separated numbers, being the lower and upper \f$\Delta E\f$ cut
+ * DeltaECut is a class that loads the mode-dependent \f$\Delta E\f$ cuts from the cuts database in the directory DeltaECuts and puts them together
+ * There is one database for data and one for MC, with lines of the form "<Mode>_DeltaE_LowerCut <value>" and "<Mode>_DeltaE_UpperCut <value>"
+ * Each database is read once per process and cached
  */
 
 #ifndef DELTAECUT
 #define DELTAECUT
 
 #include<string>
+#include<map>
+#include<utility>
 #include"TCut.h"
 
 class DeltaECut {
@@ -24,6 +27,20 @@ class DeltaECut {
      * Function that returns the complete initial cut
      */
     TCut GetDeltaECut() const;
+    /**
+     * Get the table of \f$\Delta E\f$ cuts, which is read from the database the first time it is needed
+     * @param DataMC "MC" or "Data"
+     * @return Map from tag mode to the lower and upper cut
+     */
+    static const std::map<std::string, std::pair<double, double>>& GetDeltaECutTable(const std::string &DataMC);
+    /**
+     * Save \f$\Delta E\f$ cuts to the database, where only the lines of the updated modes are replaced and new modes are added at the end
+     * The database is written to a temporary file that is renamed afterwards, so it is never seen half-written
+     * This also updates the cached table, so it must not be called while other threads read cuts
+     * @param Cuts Map from tag mode to the lower and upper cut
+     * @param DataMC "MC" or "Data"
+     */
+    static void SaveDeltaECuts(const std::map<std::string, std::pair<double, double>> &Cuts, const std::string &DataMC);
   private:
     /**
      * The tag mode of interest
@@ -47,7 +64,16 @@ class DeltaECut {
      * @param TagSide "Signal" or "Tag" for double tags, blank for single tags
      */
     TCut GetDeltaECutFromFile(const std::string &TagMode, const std::string &TagSide = std::string()) const;
-    
+    /**
+     * Helper function that returns the filename of the cuts database
+     * @param DataMC "MC" or "Data"
+     */
+    static std::string GetDeltaECutFilename(const std::string &DataMC);
+    /**
+     * Helper function that parses the cuts database
+     * @param Filename Filename of the cuts database
+     */
+    static std::map<std::string, std::pair<double, double>> ReadDeltaECutFile(const std::string &Filename);
 };
 
 #endif
@@ -2,17 +2,23 @@
 /**
  * DeltaEFit is a class for doing a fit on \f$\Delta E\f$ in an input TTree
  * A double Gaussian with a polynomial background is fitted
+ * The tree is read once into a column store, and every fit builds its own datasets from it, so that fits can be repeated, for example on bootstrap replicas
+ * The fit model is built once, and its parameters are reset to their initial values before every fit
  */
 
 #ifndef DELTAEFIT
 #define DELTAEFIT
 
 #include<string>
+#include<utility>
+#include<vector>
+#include<memory>
 #include"TTree.h"
 #include"RooRealVar.h"
 #include"RooDataHist.h"
 #include"RooDataSet.h"
 #include"RooAbsPdf.h"
+#include"RooArgSet.h"
 #include"RooFitResult.h"
 #include"Settings.h"
 #include"DeltaEFitModel.h"
@@ -20,7 +26,7 @@
 class DeltaEFit {
   public:
     /**
-     * Constructor that takes in a TTree and also initializes all parameters to standard values
+     * Constructor that takes in a TTree, reads \f$\Delta E\f$ and the luminosity weights in a single pass and also initializes all parameters to standard values
      * @param Tree TTree object containing the data from BESIII
      * @param settings The fit settings
      */
@@ -28,28 +34,34 @@ class DeltaEFit {
     /**
      * Function for doing a fit of the \f$\Delta E\f$ distribution
      * First a binned fit with 1000 bins is performed, then a more accurate unbinned fit is performed if necessary
+     * The fitted parameters and plot are only saved when fitting the original sample
+     * @param BootstrapSeed If non-zero, fit a bootstrap replica where each event is given a Poisson weight generated with this seed
      */
-    void FitDeltaE();
+    void FitDeltaE(unsigned int BootstrapSeed = 0);
     /**
      * Save the plot
-     * @param UnbinnedData The dataset
+     * @param PlotData The binned dataset with 400 bins to plot
      * @param FitModel The fit model after fit
      */
-    void SavePlot(const RooDataSet &UnbinnedData, const DeltaEFitModel &FitModel) const;
+    void SavePlot(const RooDataHist &PlotData, const DeltaEFitModel &FitModel) const;
     /**
      * Function for saving the fitted parameters to a text file
      * @param Results The fit results
      */
-    void SaveParameters(RooFitResult *Results);
+    void SaveParameters(RooFitResult *Results) const;
     /**
-     * Reload settings
+     * Reload settings and rebuild the fit model
      */
     void ReloadSettings(const Settings &settings);
-  private:
     /**
-     * TTree containing the data we want to fit
+     * Get the lower and upper \f$\Delta E\f$ cut from the last fit
+     */
+    std::pair<double, double> GetDeltaECuts() const;
+    /**
+     * Get the status of the last fit, which is -1 if no fit has been done
      */
-    TTree *m_Tree;
+    int GetFitStatus() const;
+  private:
     /**
      * Fit settings
      */
@@ -70,6 +82,40 @@ class DeltaEFit {
      * The upper \f$\Delta E\f$ cut
      */
     double m_DeltaE_High;
+    /**
+     * Status of the last fit
+     */
+    int m_FitStatus;
+    /**
+     * Column store of \f$\Delta E\f$ of the events inside the fit range
+     */
+    std::vector<float> m_DeltaEColumn;
+    /**
+     * Column store of the luminosity weights of the events inside the fit range
+     */
+    std::vector<float> m_WeightColumn;
+    /**
+     * The \f$\Delta E\f$ fit model
+     */
+    std::unique_ptr<DeltaEFitModel> m_FitModel;
+    /**
+     * The parameters of the fit model
+     */
+    std::unique_ptr<RooArgSet> m_Parameters;
+    /**
+     * Snapshot of the parameters of the fit model before any fit
+     */
+    std::unique_ptr<RooArgSet> m_InitialParameters;
+    /**
+     * Helper function that builds the fit model from the settings and takes a snapshot of its initial parameters
+     */
+    void BuildFitModel();
+    /**
+     * Helper function that calculates the \f$\Delta E\f$ cuts as \f$3\sigma\f$ around the mean of the fitted signal shape
+     * Modes in the list DeltaE_FourSigmaLowerCutModes have the lower cut at \f$4\sigma\f$, and the lower cut of any mode can be set with the setting <Mode>_DeltaE_LowerCutSigma
+     * @param Results The fit results
+     */
+    void CalculateDeltaECuts(RooFitResult *Results);
 };
 
 #endif
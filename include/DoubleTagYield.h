@@ -6,9 +6,14 @@
 #ifndef DOUBLETAGYIELD
 #define DOUBLETAGYIELD
 
+#include<string>
+#include<memory>
 #include"TTree.h"
+#include"TH2D.h"
 #include"RooRealVar.h"
 #include"RooFitResult.h"
+#include"RooAbsData.h"
+#include"RooDataHist.h"
 #include"BinnedDataLoader.h"
 #include"BinnedFitModel.h"
 #include"Settings.h"
@@ -27,13 +32,22 @@ class DoubleTagYield {
      */
     void DoFit();
     /**
-     * Plot projections of each bin in the fit
+     * Plot projections of each bin in the fit, with the categories shared between worker processes
+     * Plotting is skipped if the setting PlotProjections is false
      */
     void PlotProjections(BinnedDataLoader *DataLoader, BinnedFitModel *FitModel);
     /**
      * Save signal yields from fit
      */
     void SaveSignalYields(const BinnedFitModel &FitModel, RooFitResult *Result, const Category &category) const;
+    /**
+     * Compare the fitted signal yields with a cut-and-count sideband subtraction in the 2D beam constrained mass plane
+     * Only runs if the setting CutAndCountCrossCheck is true and the tag is fully reconstructed
+     * The fitted yields are scaled by the fraction of the signal shape inside the signal region before they are compared
+     * @param FitModel The fitted model
+     * @param category The category object of the fit
+     */
+    void CrossCheckYields(const BinnedFitModel &FitModel, const Category &category) const;
   private:
     /**
      * The fit variable
@@ -47,11 +61,30 @@ class DoubleTagYield {
      * TTree with double tag events
      */
     TTree *m_Tree;
+    /**
+     * Helper function that counts the sideband events of all signal and tag bins in a single pass over the tree
+     * The bin branches SignalBin_variable and TagBin_variable are only read if the signal or tag side is binned
+     * Only use for fully reconstructed tags
+     * @param category The category object of the fit, which determines the range of bin numbers
+     */
+    std::unique_ptr<TH2D> GetSidebandCounts(const Category &category) const;
     /**
      * Helper function to find sideband yield with correctly reconstructed signal side and incorrect tag side reconstruction
      * Only use for fully reconstructed tags
+     * @param SignalBin Signal bin number, or zero to include all signal bins
+     * @param TagBin Tag bin number, or zero to include all tag bins
+     * @param SidebandCounts Sideband counts from GetSidebandCounts()
+     */
+    double GetSidebandYield(int SignalBin, int TagBin, const TH2D &SidebandCounts) const;
+    /**
+     * Helper function that plots the fit projection of a single category
+     * @param category The category object of the fit
+     * @param Category Name of the category to plot
+     * @param CategoryData The events in this category
+     * @param CategoryCounts Binned number of events in each category, used to normalise the projection
+     * @param FitModel The fitted model
      */
-    double GetSidebandYield(int SignalBin, int TagBin) const;
+    void PlotCategory(Category *category, const std::string &Category, RooAbsData &CategoryData, const RooDataHist &CategoryCounts, BinnedFitModel *FitModel);
     /**
      * Function that performs the sPlot background subtraction
      * @param Data DataSet
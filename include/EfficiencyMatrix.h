@@ -0,0 +1,55 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * EfficiencyMatrix is a class that loads the binned efficiency matrix of a tag mode and its uncertainties from a ROOT file
+ * The file is read only once and the inverse of the nominal matrix is cached
+ * For systematics studies the matrix can be smeared, in which case only the smeared matrix is decomposed and inverted
+ */
+
+#ifndef EFFICIENCYMATRIX
+#define EFFICIENCYMATRIX
+
+#include<string>
+#include"TMatrixT.h"
+
+class EfficiencyMatrix {
+  public:
+    /**
+     * Constructor that reads the efficiency matrix and its uncertainties from file and decomposes the nominal matrix
+     * @param Filename ROOT file with the matrices EffMatrix and EffMatrix_err
+     */
+    EfficiencyMatrix(const std::string &Filename);
+    /**
+     * Get the inverse of the nominal efficiency matrix
+     */
+    const TMatrixT<double>& GetInverse() const;
+    /**
+     * Smear each element of the efficiency matrix by its uncertainty and return the inverse of the smeared matrix
+     */
+    TMatrixT<double> GetSmearedInverse();
+    /**
+     * Get the number of bins
+     */
+    int GetNumberBins() const;
+  private:
+    /**
+     * The nominal efficiency matrix
+     */
+    TMatrixT<double> m_EffMatrix;
+    /**
+     * The uncertainties of each element in the efficiency matrix
+     */
+    TMatrixT<double> m_EffMatrix_err;
+    /**
+     * The inverse of the nominal efficiency matrix
+     */
+    TMatrixT<double> m_EffMatrixInverse;
+    /**
+     * Helper function that reads a matrix from a ROOT file
+     * @param Filename ROOT file with the matrix
+     * @param MatrixName Name of the matrix object
+     * @param Required If false, an empty matrix is returned if the object doesn't exist
+     */
+    static TMatrixT<double> LoadMatrix(const std::string &Filename, const std::string &MatrixName, bool Required = true);
+};
+
+#endif
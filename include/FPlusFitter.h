@@ -9,6 +9,7 @@
 #include<vector>
 #include<string>
 #include<map>
+#include<utility>
 #include"RooDataSet.h"
 #include"RooArgSet.h"
 #include"RooArgList.h"
@@ -21,6 +22,7 @@
 #include"Settings.h"
 #include"cisiK0pipi.h"
 #include"CholeskySmearing.h"
+#include"EfficiencyMatrix.h"
 
 class FPlusFitter {
   public:
@@ -130,6 +132,19 @@ class FPlusFitter {
      * Perform many fits to toys
      */
     void DoManyToysOrFits(RooMultiVarGaussian *Model, const std::string RunMode);
+    /**
+     * Scan the profile likelihood on a grid of one or two parameters, with the grid split between several worker processes
+     * The scan parameters are given in ScanParameters, and the grid is set by <Name>_ScanLow, <Name>_ScanHigh and <Name>_ScanPoints
+     */
+    void DoScan(RooMultiVarGaussian *Model);
+    /**
+     * Minimize the NLL with all non-constant parameters floating
+     * The fit is not recorded in the instrumentation summary, because it may run in a worker process, so the caller records it
+     * @param NLL The negative log-likelihood
+     * @param Parameters All parameters of the NLL
+     * @return The fit status and covariance matrix quality
+     */
+    std::pair<int, int> MinimizeNLL(RooAbsReal *NLL, const RooArgSet *Parameters) const;
     /**
      * Vector of Gaussian constraint PDFs
      */
@@ -147,6 +162,10 @@ class FPlusFitter {
      * Useful for systematics studies because each reset uses a new seed
      */
     void ResetMeasurements();
+    /**
+     * Evaluate the predicted normalized yields at the current parameter values
+     */
+    std::vector<double> GetPredictedYields() const;
     /**
      * List of tag modes included in fit
      */
@@ -160,12 +179,17 @@ class FPlusFitter {
      */
     double GetEfficiency(std::string TagMode, const std::string &TagType, bool Smearing) const;
     /**
-     * Function for getting the efficiency matrix
+     * Function for getting the inverse of the efficiency matrix
+     * The efficiency matrix of each tag mode is only loaded and inverted once
      * For systematics studies the efficiencies are smeared
      * @param TagMode Tag mode
      * @param Smearing Set to true to smear parameters for systmatics studies
      */
-    TMatrixT<double>* GetEfficiencyMatrix(const std::string &TagMode, bool Smearing) const;
+    TMatrixT<double> GetEfficiencyMatrix(const std::string &TagMode, bool Smearing);
+    /**
+     * Map of efficiency matrices, which are loaded the first time they are needed
+     */
+    std::map<std::string, EfficiencyMatrix> m_EfficiencyMatrices;
     /**
      * Function for getting the tag yield
      * For systematics studies the yields are smeared by the peaking background systematics
@@ -0,0 +1,53 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * GlobalDoubleTagYield is a class that performs a simultaneous fit of the double tag yields of several tag modes
+ * The categories of each tag mode are combined into one RooSimultaneous, where selected signal shape and combinatorial parameters are shared between the tag modes
+ * The settings must contain a list of Modes, and the double tag fit settings of each tag mode as subsettings labelled by the tag mode
+ */
+
+#ifndef GLOBALDOUBLETAGYIELD
+#define GLOBALDOUBLETAGYIELD
+
+#include<string>
+#include<vector>
+#include<map>
+#include"RooRealVar.h"
+#include"RooFitResult.h"
+#include"Settings.h"
+
+class GlobalDoubleTagYield {
+  public:
+    /**
+     * Constructor that takes in the settings of the global fit
+     * @param settings The global fit settings
+     */
+    GlobalDoubleTagYield(const Settings &settings);
+    /**
+     * Load the double tag samples of all tag modes and perform the simultaneous fit
+     */
+    void DoFit();
+  private:
+    /**
+     * The global fit settings
+     */
+    Settings m_Settings;
+    /**
+     * List of tag modes in the fit
+     */
+    std::vector<std::string> m_Modes;
+    /**
+     * The fit variable, which must be the same for all tag modes
+     */
+    RooRealVar m_SignalMBC;
+    /**
+     * Map of parameters that are shared between the tag modes
+     */
+    std::map<std::string, RooRealVar*> m_SharedParameters;
+    /**
+     * Save the fitted shared parameters
+     * @param Result The fit result
+     */
+    void SaveSharedParameters(RooFitResult *Result) const;
+};
+
+#endif
@@ -0,0 +1,78 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * DCS_Correction is a class that calculates the DCS corrections of a flavour tag in all bins at once
+ * In bin \f$i\f$ the correction is \f$K_i^2/(K_i^2 + r_D^2K_{-i}^2 - 2r_DRK_iK_{-i}(c_i\cos\delta_D - s_i\sin\delta_D))\f$
+ * The bins are ordered from \f$-N\f$ to \f$N\f$, skipping zero
+ * The uncertainties of \f$r_D\f$, \f$R\f$ and \f$\delta_D\f$ are shared by all bins, so the corrections are correlated
+ * The covariance matrix is obtained either by linear propagation with the analytic Jacobian, or by sampling the DCS parameters
+ */
+
+#ifndef DCS_CORRECTION
+#define DCS_CORRECTION
+
+#include<vector>
+#include"TMatrixT.h"
+#include"HadronicParameters/Ki.h"
+#include"HadronicParameters/cisi.h"
+#include"HadronicParameters/DCS_Parameters.h"
+
+class DCS_Correction {
+  public:
+    /**
+     * Constructor that stores the hadronic parameters of all bins
+     * @param Ki_m The \f$K_i\f$ of the signal mode
+     * @param cisi_m The \f$c_i\f$ and \f$s_i\f$ of the signal mode
+     * @param DCS The DCS parameters of the flavour tag
+     * @param NumberBins Number of bins \f$N\f$
+     */
+    DCS_Correction(const Ki &Ki_m, const cisi &cisi_m, const DCS_Parameters &DCS, int NumberBins);
+    /**
+     * Get the DCS corrections at the central values of the DCS parameters
+     */
+    std::vector<double> GetCorrections() const;
+    /**
+     * Get the covariance matrix of the corrections from linear propagation
+     */
+    TMatrixT<double> GetLinearCovariance() const;
+    /**
+     * Get the covariance matrix of the corrections by sampling the DCS parameters from their multidimensional Gaussian
+     * @param Samples Number of samples
+     * @param Seed Seed of the random number generators
+     * @param NumberThreads Number of threads the samples are split over
+     */
+    TMatrixT<double> GetMonteCarloCovariance(int Samples, unsigned int Seed, int NumberThreads) const;
+    /**
+     * Calculate the corrections in all bins
+     * @param Parameters The DCS parameters \f$r_D\f$, \f$R\f$, \f$\delta_D\f$ (in degrees)
+     * @param Corrections Output vector of corrections
+     * @param Jacobian If not a null pointer, the derivatives of the corrections with respect to the DCS parameters are stored here, in a row-major format
+     */
+    void Evaluate(const double *Parameters, std::vector<double> &Corrections, std::vector<double> *Jacobian = nullptr) const;
+  private:
+    /**
+     * \f$K_i\f$ in each bin
+     */
+    std::vector<double> m_K;
+    /**
+     * \f$K_{-i}\f$ in each bin
+     */
+    std::vector<double> m_Kbar;
+    /**
+     * \f$c_i\f$ in each bin
+     */
+    std::vector<double> m_c;
+    /**
+     * \f$s_i\f$ in each bin
+     */
+    std::vector<double> m_s;
+    /**
+     * Mean value of the DCS parameters
+     */
+    std::vector<double> m_Mean;
+    /**
+     * Covariance matrix of the DCS parameters, in a row-major format
+     */
+    std::vector<double> m_Covariance;
+};
+
+#endif
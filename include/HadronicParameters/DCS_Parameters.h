@@ -22,6 +22,14 @@ class DCS_Parameters {
      * Get the DCS parameters, in the order \f$r_D\f$, \f$R\f$, \f$\delta_D\f$
      */
     std::vector<uncertainties::udouble> GetDCSParameters() const;
+    /**
+     * Get the mean value of the DCS parameters, in the order \f$r_D\f$, \f$R\f$, \f$\delta_D\f$
+     */
+    const std::vector<double>& GetMean() const;
+    /**
+     * Get the covariance matrix of the DCS parameters, in a row-major format
+     */
+    const std::vector<double>& GetCovariance() const;
   private:
     /**
      * The mean value of the DCS parameters
@@ -0,0 +1,140 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * Instrumentation is a namespace with lightweight timers and counters for finding out where the applications spend their time
+ * It is switched on with the setting InstrumentationOutput, or the environment variable KKPIPI_INSTRUMENTATION, which is the filename of the JSON summary
+ * The summary is written when the application exits, and contains the wall and CPU time of each stage, the number of events processed per second, counters, fit statuses, bytes read from ROOT files and the peak memory usage
+ * When it is switched off, a timer or counter only checks a single flag
+ */
+
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION
+
+#include<string>
+#include<chrono>
+#include<ctime>
+
+namespace Instrumentation {
+  namespace Detail {
+    /**
+     * Flag that is true when instrumentation is switched on
+     */
+    extern bool g_Enabled;
+    /**
+     * Add the time spent in a stage
+     */
+    void AddStage(const char *Stage, double WallTime, double CPUTime, long long Events);
+    /**
+     * Add to a counter
+     */
+    void AddCount(const char *Name, long long Count);
+    /**
+     * Add the outcome of a fit
+     */
+    void AddFit(const char *Name, int Status, int CovQual);
+    /**
+     * Get the CPU time of the process in seconds
+     */
+    double GetCPUTime();
+  }
+  /**
+   * Switch on instrumentation, and write the JSON summary to a file when the application exits
+   * @param Filename Filename of the JSON summary
+   * @param Application Name of the application, which is written to the summary
+   */
+  void Enable(const std::string &Filename, const std::string &Application);
+  /**
+   * Check if instrumentation is switched on
+   */
+  inline bool IsEnabled() {
+    return Detail::g_Enabled;
+  }
+  /**
+   * Add to a counter, for example the number of events read
+   * @param Name Name of the counter
+   * @param Count The number to add
+   */
+  inline void AddCount(const char *Name, long long Count = 1) {
+    if(Detail::g_Enabled) {
+      Detail::AddCount(Name, Count);
+    }
+  }
+  /**
+   * Record the outcome of a fit, so that the summary contains a histogram of fit and covariance matrix statuses
+   * @param Name Name of the fit
+   * @param Status Fit status
+   * @param CovQual Quality of the covariance matrix
+   */
+  inline void RecordFit(const char *Name, int Status, int CovQual) {
+    if(Detail::g_Enabled) {
+      Detail::AddFit(Name, Status, CovQual);
+    }
+  }
+  /**
+   * Write the JSON summary now, which is normally done automatically at exit
+   */
+  void WriteSummary();
+  /**
+   * ScopedTimer measures the wall and CPU time from construction to destruction, and adds it to a stage
+   * Stages with the same name are added together, and nested stages are counted separately
+   */
+  class ScopedTimer {
+    public:
+      /**
+       * Start the timer
+       * @param Stage Name of the stage, which must be a string that lives until the timer stops, such as a string literal
+       */
+      explicit ScopedTimer(const char *Stage): m_Stage(Stage), m_Enabled(Detail::g_Enabled) {
+	if(m_Enabled) {
+	  m_WallStart = std::chrono::steady_clock::now();
+	  m_CPUStart = Detail::GetCPUTime();
+	}
+      }
+      /**
+       * Stop the timer and add the time to the stage
+       */
+      ~ScopedTimer() {
+	Stop();
+      }
+      ScopedTimer(const ScopedTimer&) = delete;
+      ScopedTimer& operator=(const ScopedTimer&) = delete;
+      /**
+       * Add to the number of events processed in this stage, which is used to calculate the number of events per second
+       */
+      void AddEvents(long long Events = 1) {
+	m_Events += Events;
+      }
+      /**
+       * Stop the timer before it goes out of scope
+       */
+      void Stop() {
+	if(m_Enabled) {
+	  double WallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_WallStart).count();
+	  Detail::AddStage(m_Stage, WallTime, Detail::GetCPUTime() - m_CPUStart, m_Events);
+	  m_Enabled = false;
+	}
+      }
+    private:
+      /**
+       * Name of the stage
+       */
+      const char *m_Stage;
+      /**
+       * Flag that is true if instrumentation was switched on when the timer started
+       */
+      bool m_Enabled;
+      /**
+       * Number of events processed
+       */
+      long long m_Events = 0;
+      /**
+       * Wall time when the timer started
+       */
+      std::chrono::steady_clock::time_point m_WallStart;
+      /**
+       * CPU time when the timer started
+       */
+      double m_CPUStart = 0.0;
+  };
+}
+
+#endif
@@ -0,0 +1,15 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * LinkDef for the dictionary of the compiled RooFit PDFs, so that they can be streamed and imported into a RooWorkspace
+ */
+
+#ifdef __CLING__
+
+#pragma link off all globals;
+#pragma link off all classes;
+#pragma link off all functions;
+
+#pragma link C++ class CholeskyGaussianConstraint+;
+#pragma link C++ class DoublePolynomialPdf+;
+
+#endif
@@ -1,48 +1,50 @@
 // Martin Duy Tat 28th April 2021
 /**
- * DoubleTagYield is a class for determining the double tagged yield using sideband subtraction
+ * OldDoubleTagYield is a class for determining the double tagged yield using sideband subtraction in the 2D beam constrained mass plane
+ * It takes in the same binned double tag events as DoubleTagYield and is used as a fast cut-and-count cross-check of the fitted yields
+ * Only use for fully reconstructed tags
  */
 
-#ifndef DOUBLETAGYIELD
-#define DOUBLETAGYIELD
+#ifndef OLDDOUBLETAGYIELD
+#define OLDDOUBLETAGYIELD
 
+#include<string>
 #include<vector>
+#include<array>
+#include<utility>
 #include"TTree.h"
-#include"TCut.h"
-#include"AmplitudePhaseSpace.h"
+#include"Category.h"
+#include"Settings.h"
 
-class DoubleTagYield {
+class OldDoubleTagYield {
   public:
     /**
-     * Constructor that sets up the binning scheme and takes in the TTree with double tagged events
-     * @param NBins Number of bins in binning scheme
-     * @param Cuts Cuts to apply before counting events
+     * Constructor that sets up the categories and takes in the TTree with binned double tagged events
+     * @param settings The fit settings, with the same format as for DoubleTagYield
+     * @param Tree TTree with binned double tagged events
      */
-    DoubleTagYield(int NBins, TCut Cuts = TCut());
+    OldDoubleTagYield(const Settings &settings, TTree *Tree);
     /**
      * Helper function that determines which region of the beam constrained mass space the event belongs to
      * @param SigmalMBC Beam constrained mass of signal side (\f$KK\pi\pi\f$)
      * @param TagMBC Beam constrained mass of tag side (\f$KK\f$, \f$\pi\pi\f$, \f$K\pi\f$, etc)
      */
-    char DetermineMBCRegion(double SignalMBC, double TagMBC) const;
+    static char DetermineMBCRegion(double SignalMBC, double TagMBC);
     /**
-     * Helper function that sets the correct branch addresses for momenta of daughter particles
+     * Function that reads the double tagged events and determines the raw number of events in each category and region in beam constrained mass plane
+     * Only the bin numbers and beam constrained masses are read, and events are counted in a single pass while they are read
+     * The count is serial because it is limited by reading the tree, and the status of the branches of the tree is restored afterwards
      */
-    void SetDaughterBranchAddresses(TTree *Tree, std::vector<double> &Momenta, std::vector<double> &MomentaKalmanFit) const;
+    void CalculateBinnedRawYields();
     /**
-     * Function that takes in a sample of double tagged events and determines the raw number of events in each bin and region in beam constrained mass plane
-     * @param Tree TTree with double tagged events
+     * Function that calculates the sideband background subtracted yield and its statistical uncertainty in one category
+     * @param category Unique category string
      */
-    void CalculateBinnedRawYields(TTree *Tree);
+    std::pair<double, double> GetBinYield(const std::string &category) const;
     /**
-     * Function that calculates the sideband background subtracted yield in bin \f$i\f$
-     * @param i Bin number
+     * Function that calculates the total sideband background subtracted yield and its statistical uncertainty
      */
-    double GetBinYield(int i) const;
-    /**
-     * Function that calculates the total sideband background subtracted yield
-     */
-    double GetTotalYield() const;
+    std::pair<double, double> GetTotalYield() const;
     /**
      * Get the number of events outside phase space
      */
@@ -51,35 +53,37 @@ class DoubleTagYield {
      * Get the number of events outside the regions in beam constrained mass space considered
      */
     int GetEventsOutsideMBCSpace() const;
-  private:
-    /**
-     * Number of bins in binning scheme
-     */
-    int m_NBins;
     /**
-     * Phase space parameterisation used to determine which bin events belong to
+     * Save the yields of all categories to a file, using the same names as the fitted yields
+     * @param Filename Name of output file
      */
-    AmplitudePhaseSpace m_AmplitudePhaseSpace;
+    void SaveYields(const std::string &Filename) const;
+  private:
     /**
-     * Raw bin yield in the S region, the signal region
+     * Raw yields in the five regions S, A, B, C and D of the beam constrained mass plane
+     * S: Signal region
+     * A: Real signal event
+     * B: Real tag event
+     * C: Continuum background
+     * D: Combinatorial background
      */
-    std::vector<int> m_BinYieldS;
+    using RegionYields = std::array<int, 5>;
     /**
-     * Raw bin yield in the A region, real signal event
+     * The fit settings
      */
-    std::vector<int> m_BinYieldA;
+    Settings m_Settings;
     /**
-     * Raw bin yield in the B region, real tag event
+     * TTree with binned double tag events
      */
-    std::vector<int> m_BinYieldB;
+    TTree *m_Tree;
     /**
-     * Raw bin yield in the C region, continuum background
+     * Categories of the binned double tags
      */
-    std::vector<int> m_BinYieldC;
+    Category m_Category;
     /**
-     * Raw bin yield in the D region, combinatorial background
+     * Raw yields of each category, in the same order as Category::GetCategories()
      */
-    std::vector<int> m_BinYieldD;
+    std::vector<RegionYields> m_BinYields;
     /**
      * Number of events outside the phase space allowed region
      */
@@ -89,14 +93,10 @@ class DoubleTagYield {
      */
     int m_EventsOutsideMBCSpace;
     /**
-     * Cuts to apply before counting events
-     */
-    TCut m_Cuts;
-    /**
-     * Helper function that calculates the correct bin index
-     * Bin numbers are both positive and negative, this function will simply wrap the indexing into a normal array
+     * Helper function that calculates the sideband subtracted yield and its statistical uncertainty from the raw yields
+     * @param Yields Raw yields in each region
      */
-    int BinIndex(int i) const;
+    static std::pair<double, double> SubtractSidebands(const RegionYields &Yields);
 };
 
 #endif
@@ -0,0 +1,69 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * OutputWriter is a namespace that opens the output ROOT files of all applications with a common compression and basket policy
+ * Intermediate files, such as the trees from PrepareTagTree, BinDoubleTags, TopoAna and the sPlot weights, are written once and read many times, so they use LZ4, which decompresses fast
+ * Archival files, such as covariance matrices, histograms and fit results, use ZSTD, which compresses better
+ * The compression settings can be changed with the settings IntermediateCompression and ArchivalCompression, in the ROOT convention 100*algorithm + level
+ * Applications that write large trees can switch on ROOT's implicit multithreading, which compresses the baskets of different branches in parallel
+ */
+
+#ifndef OUTPUTWRITER
+#define OUTPUTWRITER
+
+#include<string>
+#include<vector>
+#include<memory>
+#include"TFile.h"
+#include"TTree.h"
+#include"Settings.h"
+
+namespace OutputWriter {
+  /**
+   * The stage of the analysis an output file belongs to
+   */
+  enum class Stage {Intermediate, Archival};
+  /**
+   * Read the optional compression, basket size and thread settings, which is done by Utilities::parse_args
+   * @param settings The settings, where IntermediateCompression, ArchivalCompression, HotBasketSize and OutputThreads are read if they exist
+   */
+  void Configure(const Settings &settings);
+  /**
+   * Get the ROOT compression settings of a stage
+   * @param stage Intermediate or archival
+   */
+  int GetCompressionSettings(Stage stage);
+  /**
+   * Open a new output file with the compression of its stage, which becomes the current directory
+   * @param Filename Filename of the ROOT file, which is overwritten if it exists
+   * @param stage Intermediate or archival
+   */
+  std::unique_ptr<TFile> OpenFile(const std::string &Filename, Stage stage);
+  /**
+   * Get the branches that are read most often in the later stages of the analysis
+   */
+  const std::vector<std::string>& GetHotBranches();
+  /**
+   * Prepare a tree for writing, which must be called before it is filled
+   * The branches are given the compression of the file the tree is in, which is needed for clones because they keep the compression of the input tree
+   * The hot branches start with large baskets, and ROOT resizes all baskets to fit the first cluster when it is flushed
+   * Fill the tree with FillTree so that the hot branches keep their large baskets after this resizing
+   * @param Tree The output tree, which must already be in its output file
+   * @param HotBranches Branches that are read most often, and branches that are not in the tree are ignored
+   */
+  void ConfigureTree(TTree *Tree, const std::vector<std::string> &HotBranches = GetHotBranches());
+  /**
+   * Fill an entry of a tree prepared with ConfigureTree
+   * When the first cluster is flushed, the hot branches are given back baskets of at least HotBasketSize
+   * @param Tree The output tree
+   * @param HotBranches The same hot branches as given to ConfigureTree
+   * @return The number of bytes filled, as returned by TTree::Fill
+   */
+  int FillTree(TTree *Tree, const std::vector<std::string> &HotBranches = GetHotBranches());
+  /**
+   * Switch on ROOT's implicit multithreading so that baskets are compressed in parallel when a tree is flushed
+   * This must not be used in applications that fork worker processes after it is called
+   */
+  void EnableParallelCompression();
+}
+
+#endif
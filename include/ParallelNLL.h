@@ -0,0 +1,212 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * ParallelNLL is an extended negative log-likelihood for a RooSimultaneous fit, where the evaluation is split between several processes
+ * The likelihood is partitioned into work items, where each item is a chunk of events in one category, and the items are sorted with the largest first
+ * Each time the likelihood is evaluated, the parameters are sent to all worker processes, and each process keeps taking the next unprocessed item from a shared counter until all items are done
+ * This way categories with many events are split up and processes that finish early help out with the remaining items, so that very unbalanced categories still keep all cores busy
+ * Processes are used instead of threads because RooFit objects are not thread safe
+ * The partial sums are added up in a fixed order, so the result doesn't depend on the scheduling
+ */
+
+#ifndef PARALLELNLL
+#define PARALLELNLL
+
+#include<vector>
+#include<string>
+#include<atomic>
+#include<sys/types.h>
+#include"RooAbsReal.h"
+#include"RooAbsPdf.h"
+#include"RooRealVar.h"
+#include"RooListProxy.h"
+#include"RooArgSet.h"
+#include"RooSimultaneous.h"
+#include"RooDataSet.h"
+#include"RooFitResult.h"
+
+class ParallelNLL: public RooAbsReal {
+  public:
+    /**
+     * Constructor that splits the dataset by category into work items and starts the worker processes
+     * @param Name Name of the likelihood
+     * @param Model The simultaneous PDF, where all components must be extended
+     * @param Data The dataset, which must contain the category of the simultaneous PDF
+     * @param NumberCPUs Total number of processes used in the evaluation, including the main process
+     * @param ChunkSize Maximum number of events in each work item, set to 0 to determine this from the number of events and processes
+     */
+    ParallelNLL(const char *Name, RooSimultaneous &Model, RooDataSet &Data, int NumberCPUs, int ChunkSize = 0);
+    /**
+     * Copy constructor, which starts a new set of worker processes
+     */
+    ParallelNLL(const ParallelNLL &Other, const char *Name = nullptr);
+    /**
+     * Destructor that stops all worker processes
+     */
+    virtual ~ParallelNLL();
+    /**
+     * Clone function required by RooFit
+     */
+    virtual TObject* clone(const char *NewName) const;
+    /**
+     * Error level of a negative log-likelihood
+     */
+    virtual Double_t defaultErrorLevel() const;
+    /**
+     * Minimise the likelihood with MIGRAD and strategy 2, followed by HESSE, equivalent to fitTo with Save() and Strategy(2)
+     * @param RunMinos Set to true to run MINOS on all floating parameters after HESSE
+     * @param MinimizerType Type of minimizer, either "Minuit" or "Minuit2"
+     * @return The fit result, owned by the caller
+     */
+    RooFitResult* Fit(bool RunMinos, const std::string &MinimizerType = "Minuit2");
+    /**
+     * Get the number of processes used in the evaluation
+     */
+    int GetNumberCPUs() const;
+    /**
+     * Get the number of work items
+     */
+    int GetNumberWorkItems() const;
+    /**
+     * Helper function that returns the number of processes to use in a fit
+     * This is given by the NumberCPUs setting, otherwise it is the number of cores
+     * @param RequestedCPUs Number of processes requested, anything less than 1 means use all cores
+     */
+    static int GetAvailableCPUs(int RequestedCPUs = 0);
+  protected:
+    /**
+     * Evaluate the negative log-likelihood with all processes
+     */
+    virtual Double_t evaluate() const;
+  private:
+    /**
+     * Struct describing one piece of the likelihood
+     */
+    struct WorkItem {
+      /**
+       * Index of the category
+       */
+      int Component;
+      /**
+       * Index of the first event
+       */
+      int First;
+      /**
+       * Index after the last event
+       */
+      int Last;
+      /**
+       * Flag that is true if this item includes the extended term of the category
+       */
+      bool Extended;
+    };
+    /**
+     * Struct that is shared between all processes
+     */
+    struct SharedState {
+      /**
+       * Index of the next work item that hasn't been taken
+       */
+      std::atomic<int> NextItem;
+    };
+    /**
+     * Simultaneous PDF
+     */
+    RooSimultaneous *m_Model;
+    /**
+     * The dataset
+     */
+    RooDataSet *m_Data;
+    /**
+     * Proxy of all parameters, so that the likelihood is evaluated again when a parameter changes
+     */
+    RooListProxy m_ParameterProxy;
+    /**
+     * All real parameters, in the order they are sent to the workers
+     */
+    std::vector<RooRealVar*> m_Parameters;
+    /**
+     * The real observables of the PDF
+     */
+    std::vector<RooRealVar*> m_Observables;
+    /**
+     * Normalisation set of the PDFs
+     */
+    RooArgSet m_NormSet;
+    /**
+     * PDF of each category
+     */
+    std::vector<RooAbsPdf*> m_ComponentPDFs;
+    /**
+     * Observable values of each event in each category, with all observables of one event stored together
+     */
+    std::vector<std::vector<double>> m_ComponentValues;
+    /**
+     * Event weights in each category
+     */
+    std::vector<std::vector<double>> m_ComponentWeights;
+    /**
+     * Sum of event weights in each category
+     */
+    std::vector<double> m_ComponentSumWeights;
+    /**
+     * The work items, sorted by size
+     */
+    std::vector<WorkItem> m_Items;
+    /**
+     * Total number of processes, including the main process
+     */
+    int m_NumberCPUs;
+    /**
+     * Maximum number of events in each work item
+     */
+    int m_ChunkSize;
+    /**
+     * Shared counter of work items
+     */
+    SharedState *m_Shared = nullptr;
+    /**
+     * Shared array with the result of each work item
+     */
+    double *m_Results = nullptr;
+    /**
+     * Shared array with the number of evaluation errors in each work item
+     */
+    int *m_Errors = nullptr;
+    /**
+     * Pipes for sending commands to each worker
+     */
+    std::vector<int> m_CommandPipes;
+    /**
+     * Pipe the workers use to signal that they are done
+     */
+    int m_DonePipe[2] = {-1, -1};
+    /**
+     * Process IDs of the workers
+     */
+    std::vector<pid_t> m_Workers;
+    /**
+     * Split the dataset, set up the work items and start the workers
+     */
+    void Initialize();
+    /**
+     * Stop all workers and release shared memory
+     */
+    void Terminate();
+    /**
+     * Keep processing work items until there are none left
+     */
+    void ProcessItems() const;
+    /**
+     * Evaluate a single work item
+     * @param Item The work item
+     * @param Errors Number of events with a non-positive PDF value (return by reference)
+     */
+    double EvaluateItem(const WorkItem &Item, int &Errors) const;
+    /**
+     * Main loop of the worker processes, which never returns
+     * @param CommandPipe Pipe with commands from the main process
+     */
+    void RunWorker(int CommandPipe);
+};
+
+#endif
@@ -1,15 +1,27 @@
 // Martin Duy Tat 29th November 2021
 /**
  * GeneratorKinematics is a simple struct containing all variables describing the generator kinematics
+ * When connected to a TTree, the truth branches are disabled and only read when an event is loaded with LoadEntry()
  */
 
 #ifndef GENERATORKINEMATICS
 #define GENERATORKINEMATICS
 
 #include<vector>
+#include"TTree.h"
 
 struct GeneratorKinematics {
-  GeneratorKinematics(int Particles = 100): ParticleIDs(Particles), MotherIndex(Particles), TruePx(Particles), TruePy(Particles), TruePz(Particles), TrueEnergy(Particles), SignalD_index(0), TagD_index(0) {}
+  GeneratorKinematics(int Particles = 100): ParticleIDs(Particles), MotherIndex(Particles), TruePx(Particles), TruePy(Particles), TruePz(Particles), TrueEnergy(Particles), SignalD_index(0), TagD_index(0), m_Tree(nullptr), m_LoadedEntry(-1) {}
+  /**
+   * Connect the truth branches of a TTree and disable them, so that TTree::GetEntry doesn't read them
+   * @param Tree TTree with truth information
+   */
+  void SetBranchAddresses(TTree *Tree);
+  /**
+   * Read the truth branches of the entry currently loaded in the TTree, unless they have already been read
+   * If the event has more particles than the capacity of the arrays, they are enlarged before reading
+   */
+  void LoadEntry();
   /**
    * Number of particles generated in event
    */
@@ -46,6 +58,19 @@ struct GeneratorKinematics {
    * The index of the tag D in the ParticleIDs vector
    */
   std::vector<int>::size_type TagD_index;
+  private:
+    /**
+     * TTree with truth information
+     */
+    TTree *m_Tree;
+    /**
+     * The entry number of the truth information currently stored
+     */
+    Long64_t m_LoadedEntry;
+    /**
+     * Helper function that points the truth branches to the arrays
+     */
+    void SetArrayAddresses();
 };
 
 #endif
@@ -96,7 +96,7 @@ class KKpipi_PhaseSpace {
      */
     void SetBranchAddresses_Rec(TTree *Tree);
     /**
-     * Set the branch addresses of truth variables
+     * Set the branch addresses of truth variables, which are read lazily when the true bin is requested
      */
     void SetBranchAddresses_True(TTree *Tree);
 };
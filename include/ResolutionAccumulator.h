@@ -0,0 +1,107 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * ResolutionAccumulator collects the resolution of several components (for example the 16 momentum components of the D daughters) in a single pass
+ * For each component it keeps streaming moments and a fixed-width grid of counts that serves as a quantile sketch
+ * Accumulators filled with different events can be merged, so events can be processed in parallel over entry ranges
+ */
+
+#ifndef RESOLUTIONACCUMULATOR
+#define RESOLUTIONACCUMULATOR
+
+#include<vector>
+#include<string>
+#include"TH1D.h"
+
+class ResolutionAccumulator {
+  public:
+    /**
+     * Constructor that sets up empty moments and grids
+     * @param Components Number of components
+     * @param Range The quantile grid covers the resolution between -Range and +Range
+     * @param GridBins Number of bins in the quantile grid
+     */
+    ResolutionAccumulator(int Components, double Range = 0.1, int GridBins = 10000);
+    /**
+     * Add the resolution of one event
+     * @param Values The resolution of each component
+     */
+    void Fill(const std::vector<double> &Values);
+    /**
+     * Add the events of another accumulator with the same components and grid
+     * @param Other The other accumulator
+     */
+    void Merge(const ResolutionAccumulator &Other);
+    /**
+     * Pack the accumulator into a vector of numbers, so that it can be sent between processes
+     */
+    std::vector<double> Serialize() const;
+    /**
+     * Unpack an accumulator from a vector of numbers made by Serialize()
+     * @param Packed The packed accumulator
+     */
+    static ResolutionAccumulator Deserialize(const std::vector<double> &Packed);
+    /**
+     * Get the number of components
+     */
+    int GetNumberComponents() const;
+    /**
+     * Get the number of events
+     */
+    double GetEntries() const;
+    /**
+     * Get the mean of a component
+     * @param i Component index
+     */
+    double GetMean(int i) const;
+    /**
+     * Get the standard deviation of a component
+     * @param i Component index
+     */
+    double GetStdDev(int i) const;
+    /**
+     * Get a quantile of a component, interpolated from the grid
+     * @param i Component index
+     * @param q Quantile between 0 and 1
+     */
+    double GetQuantile(int i, double q) const;
+    /**
+     * Make a histogram of a component, with a range that covers the central 99.8% of events
+     * The statistics of the histogram are set to the moments of all events, so GetMean() and GetStdDev() of the histogram agree with the accumulator
+     * @param i Component index
+     * @param Name Name of histogram
+     * @param Bins Number of bins in histogram
+     */
+    TH1D MakeHistogram(int i, const std::string &Name, int Bins = 100) const;
+  private:
+    /**
+     * Streaming moments of one component
+     */
+    struct Moments {
+      double Mean = 0.0;
+      double M2 = 0.0;
+      double Min = 0.0;
+      double Max = 0.0;
+    };
+    /**
+     * Number of events
+     */
+    double m_Entries;
+    /**
+     * The quantile grid covers the resolution between -m_Range and +m_Range
+     */
+    double m_Range;
+    /**
+     * Number of bins in the quantile grid
+     */
+    int m_GridBins;
+    /**
+     * Moments of each component
+     */
+    std::vector<Moments> m_Moments;
+    /**
+     * Grid counts of all components, with an underflow and overflow bin at each end
+     */
+    std::vector<double> m_Grid;
+};
+
+#endif
@@ -0,0 +1,111 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * DoublePolynomialPdf is a compiled PDF of the piece-wise continuous polynomial used in DoublePolynomial_Shape
+ * For \f$x < 0\f$ it is \f$|1 + \sum_j a_jP_j(x)|\f$ and for \f$x \geq 0\f$ it is \f$N|1 + \sum_j f_ja_jP_j(x)|\f$
+ * The first four basis polynomials are \f$P_0 = x\f$ and the Chebychev polynomials \f$T_2\f$, \f$T_3\f$, \f$T_4\f$, while higher orders are \f$P_j = x^{j + 1}\f$
+ * The factor \f$N\f$ makes the two sides equal at zero
+ * The integral over \f$x\f$ is analytic, with the polynomials split at their roots, which are bracketed by the roots of their derivatives and refined by bisection
+ * The monomial expansion is cached and only recalculated when a coefficient changes
+ * The class has a dictionary, so that it can be streamed and imported into a RooWorkspace
+ */
+
+#ifndef DOUBLEPOLYNOMIALPDF
+#define DOUBLEPOLYNOMIALPDF
+
+#include<vector>
+#include"RooAbsPdf.h"
+#include"RooAbsReal.h"
+#include"RooRealProxy.h"
+#include"RooListProxy.h"
+#include"RooArgList.h"
+#include"RooArgSet.h"
+
+class DoublePolynomialPdf: public RooAbsPdf {
+  public:
+    /**
+     * Default constructor needed for streaming
+     */
+    DoublePolynomialPdf();
+    /**
+     * Constructor that takes in the observable and the polynomial coefficients
+     * @param Name Name of PDF
+     * @param Title Title of PDF
+     * @param x The observable
+     * @param LeftCoefficients The coefficients \f$a_j\f$ for \f$x < 0\f$
+     * @param RightFractions The coefficients for \f$x \geq 0\f$ as fractions \f$f_j\f$ of the coefficients on the left
+     */
+    DoublePolynomialPdf(const char *Name, const char *Title, RooAbsReal &x, const RooArgList &LeftCoefficients, const RooArgList &RightFractions);
+    /**
+     * Copy constructor
+     */
+    DoublePolynomialPdf(const DoublePolynomialPdf &Other, const char *Name = nullptr);
+    /**
+     * Clone function required by RooFit
+     */
+    virtual TObject* clone(const char *NewName) const;
+    /**
+     * Advertise the analytic integral over the observable
+     */
+    virtual Int_t getAnalyticalIntegral(RooArgSet &AllVars, RooArgSet &AnalVars, const char *RangeName = nullptr) const;
+    /**
+     * Calculate the analytic integral over the observable
+     */
+    virtual Double_t analyticalIntegral(Int_t Code, const char *RangeName = nullptr) const;
+  protected:
+    /**
+     * Evaluate the unnormalised PDF
+     */
+    virtual Double_t evaluate() const;
+  private:
+    /**
+     * The observable
+     */
+    RooRealProxy m_x;
+    /**
+     * The coefficients for \f$x < 0\f$
+     */
+    RooListProxy m_LeftCoefficients;
+    /**
+     * The coefficients for \f$x \geq 0\f$ as fractions of the coefficients on the left
+     */
+    RooListProxy m_RightFractions;
+    /**
+     * The coefficients and fractions used for the cached expansion, stored in pairs
+     */
+    mutable std::vector<double> m_CachedParameters; //!
+    /**
+     * Cached monomial coefficients for \f$x < 0\f$
+     */
+    mutable std::vector<double> m_LeftMonomials; //!
+    /**
+     * Cached monomial coefficients for \f$x \geq 0\f$, with the normalisation at zero included
+     */
+    mutable std::vector<double> m_RightMonomials; //!
+    /**
+     * Helper function that expands the left and right polynomials in powers of \f$x\f$ if any coefficient has changed since the last call
+     */
+    void UpdateCoefficients() const;
+    /**
+     * Helper function that evaluates a polynomial with Horner's method
+     * @param Coefficients Monomial coefficients, starting with the constant term
+     * @param x Point to evaluate at
+     */
+    static double EvaluatePolynomial(const std::vector<double> &Coefficients, double x);
+    /**
+     * Helper function that finds the roots of a polynomial inside an interval, in increasing order
+     * @param Coefficients Monomial coefficients, starting with the constant term
+     * @param Low Lower limit
+     * @param High Upper limit
+     */
+    static std::vector<double> FindRoots(std::vector<double> Coefficients, double Low, double High);
+    /**
+     * Helper function that integrates the absolute value of a polynomial over an interval
+     * @param Coefficients Monomial coefficients, starting with the constant term
+     * @param Low Lower limit
+     * @param High Upper limit
+     */
+    static double IntegrateAbsolutePolynomial(const std::vector<double> &Coefficients, double Low, double High);
+    ClassDef(DoublePolynomialPdf, 1)
+};
+
+#endif
@@ -12,13 +12,16 @@
 #include<vector>
 #include<utility>
 #include<map>
+#include<memory>
 #include"TTree.h"
+#include"TH1D.h"
 #include"RooRealVar.h"
 #include"RooGaussian.h"
 #include"RooExtendPdf.h"
 #include"RooFitResult.h"
 #include"RooAddPdf.h"
 #include"RooDataSet.h"
+#include"RooAbsData.h"
 #include"RooArgSet.h"
 #include"Settings.h"
 #include"RooShapes/FitShape.h"
@@ -88,6 +91,37 @@ class SingleTagYield {
      * Initial parameters before fit
      */
     RooArgSet *m_InitialParameters;
+    /**
+     * Invariant mass variable used to cut on, if InvariantMassVariable is given
+     */
+    std::unique_ptr<RooRealVar> m_InvMassVar;
+    /**
+     * Column store of \f$m_{\rm BC}\f$ of the events that pass all cuts, used to build the unbinned dataset
+     */
+    std::vector<float> m_MBCColumn;
+    /**
+     * Column store of the luminosity weights of the events that pass all cuts
+     */
+    std::vector<float> m_WeightColumn;
+    /**
+     * Column store of the invariant mass of the events that pass all cuts, empty if there is no invariant mass cut
+     */
+    std::vector<float> m_InvMassColumn;
+    /**
+     * Unbinned dataset, only built when it is needed
+     */
+    std::unique_ptr<RooDataSet> m_UnbinnedData;
+    /**
+     * Read the data in a single pass, filling the histograms and the column store
+     * @param FitHistogram Histogram used in the binned fit
+     * @param PlotHistogram Histogram with 200 bins used in the plot, filled with the same weights as the unbinned dataset
+     * @param KeepEvents Set to true to fill the column store for an unbinned dataset
+     */
+    void ReadData(TH1D &FitHistogram, TH1D &PlotHistogram, bool KeepEvents);
+    /**
+     * Get the unbinned dataset, which is built from the column store the first time this is called
+     */
+    RooDataSet* GetUnbinnedData();
     /**
      * Initialize the signal shape
      */
@@ -106,9 +140,9 @@ class SingleTagYield {
     void InitializeFitShape();
     /**
      * Plot the single tag MBC fit
-     * @param Data The data to be plotted
+     * @param Data The data to be plotted, binned or unbinned
      */
-    void PlotSingleTagYield(const RooDataSet &Data) const;
+    void PlotSingleTagYield(const RooAbsData &Data) const;
     /**
      * Function that saves the fit parameters to a text file
      */
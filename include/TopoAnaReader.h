@@ -6,12 +6,13 @@
  */
 
 #ifndef TOPOANAREADER
-#define TOTOANAREADER
+#define TOPOANAREADER
 
 #include<string>
 #include<vector>
 #include<tuple>
 #include<utility>
+#include<unordered_map>
 #include"TTree.h"
 
 class TopoAnaReader {
@@ -25,6 +26,7 @@ class TopoAnaReader {
     TopoAnaReader(const std::string &Filename);
     /**
      * Function that takes in the TopoAna txt output and sorts out the different components
+     * Each decay is matched to the first component in the list with a decay descriptor that appears in the decay
      * @param Filename Filename of txt file from TopoAna
      */
     void AnalyzeComponents(const std::string &Filename);
@@ -40,17 +42,9 @@ class TopoAnaReader {
      */
     void SaveComponentCuts( const std::string &Label, const std::vector<int> &DecayTopologies) const;
     /**
-     * Function that save the TTree for a component
+     * Function that saves a TTree for each component, in a single pass over the original TTree
+     * The filenames will be the label and a .root extension
      * @param InTree Original TTree
-     * @param TreeName Name of TTree
-     * @param Label Component label
-     * @param DecayTopologies Vector of decay topology numbers from TopoAna
-     */
-    void SaveTree(TTree *InTree, const std::string &Label, const std::vector<int> &DecayTopologies) const;
-    /**
-     * Function that saves a TTrees for each component
-     * @param InTree Original TTree
-     * @param TreeName Name of TTree
      */
     void SaveAllTrees(TTree *InTree) const;
   private:
@@ -62,6 +56,31 @@ class TopoAnaReader {
      * Tuple with label for all other components not included in the list, by default it's "Other", and the topology numbers from TopoAna
      */
     std::pair<std::string, std::vector<int>> m_OtherComponent;
+    /**
+     * Hash map from decay descriptor to the index of the first component with that descriptor
+     */
+    std::unordered_map<std::string, int> m_DescriptorLookup;
+    /**
+     * Length of the longest decay descriptor
+     */
+    std::string::size_type m_MaxDescriptorLength;
+    /**
+     * Dense lookup table from topology number to component index, where the index after the last component is "Other" and -1 means the topology was not in the TopoAna output
+     */
+    std::vector<int> m_TopologyComponent;
+    /**
+     * Helper function that finds the component of a decay from the TopoAna output
+     * Every substring followed by "  &" in the line, up to the length of the longest descriptor, is looked up in the hash map
+     * @param Decay A line with a \f$D^0\f$ or \f$\bar{D}^0\f$ decay from the TopoAna output
+     * @return The lowest matching component index, or the number of components if no component matches
+     */
+    int FindComponent(const std::string &Decay) const;
+    /**
+     * Helper function that records which component a topology number belongs to
+     * @param DecayTopology Topology number from TopoAna
+     * @param Component Component index
+     */
+    void SetTopologyComponent(int DecayTopology, int Component);
 };
 
 #endif
@@ -0,0 +1,71 @@
+// Martin Duy Tat 19th October 2026
+/**
+ * ToyGenerator is a class for generating many toy datasets from a multidimensional Gaussian in one go
+ * The toys are generated by multiplying a matrix of standard normal numbers with the Cholesky decomposition of the covariance matrix
+ * All toys are stored in a single contiguous buffer, and each toy is loaded into a reusable dataset when it's needed
+ */
+
+#ifndef TOYGENERATOR
+#define TOYGENERATOR
+
+#include<vector>
+#include"TMatrixT.h"
+#include"TMatrixTSym.h"
+#include"RooArgSet.h"
+#include"RooDataSet.h"
+
+class ToyGenerator {
+  public:
+    /**
+     * Constructor that Cholesky decomposes the covariance matrix
+     * @param CovMatrix Covariance matrix of the multidimensional Gaussian
+     * @param EventsPerToy Number of events (measurements) in each toy
+     */
+    ToyGenerator(const TMatrixTSym<double> &CovMatrix, int EventsPerToy);
+    /**
+     * Generate a batch of toys, which overwrites any previously generated toys
+     * Random numbers are drawn from RooRandom::randomGenerator() so that the seed is set the same way as for RooFit toys
+     * @param Mean The mean of the multidimensional Gaussian
+     * @param NumberToys Number of toys to generate
+     */
+    void Generate(const std::vector<double> &Mean, int NumberToys);
+    /**
+     * Get the number of toys that have been generated
+     */
+    int GetNumberToys() const;
+    /**
+     * Get a pointer to the start of a toy in the buffer, which contains EventsPerToy consecutive events of all the variables
+     * @param Toy Toy index
+     */
+    const double* GetToy(int Toy) const;
+    /**
+     * Clear a dataset and fill it with the events of a toy
+     * @param Toy Toy index
+     * @param Data The dataset to be filled, which must have been created with the same variables
+     * @param Variables The variables in the dataset, in the same order as the mean and covariance matrix
+     */
+    void FillDataSet(int Toy, RooDataSet &Data, RooArgSet &Variables) const;
+  private:
+    /**
+     * The transpose of the lower triangular Cholesky decomposition of the covariance matrix
+     */
+    const TMatrixT<double> m_CholeskyMatrixT;
+    /**
+     * Number of events in each toy
+     */
+    const int m_EventsPerToy;
+    /**
+     * Number of toys generated
+     */
+    int m_NumberToys;
+    /**
+     * Buffer with all the toys, each row is one event
+     */
+    TMatrixT<double> m_Toys;
+    /**
+     * Helper function for obtaining the upper triangular Cholesky decomposition of the covariance matrix
+     */
+    static TMatrixT<double> GetCholeskyDecomposition(const TMatrixTSym<double> &CovMatrix);
+};
+
+#endif
@@ -22,19 +22,23 @@ namespace Utilities {
   /**
    * LoadChain is a function that takes in a TChain pointer and loads the ROOT files with TTree objects
    * ROOT files should have a filename ending with a number, starting at 0, before .root
+   * The number of entries in each file is added to the TChain, so that it does not open every file to find the tree offsets
+   * These are cached in the index file Filename.index, and only files that are new or have a different modification time or size are opened, in parallel with TProcessExecutor
    * @param Chain TChain pointer where TTree objects are loaded
    * @param NumberFiles Number of files
    * @param Filename Filename of ROOT files, without the number and .root
    * @param TreeName Name of the TTree we want to load, if this is not given it is assumed the name of the TChain has already been set
+   * @param NumberCPUs Number of processes used to open files, anything less than 1 means use all cores, and files are opened serially if ROOT's implicit multithreading is switched on
    */
-  void LoadChain(TChain *Chain, int NumberFiles, const std::string &Filename, const std::string &TreeName = std::string());
+  void LoadChain(TChain *Chain, int NumberFiles, const std::string &Filename, const std::string &TreeName = std::string(), int NumberCPUs = 0);
   /**
    * This is an overload which will load a TChain by reading the filenames from a text file
    * @param Chain TChain pointer where TTree objects are loaded
-   * @param Filename Filename of text file containing all the individual ROOT files
+   * @param Filename Filename of text file containing all the individual ROOT files, and the index file is Filename.index
    * @param TreeName Name of the TTree we want to load, if this is not given it is assumed the name of the TChain has already been set
+   * @param NumberCPUs Number of processes used to open files, anything less than 1 means use all cores, and files are opened serially if ROOT's implicit multithreading is switched on
    */
-  void LoadChain(TChain *Chain, const std::string &Filename, const std::string &TreeName = std::string());
+  void LoadChain(TChain *Chain, const std::string &Filename, const std::string &TreeName = std::string(), int NumberCPUs = 0);
   /**
    * This is a helper function for loading the correct cuts
    * @param SignalMode "KKpipi", "KSKK_to_KKpipi", etc
@@ -50,6 +54,7 @@ namespace Utilities {
    * Parse arguments and set up a Settings object
    * Copied from GGSZ code repository
    * Pass inputs to application
+   * If InstrumentationOutput is set, or the environment variable KKPIPI_INSTRUMENTATION, a timing summary is written to this file at exit
    */
   Settings parse_args(int argc, char** argv);
   /**
@@ -2,8 +2,12 @@
 /**
  * cisiK0pipi is a struct for storing the RooFit variables of ci and si for K0pipi
  * By default all variables are set to be constant, but they are initalised with a multidimensional Gaussian to account for their uncertainties and correlations, and if set non-constant they will be floated but Gaussian constrained
+ * The number of bins is read from NumberBins in the binning scheme settings, which must be the same for KSpipi and KLpipi
  */
 
+#ifndef CISIK0PIPI
+#define CISIK0PIPI
+
 #include<vector>
 #include<string>
 #include"TMatrixT.h"
@@ -16,6 +20,10 @@ struct cisiK0pipi {
    * Flag to check if parameters are initialised
    */
   bool Initialised = false;
+  /**
+   * Number of \f$K^0\pi\pi\f$ bins
+   */
+  int m_NumberBins = 0;
   /**
    * Initialise ci, si and Ki
    * @param settings Settings containing paths to parameters
@@ -33,12 +41,12 @@ struct cisiK0pipi {
    */
   void Initialisecisi(const Settings &settings);
   /**
-   * Parse correlation matrix
+   * Parse correlation matrix, where the upper triangle is given in percent row by row
    * @param settings Settings containing paths to parameters
    */
   TMatrixT<double> ParseCorrelationMatrix(const Settings &settings) const;
   /**
-   * ci and si parameters
+   * ci and si parameters, ordered as KSpipi ci, KSpipi si, KLpipi ci and KLpipi si
    */
   RooArgList m_cisi;
   /**
@@ -54,3 +62,5 @@ struct cisiK0pipi {
    */
   std::vector<RooAbsPdf*> m_GaussianConstraintPDFs;
 };
+
+#endif
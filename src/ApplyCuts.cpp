@@ -5,6 +5,7 @@
 #include"TTree.h"
 #include"TEntryList.h"
 #include"TDirectory.h"
+#include"OutputWriter.h"
 
 ApplyCuts::ApplyCuts(const TCut &Cuts): m_Cuts(Cuts) {
 }
@@ -19,9 +20,10 @@ TTree* ApplyCuts::operator()(TTree *InputTree, int DataSetType, double Luminosit
   if(DataSetType >= 0 && DataSetType < 10) {
     OutputTree->Branch("DataSetType", &DataSetType, "DataSetType/I");
   }
+  OutputWriter::ConfigureTree(OutputTree);
   for(Long64_t i = 0; i < elist->GetN(); i++) {
     InputTree->GetEntry(InputTree->GetEntryNumber(i));
-    OutputTree->Fill();
+    OutputWriter::FillTree(OutputTree);
   }
   // I think this line prevents a seg fault for some reason
   gDirectory->Clear();
@@ -24,9 +24,11 @@
 #include"RooShapes/Chebychev_Shape.h"
 
 BinnedFitModel::BinnedFitModel(const Settings &settings,
-			       RooRealVar *SignalMBC): m_SignalMBC(SignalMBC),
-						       m_Category(settings),
-						       m_Settings(settings) {
+			       RooRealVar *SignalMBC,
+			       std::map<std::string, RooRealVar*> *SharedParameters): m_SignalMBC(SignalMBC),
+										       m_Category(settings),
+										       m_Settings(settings),
+										       m_SharedParameters(SharedParameters) {
   // First initialize the simultaneous fit with the correct categories for all bins
   auto CategoryVariable = m_Category.GetCategoryVariable();
   m_PDF = new RooSimultaneous(("Simultaneous_PDF_KKpipi_vs_" + settings.get("Mode")).c_str(), "", *CategoryVariable);
@@ -90,12 +92,13 @@ void BinnedFitModel::InitializeYields() {
 }
 
 void BinnedFitModel::InitializeSignalShape() {
-  m_Parameters.insert({"Mean1", Utilities::load_param(m_Settings["MBC_Shape"], m_Settings.get("Mode") + "_DoubleTag_Mean1")});
-  m_Parameters.insert({"Sigma1", Utilities::load_param(m_Settings["MBC_Shape"], m_Settings.get("Mode") + "_DoubleTag_Sigma1")});
-  auto Resolution = Unique::create<RooGaussian*>("Gaussian1", "", *m_SignalMBC, *m_Parameters["Mean1"], *m_Parameters["Sigma1"]);
+  std::string Mode = m_Settings.get("Mode");
+  m_Parameters.insert({"Mean1", LoadParameter("Mean1")});
+  m_Parameters.insert({"Sigma1", LoadParameter("Sigma1")});
+  auto Resolution = Unique::create<RooGaussian*>(Mode + "_Gaussian1", "", *m_SignalMBC, *m_Parameters["Mean1"], *m_Parameters["Sigma1"]);
   TChain SignalMCChain(m_Settings.get("TreeName").c_str());
   std::string SignalMCFilename = m_Settings["Datasets_WithDeltaECuts"].get("SignalMC_DT");
-  SignalMCFilename = Utilities::ReplaceString(SignalMCFilename, "TAG", m_Settings.get("Mode"));
+  SignalMCFilename = Utilities::ReplaceString(SignalMCFilename, "TAG", Mode);
   SignalMCChain.Add(SignalMCFilename.c_str());
   SignalMCChain.SetBranchStatus("*", 0);
   SignalMCChain.SetBranchStatus(m_Settings.get("FitVariable").c_str(), 1);
@@ -106,17 +109,19 @@ void BinnedFitModel::InitializeSignalShape() {
     ClonedMCChain = SignalMCChain.CloneTree(m_Settings.getI("Events_in_MC"));
   }
   RooDataSet MCSignal("MCSignal", "", ClonedMCChain, RooArgList(*m_SignalMBC));
-  auto SignalShape = Unique::create<RooKeysPdf*>("SignalShape", "", *m_SignalMBC, MCSignal);
-  m_SignalShapeConv = Unique::create<RooFFTConvPdf*>("SignalShapeConv", "", *m_SignalMBC, *SignalShape, *Resolution);
+  auto SignalShape = Unique::create<RooKeysPdf*>(Mode + "_SignalShape", "", *m_SignalMBC, MCSignal);
+  m_SignalShapeConv = Unique::create<RooFFTConvPdf*>(Mode + "_SignalShapeConv", "", *m_SignalMBC, *SignalShape, *Resolution);
 }
 
 void BinnedFitModel::InitializeCombinatorialShape() {
+  std::string Mode = m_Settings.get("Mode");
   if(m_Settings.getB("FullyReconstructed")) {
-    m_Parameters.insert({"End", Unique::create<RooRealVar*>("End", "", 1.8865)});
-    m_Parameters.insert({"c", Utilities::load_param(m_Settings["MBC_Shape"], m_Settings.get("Mode") + "_DoubleTag_c")});
-    m_Combinatorial = Unique::create<RooArgusBG*>("Combinatorial", "", *m_SignalMBC, *m_Parameters["End"], *m_Parameters["c"]);
+    m_Parameters.insert({"End", Unique::create<RooRealVar*>(Mode + "_End", "", 1.8865)});
+    m_Parameters.insert({"c", LoadParameter("c")});
+    m_Combinatorial = Unique::create<RooArgusBG*>("Combinatorial_" + Mode, "", *m_SignalMBC, *m_Parameters["End"], *m_Parameters["c"]);
   } else {
-    Chebychev_Shape CombinatorialShape("Combinatorial", m_Settings["MBC_Shape"], m_SignalMBC);
+    // The shape and its coefficients <Mode>_Combinatorial_c<i> are named after the tag mode, like the peaking backgrounds
+    Chebychev_Shape CombinatorialShape(Mode + "_Combinatorial", m_Settings["MBC_Shape"], m_SignalMBC);
     m_Combinatorial = CombinatorialShape.GetPDF();
   }
 }
@@ -161,6 +166,19 @@ void BinnedFitModel::InitializePDF() {
   }
 }
 
+RooRealVar* BinnedFitModel::LoadParameter(const std::string &Name) {
+  // Parameters that are shared with other tag modes are only loaded once, using the settings of the first tag mode
+  if(m_SharedParameters && m_SharedParameters->find(Name) != m_SharedParameters->end()) {
+    RooRealVar *&SharedParameter = m_SharedParameters->at(Name);
+    if(!SharedParameter) {
+      SharedParameter = Utilities::load_param(m_Settings["MBC_Shape"], m_Settings.get("Mode") + "_DoubleTag_" + Name);
+      std::cout << "Sharing " << Name << " between tag modes, initialised from " << m_Settings.get("Mode") << "\n";
+    }
+    return SharedParameter;
+  }
+  return Utilities::load_param(m_Settings["MBC_Shape"], m_Settings.get("Mode") + "_DoubleTag_" + Name);
+}
+
 double BinnedFitModel::GetFractionInSignalRegion() const {
   using namespace RooFit;
   m_SignalMBC->setRange("SignalRange", 1.86, 1.87);
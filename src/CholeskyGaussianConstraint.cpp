@@ -0,0 +1,184 @@
+// Martin Duy Tat 19th October 2026
+
+#include<vector>
+#include<cmath>
+#include<stdexcept>
+#include"TMatrixT.h"
+#include"TMath.h"
+#include"TDecompChol.h"
+#include"RooAbsPdf.h"
+#include"RooAbsReal.h"
+#include"RooListProxy.h"
+#include"RooArgList.h"
+#include"RooArgSet.h"
+#include"CholeskyGaussianConstraint.h"
+
+ClassImp(CholeskyGaussianConstraint)
+
+CholeskyGaussianConstraint::CholeskyGaussianConstraint(): m_Normalisation(1.0) {
+}
+
+CholeskyGaussianConstraint::CholeskyGaussianConstraint(const char *Name,
+						       const char *Title,
+						       const RooArgList &Parameters,
+						       const std::vector<double> &Mean,
+						       const TMatrixT<double> &CovMatrix):
+  RooAbsPdf(Name, Title),
+  m_Parameters("Parameters", "Constrained parameters", this),
+  m_Mean(Mean),
+  m_Normalisation(TMath::Power(2.0*TMath::Pi(), 0.5*Mean.size())) {
+  const int Size = Mean.size();
+  if(Parameters.getSize() != Size || CovMatrix.GetNrows() != Size || CovMatrix.GetNcols() != Size) {
+    throw std::invalid_argument("Gaussian constraint needs the same number of parameters, means and covariance matrix rows and columns");
+  }
+  m_Parameters.add(Parameters);
+  TDecompChol CholeskyDecomposition(CovMatrix);
+  if(!CholeskyDecomposition.Decompose()) {
+    throw std::runtime_error("Covariance matrix not positive definite");
+  }
+  // TDecompChol gives the upper triangular factor U with U^T U equal to the covariance matrix
+  const TMatrixT<double> &U = CholeskyDecomposition.GetU();
+  m_CholeskyFactor.assign(Size*Size, 0.0);
+  for(int i = 0; i < Size; i++) {
+    for(int j = 0; j <= i; j++) {
+      m_CholeskyFactor[i*Size + j] = U(j, i);
+    }
+    m_Normalisation *= U(i, i);
+  }
+}
+
+CholeskyGaussianConstraint::CholeskyGaussianConstraint(const CholeskyGaussianConstraint &Other, const char *Name):
+  RooAbsPdf(Other, Name),
+  m_Parameters("Parameters", this, Other.m_Parameters),
+  m_Mean(Other.m_Mean),
+  m_CholeskyFactor(Other.m_CholeskyFactor),
+  m_Normalisation(Other.m_Normalisation),
+  m_Marginals(Other.m_Marginals) {
+}
+
+TObject* CholeskyGaussianConstraint::clone(const char *NewName) const {
+  return new CholeskyGaussianConstraint(*this, NewName);
+}
+
+std::vector<double> CholeskyGaussianConstraint::GetWhitenedResiduals() const {
+  const int Size = m_Mean.size();
+  std::vector<double> z(Size);
+  for(int i = 0; i < Size; i++) {
+    double Sum = static_cast<const RooAbsReal&>(m_Parameters[i]).getVal() - m_Mean[i];
+    const double *Row = m_CholeskyFactor.data() + i*Size;
+    for(int j = 0; j < i; j++) {
+      Sum -= Row[j]*z[j];
+    }
+    z[i] = Sum/Row[i];
+  }
+  return z;
+}
+
+double CholeskyGaussianConstraint::GetChi2() const {
+  double Chi2 = 0.0;
+  for(auto z : GetWhitenedResiduals()) {
+    Chi2 += z*z;
+  }
+  return Chi2;
+}
+
+std::vector<double> CholeskyGaussianConstraint::GetGradient() const {
+  // Solve L^T g = z by back substitution, so that g is the inverse covariance matrix times the residuals
+  const int Size = m_Mean.size();
+  std::vector<double> Gradient = GetWhitenedResiduals();
+  for(int i = Size - 1; i >= 0; i--) {
+    for(int j = i + 1; j < Size; j++) {
+      Gradient[i] -= m_CholeskyFactor[j*Size + i]*Gradient[j];
+    }
+    Gradient[i] /= m_CholeskyFactor[i*Size + i];
+  }
+  return Gradient;
+}
+
+Double_t CholeskyGaussianConstraint::evaluate() const {
+  return std::exp(-0.5*GetChi2());
+}
+
+Int_t CholeskyGaussianConstraint::getAnalyticalIntegral(RooArgSet &AllVars, RooArgSet &AnalVars, const char*) const {
+  // Any subset of the parameters can be integrated out, which leaves a Gaussian in the remaining parameters with the covariance sub-block
+  const int Size = m_Mean.size();
+  std::vector<int> Remaining;
+  RooArgSet Integrated;
+  for(int i = 0; i < Size; i++) {
+    if(AllVars.find(m_Parameters[i])) {
+      Integrated.add(m_Parameters[i]);
+    } else {
+      Remaining.push_back(i);
+    }
+  }
+  if(Integrated.getSize() == 0) {
+    return 0;
+  }
+  AnalVars.add(Integrated);
+  for(std::size_t Code = 0; Code < m_Marginals.size(); Code++) {
+    if(m_Marginals[Code].Remaining == Remaining) {
+      return Code + 1;
+    }
+  }
+  m_Marginals.push_back(GetMarginal(Remaining));
+  return m_Marginals.size();
+}
+
+Double_t CholeskyGaussianConstraint::analyticalIntegral(Int_t Code, const char*) const {
+  if(Code < 1 || Code > static_cast<Int_t>(m_Marginals.size())) {
+    throw std::invalid_argument("Unknown integration code for Gaussian constraint");
+  }
+  const Marginal &marginal = m_Marginals[Code - 1];
+  const int Size = marginal.Remaining.size();
+  double Chi2 = 0.0;
+  std::vector<double> z(Size);
+  for(int i = 0; i < Size; i++) {
+    const int Index = marginal.Remaining[i];
+    double Sum = static_cast<const RooAbsReal&>(m_Parameters[Index]).getVal() - m_Mean[Index];
+    const double *Row = marginal.CholeskyFactor.data() + i*Size;
+    for(int j = 0; j < i; j++) {
+      Sum -= Row[j]*z[j];
+    }
+    z[i] = Sum/Row[i];
+    Chi2 += z[i]*z[i];
+  }
+  return marginal.Normalisation*std::exp(-0.5*Chi2);
+}
+
+CholeskyGaussianConstraint::Marginal CholeskyGaussianConstraint::GetMarginal(const std::vector<int> &Remaining) const {
+  const int FullSize = m_Mean.size();
+  const int Size = Remaining.size();
+  Marginal marginal;
+  marginal.Remaining = Remaining;
+  // The integral over the other parameters is (2 pi)^(k/2) det L/det L_R, where L_R is the Cholesky factor of the covariance sub-block
+  marginal.Normalisation = m_Normalisation/TMath::Power(2.0*TMath::Pi(), 0.5*Size);
+  if(Size == 0) {
+    return marginal;
+  }
+  // The covariance sub-block is L_R L_R^T, where L_R are the rows of the full factor
+  TMatrixT<double> CovMatrix(Size, Size);
+  for(int i = 0; i < Size; i++) {
+    for(int j = 0; j < Size; j++) {
+      const double *Row_i = m_CholeskyFactor.data() + Remaining[i]*FullSize;
+      const double *Row_j = m_CholeskyFactor.data() + Remaining[j]*FullSize;
+      double Sum = 0.0;
+      for(int k = 0; k < FullSize; k++) {
+	Sum += Row_i[k]*Row_j[k];
+      }
+      CovMatrix(i, j) = Sum;
+    }
+  }
+  TDecompChol CholeskyDecomposition(CovMatrix);
+  if(!CholeskyDecomposition.Decompose()) {
+    throw std::runtime_error("Covariance sub-matrix not positive definite");
+  }
+  const TMatrixT<double> &U = CholeskyDecomposition.GetU();
+  marginal.CholeskyFactor.assign(Size*Size, 0.0);
+  for(int i = 0; i < Size; i++) {
+    for(int j = 0; j <= i; j++) {
+      marginal.CholeskyFactor[i*Size + j] = U(j, i);
+    }
+    marginal.Normalisation /= U(i, i);
+  }
+  return marginal;
+}
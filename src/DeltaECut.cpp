@@ -2,12 +2,18 @@
 
 #include<string>
 #include<iostream>
+#include<fstream>
 #include<sstream>
 #include<algorithm>
 #include<stdexcept>
+#include<map>
+#include<vector>
+#include<utility>
+#include<mutex>
+#include<cstdio>
+#include<unistd.h>
 #include"TCut.h"
 #include"DeltaECut.h"
-#include"Settings.h"
 
 DeltaECut::DeltaECut(const std::string &TagMode,
 		     const std::string &TagType,
@@ -40,10 +46,135 @@ TCut DeltaECut::GetDeltaECut() const {
 }
 
 TCut DeltaECut::GetDeltaECutFromFile(const std::string &TagMode, const std::string &TagSide) const {
-  std::string CutFilename(std::string(DELTAE_CUTS_DIR) + "DeltaECuts_" + m_DataMC + ".cut");
-  Settings DeltaESettings("DeltaESettings", CutFilename);
-  double Lower = DeltaESettings.getD(TagMode + "_DeltaE_LowerCut");
-  double Upper = DeltaESettings.getD(TagMode + "_DeltaE_UpperCut");
+  const auto &CutTable = GetDeltaECutTable(m_DataMC);
+  auto iter = CutTable.find(TagMode);
+  if(iter == CutTable.end()) {
+    throw std::runtime_error("No Delta E cut for " + TagMode + " in " + GetDeltaECutFilename(m_DataMC));
+  }
+  double Lower = iter->second.first;
+  double Upper = iter->second.second;
   std::string Cut = std::string(TagSide + "DeltaE > " + std::to_string(Lower) + " && " + TagSide + "DeltaE < " + std::to_string(Upper));
   return TCut(Cut.c_str());
 }
+
+namespace {
+  /**
+   * Cached cut tables, one for data and one for MC
+   */
+  std::map<std::string, std::map<std::string, std::pair<double, double>>> CutTables;
+  /**
+   * Mutex protecting the cached cut tables
+   */
+  std::mutex CutTablesMutex;
+}
+
+const std::map<std::string, std::pair<double, double>>& DeltaECut::GetDeltaECutTable(const std::string &DataMC) {
+  std::lock_guard<std::mutex> Lock(CutTablesMutex);
+  auto iter = CutTables.find(DataMC);
+  if(iter == CutTables.end()) {
+    iter = CutTables.insert({DataMC, ReadDeltaECutFile(GetDeltaECutFilename(DataMC))}).first;
+  }
+  return iter->second;
+}
+
+void DeltaECut::SaveDeltaECuts(const std::map<std::string, std::pair<double, double>> &Cuts, const std::string &DataMC) {
+  std::string Filename = GetDeltaECutFilename(DataMC);
+  std::lock_guard<std::mutex> Lock(CutTablesMutex);
+  // Always start from the database on disk, in case another process has updated it
+  // Only the lines of the updated modes are replaced, so that comments and the order of the modes are kept
+  std::vector<std::string> Lines;
+  std::ifstream ExistingFile(Filename);
+  std::string Line;
+  while(std::getline(ExistingFile, Line)) {
+    Lines.push_back(Line);
+  }
+  ExistingFile.close();
+  const std::string LowerSuffix("_DeltaE_LowerCut");
+  const std::string UpperSuffix("_DeltaE_UpperCut");
+  std::map<std::string, int> UpdatedCuts;
+  auto FormatCut = [] (double Cut) {
+    std::stringstream ss;
+    ss << Cut;
+    return ss.str();
+  };
+  for(auto &ExistingLine : Lines) {
+    std::stringstream ss(ExistingLine);
+    std::string Name;
+    if(!(ss >> Name) || Name[0] == '*') {
+      continue;
+    }
+    for(const auto &Cut : Cuts) {
+      if(Name == Cut.first + LowerSuffix) {
+	ExistingLine = Name + " " + FormatCut(Cut.second.first);
+	UpdatedCuts[Cut.first] |= 1;
+      } else if(Name == Cut.first + UpperSuffix) {
+	ExistingLine = Name + " " + FormatCut(Cut.second.second);
+	UpdatedCuts[Cut.first] |= 2;
+      }
+    }
+  }
+  std::string TemporaryFilename = Filename + ".tmp" + std::to_string(getpid());
+  std::ofstream OutputFile(TemporaryFilename);
+  for(const auto &ExistingLine : Lines) {
+    OutputFile << ExistingLine << "\n";
+  }
+  // New modes are added at the end
+  for(const auto &Cut : Cuts) {
+    if(UpdatedCuts[Cut.first] == 3) {
+      continue;
+    }
+    OutputFile << "\n";
+    if(!(UpdatedCuts[Cut.first] & 1)) {
+      OutputFile << Cut.first << LowerSuffix << " " << FormatCut(Cut.second.first) << "\n";
+    }
+    if(!(UpdatedCuts[Cut.first] & 2)) {
+      OutputFile << Cut.first << UpperSuffix << " " << FormatCut(Cut.second.second) << "\n";
+    }
+  }
+  OutputFile.close();
+  if(!OutputFile || std::rename(TemporaryFilename.c_str(), Filename.c_str()) != 0) {
+    std::remove(TemporaryFilename.c_str());
+    throw std::runtime_error("Could not write Delta E cuts to " + Filename);
+  }
+  CutTables[DataMC] = ReadDeltaECutFile(Filename);
+}
+
+std::string DeltaECut::GetDeltaECutFilename(const std::string &DataMC) {
+  return std::string(DELTAE_CUTS_DIR) + "DeltaECuts_" + DataMC + ".cut";
+}
+
+std::map<std::string, std::pair<double, double>> DeltaECut::ReadDeltaECutFile(const std::string &Filename) {
+  std::ifstream CutFile(Filename);
+  if(!CutFile.is_open()) {
+    throw std::runtime_error("Cannot open Delta E cuts file " + Filename);
+  }
+  const std::string LowerSuffix("_DeltaE_LowerCut");
+  const std::string UpperSuffix("_DeltaE_UpperCut");
+  std::map<std::string, std::pair<double, double>> CutTable;
+  std::map<std::string, int> FoundCuts;
+  std::string Line;
+  while(std::getline(CutFile, Line)) {
+    std::stringstream ss(Line);
+    std::string Name;
+    double Value;
+    if(!(ss >> Name >> Value) || Name[0] == '*') {
+      continue;
+    }
+    // Lower cut is flagged with bit 1 and upper cut with bit 2
+    if(Name.size() > LowerSuffix.size() && Name.compare(Name.size() - LowerSuffix.size(), LowerSuffix.size(), LowerSuffix) == 0) {
+      std::string Mode = Name.substr(0, Name.size() - LowerSuffix.size());
+      CutTable[Mode].first = Value;
+      FoundCuts[Mode] |= 1;
+    } else if(Name.size() > UpperSuffix.size() && Name.compare(Name.size() - UpperSuffix.size(), UpperSuffix.size(), UpperSuffix) == 0) {
+      std::string Mode = Name.substr(0, Name.size() - UpperSuffix.size());
+      CutTable[Mode].second = Value;
+      FoundCuts[Mode] |= 2;
+    }
+  }
+  for(const auto &Found : FoundCuts) {
+    if(Found.second != 3) {
+      throw std::runtime_error("Delta E cuts file " + Filename + " is missing a cut for " + Found.first);
+    }
+  }
+  return CutTable;
+}
@@ -1,56 +1,119 @@
 // Martin Duy Tat 31st March 2021
 
 #include<string>
+#include<utility>
 #include<fstream>
+#include<vector>
+#include<memory>
+#include<algorithm>
 #include"TTree.h"
 #include"TH1D.h"
 #include"TCanvas.h"
 #include"TPad.h"
 #include"TLine.h"
 #include"TMath.h"
+#include"TRandom3.h"
 #include"RooRealVar.h"
 #include"RooDataHist.h"
 #include"RooDataSet.h"
 #include"RooAbsPdf.h"
 #include"RooArgList.h"
+#include"RooArgSet.h"
 #include"RooPlot.h"
 #include"RooHist.h"
 #include"RooFitResult.h"
 #include"DeltaEFit.h"
 #include"DeltaEFitModel.h"
 #include"Settings.h"
+#include"Utilities.h"
 
 DeltaEFit::DeltaEFit(TTree *Tree, const Settings &settings):
-                     m_Tree(Tree),
 		     m_Settings(settings),
 		     m_DeltaE("DeltaE", "DeltaE", m_Settings.getD("DeltaE_Low_Range"), m_Settings.getD("DeltaE_High_Range")),
-                     m_LuminosityWeight("LuminosityWeight", "LuminosityWeight", 1.0, 0.0, 10.0) {
-  m_Tree->SetBranchStatus("*", 0);
-  m_Tree->SetBranchStatus("DeltaE" , 1);
-  m_Tree->SetBranchStatus("LuminosityWeight", 1);
-  m_Tree = m_Tree->CloneTree();
+                     m_LuminosityWeight("LuminosityWeight", "LuminosityWeight", 1.0, 0.0, 10.0),
+		     m_DeltaE_Low(m_Settings.getD("DeltaE_Low_Range")),
+		     m_DeltaE_High(m_Settings.getD("DeltaE_High_Range")),
+		     m_FitStatus(-1) {
+  Tree->SetBranchStatus("*", 0);
+  Tree->SetBranchStatus("DeltaE" , 1);
+  Tree->SetBranchStatus("LuminosityWeight", 1);
+  double DeltaE, LuminosityWeight;
+  Tree->SetBranchAddress("DeltaE", &DeltaE);
+  Tree->SetBranchAddress("LuminosityWeight", &LuminosityWeight);
+  Long64_t Entries = Tree->GetEntries();
+  m_DeltaEColumn.reserve(Entries);
+  m_WeightColumn.reserve(Entries);
+  for(Long64_t i = 0; i < Entries; i++) {
+    Tree->GetEntry(i);
+    // Same selection as importing the tree into an unbinned dataset, where events outside the variable ranges are dropped
+    if(!m_DeltaE.inRange(DeltaE, nullptr) || !m_LuminosityWeight.inRange(LuminosityWeight, nullptr)) {
+      continue;
+    }
+    m_DeltaEColumn.push_back(static_cast<float>(DeltaE));
+    m_WeightColumn.push_back(static_cast<float>(LuminosityWeight));
+  }
+  Tree->ResetBranchAddresses();
+  Tree->SetBranchStatus("*", 1);
+  BuildFitModel();
+}
+
+void DeltaEFit::BuildFitModel() {
+  // The old model must be destroyed before the new one is built
+  m_InitialParameters.reset();
+  m_Parameters.reset();
+  m_FitModel.reset();
+  m_FitModel.reset(new DeltaEFitModel(m_Settings, &m_DeltaE));
+  m_Parameters.reset(m_FitModel->GetModel()->getParameters(m_DeltaE));
+  m_InitialParameters.reset(static_cast<RooArgSet*>(m_Parameters->snapshot()));
 }
 
-void DeltaEFit::FitDeltaE() {
+void DeltaEFit::FitDeltaE(unsigned int BootstrapSeed) {
   using namespace RooFit;
-  DeltaEFitModel FitModel(m_Settings, &m_DeltaE);
-  TH1D h1("h1", "h1", 1000, m_Settings.getD("DeltaE_Low_Range"), m_Settings.getD("DeltaE_High_Range"));
-  m_Tree->Draw("DeltaE >> h1", "LuminosityWeight", "goff");
-  static RooDataHist BinnedData("BinnedData", "BinnedData", RooArgList(m_DeltaE), &h1);
-  static RooDataSet UnbinnedData("UnbinnedData", "UnbinnedData", m_Tree, RooArgList(m_DeltaE, m_LuminosityWeight), "", "LuminosityWeight");
-  RooFitResult *Results;
-  auto Model = FitModel.GetModel();
+  // Every fit starts from the same initial parameters, independent of the previous fit
+  m_Parameters->assignValueOnly(*m_InitialParameters);
+  const bool UnbinnedFit = m_Settings.get("FitType") == "UnbinnedFit";
+  // All data belongs to this fit, and is filled in a single pass over the column store
+  TH1D FitHistogram("FitHistogram", "", 1000, m_DeltaE.getMin(), m_DeltaE.getMax());
+  TH1D PlotHistogram("PlotHistogram", "", 400, m_DeltaE.getMin(), m_DeltaE.getMax());
+  FitHistogram.SetDirectory(nullptr);
+  PlotHistogram.SetDirectory(nullptr);
+  PlotHistogram.Sumw2();
+  RooDataSet UnbinnedData("UnbinnedData", "UnbinnedData", RooArgSet(m_DeltaE, m_LuminosityWeight), WeightVar(m_LuminosityWeight));
+  TRandom3 Random(BootstrapSeed);
+  for(std::size_t i = 0; i < m_DeltaEColumn.size(); i++) {
+    double Weight = m_WeightColumn[i];
+    if(BootstrapSeed != 0) {
+      Weight *= Random.Poisson(1.0);
+      if(Weight == 0.0) {
+	continue;
+      }
+    }
+    FitHistogram.Fill(m_DeltaEColumn[i], Weight);
+    PlotHistogram.Fill(m_DeltaEColumn[i], Weight);
+    if(UnbinnedFit) {
+      m_DeltaE.setVal(m_DeltaEColumn[i]);
+      UnbinnedData.add(RooArgSet(m_DeltaE), Weight);
+    }
+  }
+  RooDataHist BinnedData("BinnedData", "BinnedData", RooArgList(m_DeltaE), &FitHistogram);
+  RooDataHist PlotData("PlotData", "PlotData", RooArgList(m_DeltaE), &PlotHistogram);
+  auto Model = m_FitModel->GetModel();
   if(m_Settings.get("FitType") != "NoFit") {
-    Results = Model->fitTo(BinnedData, Save(), Strategy(2), AsymptoticError(true));
-    if(m_Settings.get("FitType") == "UnbinnedFit") {
-      Results = Model->fitTo(UnbinnedData, Save(), Strategy(2), NumCPU(4), AsymptoticError(true));
+    std::unique_ptr<RooFitResult> Results(Model->fitTo(BinnedData, Save(), Strategy(2), AsymptoticError(true)));
+    if(UnbinnedFit) {
+      Results.reset(Model->fitTo(UnbinnedData, Save(), Strategy(2), NumCPU(4), AsymptoticError(true)));
     }
-    SaveParameters(Results);
+    CalculateDeltaECuts(Results.get());
+    if(BootstrapSeed == 0) {
+      SaveParameters(Results.get());
+    }
+  }
+  if(BootstrapSeed == 0) {
+    SavePlot(PlotData, *m_FitModel);
   }
-  SavePlot(UnbinnedData, FitModel);
 }
 
-void DeltaEFit::SavePlot(const RooDataSet &UnbinnedData, const DeltaEFitModel &FitModel) const {
+void DeltaEFit::SavePlot(const RooDataHist &PlotData, const DeltaEFitModel &FitModel) const {
   using namespace RooFit;
   TCanvas c1("c1", "c1", 1600, 1200);
   TPad Pad1("Pad1", "Pad1", 0.0, 0.25, 1.0, 1.0);
@@ -66,7 +129,7 @@ void DeltaEFit::SavePlot(const RooDataSet &UnbinnedData, const DeltaEFitModel &F
   Pad1.cd();
   RooPlot *Frame = m_DeltaE.frame();
   Frame->SetTitle((m_Settings.get("Mode") + std::string(" Single Tag #Delta E fit;#Delta E (GeV);Events")).c_str());
-  UnbinnedData.plotOn(Frame, Binning(400));
+  PlotData.plotOn(Frame);
   auto Model = FitModel.GetModel();
   Model->plotOn(Frame, LineColor(kBlue), Normalization(1.0, RooAbsReal::Relative));
   RooHist *Pull = Frame->pullHist();
@@ -98,18 +161,13 @@ void DeltaEFit::SavePlot(const RooDataSet &UnbinnedData, const DeltaEFitModel &F
   c1.SaveAs(m_Settings.get("PlotFilename").c_str());
 }
 
-void DeltaEFit::SaveParameters(RooFitResult *Results) {
-  Results->Print("V");
-  std::ofstream OutputFile(m_Settings.get("ResultsFilename"));
-  OutputFile << "status " << Results->status() << "\n";
-  OutputFile << "covQual " << Results->covQual() << "\n";
+void DeltaEFit::CalculateDeltaECuts(RooFitResult *Results) {
+  m_FitStatus = Results->status();
   RooArgList floating_param = Results->floatParsFinal();
   double mu_f = 0.0, mu = 0.0, sigma_f = 0.0, sigma = 0.0, frac = 0.0;
   for(int i = 0; i < floating_param.getSize(); i++) {
     RooRealVar *param = static_cast<RooRealVar*>(floating_param.at(i));
     std::string Name(param->GetName());
-    OutputFile << Name << " " << param->getVal() << "\n";
-    OutputFile << Name << "_err " << param->getError() << "\n";
     if(Name.find("mu_f") != std::string::npos) {
       mu_f = param->getVal();
     } else if(Name.find("mu") != std::string::npos) {
@@ -128,8 +186,28 @@ void DeltaEFit::SaveParameters(RooFitResult *Results) {
   double sigma2 = sigma*sigma_f;
   double Mean = mu1*frac + mu2*(1 - frac);
   double Sigma = TMath::Sqrt(sigma1*sigma1*frac + sigma2*sigma2*(1 - frac) + (mu1 - mu2)*(mu1 - mu2)*frac*(1 - frac));
-  m_DeltaE_Low = Mean - 3.0*Sigma;
+  // Modes with photons have a radiative tail, so their lower cut is at 4 sigma
+  std::string Mode = m_Settings.get("Mode");
+  std::vector<std::string> FourSigmaModes = Utilities::ConvertStringToVector(m_Settings.get("DeltaE_FourSigmaLowerCutModes"));
+  double LowerCutSigma = std::find(FourSigmaModes.begin(), FourSigmaModes.end(), Mode) != FourSigmaModes.end() ? 4.0 : 3.0;
+  if(m_Settings.contains(Mode + "_DeltaE_LowerCutSigma")) {
+    LowerCutSigma = m_Settings.getD(Mode + "_DeltaE_LowerCutSigma");
+  }
+  m_DeltaE_Low = Mean - LowerCutSigma*Sigma;
   m_DeltaE_High = Mean + 3.0*Sigma;
+}
+
+void DeltaEFit::SaveParameters(RooFitResult *Results) const {
+  Results->Print("V");
+  std::ofstream OutputFile(m_Settings.get("ResultsFilename"));
+  OutputFile << "status " << Results->status() << "\n";
+  OutputFile << "covQual " << Results->covQual() << "\n";
+  RooArgList floating_param = Results->floatParsFinal();
+  for(int i = 0; i < floating_param.getSize(); i++) {
+    RooRealVar *param = static_cast<RooRealVar*>(floating_param.at(i));
+    OutputFile << param->GetName() << " " << param->getVal() << "\n";
+    OutputFile << param->GetName() << "_err " << param->getError() << "\n";
+  }
   OutputFile << m_Settings.get("Mode") << "_DeltaE_LowerCut " << m_DeltaE_Low << "\n";
   OutputFile << m_Settings.get("Mode") << "_DeltaE_UpperCut " << m_DeltaE_High << "\n";
   OutputFile.close();
@@ -137,4 +215,13 @@ void DeltaEFit::SaveParameters(RooFitResult *Results) {
 
 void DeltaEFit::ReloadSettings(const Settings &settings) {
   m_Settings = settings;
+  BuildFitModel();
+}
+
+std::pair<double, double> DeltaEFit::GetDeltaECuts() const {
+  return std::make_pair(m_DeltaE_Low, m_DeltaE_High);
+}
+
+int DeltaEFit::GetFitStatus() const {
+  return m_FitStatus;
 }
@@ -1,9 +1,14 @@
 // Martin Duy Tat 26th November 2021
 
+#include<iostream>
 #include<fstream>
 #include<iomanip>
 #include<string>
 #include<vector>
+#include<memory>
+#include<algorithm>
+#include<stdexcept>
+#include<cstdlib>
 #include"TTree.h"
 #include"TPad.h"
 #include"TCanvas.h"
@@ -13,8 +18,14 @@
 #include"TFile.h"
 #include"TRandom.h"
 #include"TLatex.h"
+#include"TMath.h"
+#include"TH2D.h"
+#include"TDirectory.h"
+#include"TList.h"
 #include"RooRealVar.h"
 #include"RooDataSet.h"
+#include"RooDataHist.h"
+#include"RooCategory.h"
 #include"RooFitResult.h"
 #include"RooSimultaneous.h"
 #include"RooPlot.h"
@@ -22,11 +33,17 @@
 #include"RooMsgService.h"
 #include"RooStats/SPlot.h"
 #include"RooStats/RooStatsUtils.h"
+#include"ROOT/TProcessExecutor.hxx"
+#include"ROOT/TSeq.hxx"
 #include"DoubleTagYield.h"
 #include"Settings.h"
 #include"BinnedDataLoader.h"
 #include"BinnedFitModel.h"
 #include"Category.h"
+#include"OldDoubleTagYield.h"
+#include"ParallelNLL.h"
+#include"Instrumentation.h"
+#include"OutputWriter.h"
 #include"Utilities.h"
 #include"Bes3plotstyle.h"
 
@@ -46,19 +63,23 @@ DoubleTagYield::DoubleTagYield(const Settings &settings, TTree *Tree): m_SignalM
 
 void DoubleTagYield::DoFit() {
   using namespace RooFit;
+  Instrumentation::ScopedTimer LoadTimer("DoubleTagYield::LoadData");
   BinnedDataLoader DataLoader(m_Settings, m_Tree, &m_SignalMBC);
   RooDataSet *DataSet = DataLoader.GetDataSet();
+  LoadTimer.AddEvents(DataSet->numEntries());
+  LoadTimer.Stop();
   BinnedFitModel FitModel(m_Settings, &m_SignalMBC);
   RooSimultaneous *Model = FitModel.GetPDF();
   std::vector<std::string> Categories = DataLoader.GetCategoryObject()->GetCategories();
   // Perform an initial fit
   RooArgSet *Parameters = Model->getParameters(m_SignalMBC);
   m_InitialParameters = Parameters->snapshot();
-  int nCPUs = 1;
-  if(Categories.size() > 1) {
-    nCPUs = 4;
-  }
-  auto Result = Model->fitTo(*DataSet, Save(), NumCPU(nCPUs), Strategy(2), Minos(true), Minimizer("Minuit2","migrad"));
+  // The likelihood is split into chunks of events in each category and shared between all cores
+  int nCPUs = ParallelNLL::GetAvailableCPUs(m_Settings.contains("NumberCPUs") ? m_Settings.getI("NumberCPUs") : 0);
+  int ChunkSize = m_Settings.contains("NLLChunkSize") ? m_Settings.getI("NLLChunkSize") : 0;
+  ParallelNLL NLL("DoubleTag_NLL", *Model, *DataSet, nCPUs, ChunkSize);
+  Instrumentation::ScopedTimer FitTimer("DoubleTagYield::Fit");
+  auto Result = NLL.Fit(true);
   // Any bins with less than 0.5 combinatorial background events are set constant
   for(const auto &Category : Categories) {
     RooRealVar *CombinatorialYield = static_cast<RooRealVar*>(FitModel.m_Yields[Category + "_CombinatorialYield"]);
@@ -68,13 +89,19 @@ void DoubleTagYield::DoFit() {
   }
   // Perform a second fit if fit is binned
   if(Categories.size() > 1) {
-    Result = Model->fitTo(*DataSet, Save(), NumCPU(nCPUs), Strategy(2), Minos(true), Minimizer("Minuit2","migrad"));
+    delete Result;
+    Result = NLL.Fit(true);
   }
+  FitTimer.Stop();
   Result->Print("V");
+  Instrumentation::ScopedTimer PlotTimer("DoubleTagYield::PlotProjections");
   PlotProjections(&DataLoader, &FitModel);
+  PlotTimer.Stop();
   SaveSignalYields(FitModel, Result, *DataLoader.GetCategoryObject());
+  CrossCheckYields(FitModel, *DataLoader.GetCategoryObject());
   // Smear peaking backgrounds for systematics studies
   if(m_Settings.getB("YieldSystematics")) {
+    Instrumentation::ScopedTimer SystematicsTimer("DoubleTagYield::YieldSystematics");
     std::ofstream OutputFile(m_Settings.get("FittedSignalYieldsFile"), std::ios_base::app);
     OutputFile << "\n* Systematic uncertainties\n\n";
     std::map<std::string, double> SystError;
@@ -92,7 +119,8 @@ void DoubleTagYield::DoFit() {
 	std::cout << "Starting systematics fit number: " << i << "\n";
 	*Parameters = *m_InitialParameters;
 	FitModel.SmearPeakingBackgrounds();
-	Result = Model->fitTo(*DataSet, Strategy(2), Save(), NumCPU(nCPUs));
+	delete Result;
+	Result = NLL.Fit(false, "Minuit");
 	Result->Print("V");
 	if(Result->status() == 0 && Result->covQual() == 3) {
 	  SuccessfulFits++;
@@ -127,10 +155,10 @@ void DoubleTagYield::DoFit() {
     }
     OutputFile.close();
     if(Categories.size() > 1) {
-      TFile SystCovMatrixFile("PeakingBackground_CovMatrix.root", "RECREATE");
-      SystCovMatrixFile.cd();
+      auto SystCovMatrixFile = OutputWriter::OpenFile("PeakingBackground_CovMatrix.root", OutputWriter::Stage::Archival);
+      SystCovMatrixFile->cd();
       SystCovMatrix.Write("CovMatrix");
-      SystCovMatrixFile.Close();
+      SystCovMatrixFile->Close();
     }
   }
   if(m_Settings.contains("sPlotReweight") && m_Settings.getB("sPlotReweight")) {
@@ -139,132 +167,166 @@ void DoubleTagYield::DoFit() {
 }
 
 void DoubleTagYield::PlotProjections(BinnedDataLoader *DataLoader, BinnedFitModel *FitModel) {
-  using namespace RooFit;
+  if(m_Settings.contains("PlotProjections") && !m_Settings.getB("PlotProjections")) {
+    std::cout << "Skipping plots of fit projections\n";
+    return;
+  }
   SetStyle();
   SetPrelimStyle();
-  auto Model = FitModel->GetPDF();
   Category *category = DataLoader->GetCategoryObject();
   RooCategory *CategoryVariable = category->GetCategoryVariable();
   RooDataSet *DataSet = DataLoader->GetDataSet();
-  for(const auto &Category : category->GetCategories()) {
-    int SignalBin = category->GetSignalBinNumber(Category);
-    int TagBin = category->GetTagBinNumber(Category);
-    TCanvas c1((Category + "_c1").c_str(), "", 1600, 1600);
-    TPad Pad1((Category + "_Pad1").c_str(), "", 0.0, 0.25, 1.0, 1.0);
-    TPad Pad2((Category + "_Pad2").c_str(), "", 0.0, 0.0, 1.0, 0.25);
-    Pad1.Draw();
-    Pad2.Draw();
-    /*Pad1.SetBottomMargin(0.1);
-    Pad1.SetTopMargin(0.1);
-    Pad1.SetBorderMode(0);
-    Pad2.SetBorderMode(0);
-    Pad2.SetBottomMargin(0.1);
-    Pad2.SetTopMargin(0.05);*/
-    Pad1.cd();
-    RooPlot *Frame = m_SignalMBC.frame();
-    FormatAxis(Frame->GetXaxis());
-    FormatAxis(Frame->GetYaxis());
-    if(m_Settings.contains("No_x_axis_tick_label") && m_Settings.getB("No_x_axis_tick_label")) {
-      Frame->GetXaxis()->SetLabelSize(0);
-      std::cout << "Removing tick labels\n";
-    }
-    std::string TagMode = m_Settings.get("Mode");
-    TLatex Text;
-    Text.SetTextFont(42);
-    Text.SetTextSize(0.09);
-    Text.SetTextColor(kBlack);
-    Text.SetNDC(true);
-    std::string LabelText = Utilities::GetTagNameLaTeX(TagMode);
-    std::string Title;// = "Double tag fit of ";
-    //Title += Utilities::GetTagNameLaTeX("KKpipi");
-    //Title += " vs ";
-    //Title += Utilities::GetTagNameLaTeX(TagMode);
-    if(SignalBin != 0) {
-      //Title += ", KK#pi#pi bin " + std::to_string(SignalBin);
-      LabelText += ", bin " + std::to_string(SignalBin);
-    /*} else {
-      Title += ", inclusive KK#pi#pi phase space";*/
-    }
-    if(TagMode == "KSpipi" || TagMode == "KSpipiPartReco" || TagMode == "KLpipi" || TagMode == "KSKK" || TagMode == "KLKK" || TagMode == "KKpipi") {
-      //Title += ", tag bin " + std::to_string(TagBin);
-      LabelText = "#splitline{" + LabelText;
-      LabelText += "}{Bin " + std::to_string(TagBin) + "}";
-    }
-    if(TagMode.substr(0, 2) == "KL" || (TagMode.length() > 8 && TagMode.substr(TagMode.length() - 8, TagMode.length()) == "PartReco")) {
-      Title += ";M_{ miss}^{ 2} (GeV^{2}/#it{c}^{4}); Events / ";
-    } else if(TagMode == "KeNu") {
-      Title += ";U_{ miss} (GeV/#it{c}^{2}); Events / ";
-    } else {
-      Title += ";M_{ BC} (GeV/#it{c}^{2}); Events / ";
-    }
-    Text.SetText(0.2, 0.8, LabelText.c_str());
-    if(TagMode.substr(0, 2) == "KL" || (TagMode.length() > 8 && TagMode.substr(TagMode.length() - 8, TagMode.length()) == "PartReco")) {
-      std::stringstream ss;
-      ss << std::fixed << std::setprecision(3) << (m_SignalMBC.getMax() - m_SignalMBC.getMin())/m_Settings.getI("Bins_in_plots");
-      Title += ss.str();
-      Title += " GeV^{2}/#it{c}^{4}";
-    } else {
-      std::stringstream ss;
-      ss << std::fixed << std::setprecision(1) << 1000.0*(m_SignalMBC.getMax() - m_SignalMBC.getMin())/m_Settings.getI("Bins_in_plots");
-      Title += ss.str();
-      Title += " MeV/#it{c}^{2}";
-    }
-    Frame->SetTitle(Title.c_str());
-    RooPlot *Data_RooPlot = DataSet->plotOn(Frame, Binning(m_Settings.getI("Bins_in_plots")), MarkerSize(3), LineWidth(3), Cut((std::string(CategoryVariable->GetName()) + "==" + std::string(CategoryVariable->GetName()) + "::" + Category).c_str()));
-    auto Data_RooHist = Data_RooPlot->getHist();
-    // Against my wishes, I had to remove data points of empty bins
-    for(int i = 0; i < Data_RooHist->GetN(); i++) {
-      if(Data_RooHist->GetPointY(i) == 0.0) {
-	Data_RooHist->SetPointY(i, -1000.0);
-      }
+  const std::vector<std::string> Categories = category->GetCategories();
+  // Partition the dataset by category once, instead of scanning the full dataset with a cut for every plot
+  std::unique_ptr<TList> CategoryDataSets(DataSet->split(*CategoryVariable));
+  if(!CategoryDataSets) {
+    throw std::runtime_error("Cannot split double tag dataset into categories");
+  }
+  RooDataSet EmptyDataSet("EmptyDataSet", "", *DataSet->get());
+  // The projection over categories only needs the number of events in each category
+  RooDataHist CategoryCounts("CategoryCounts", "", *CategoryVariable, *DataSet);
+  // Plots are rendered in forked processes, each with its own copy of the fitted parameters
+  int Workers = m_Settings.contains("PlotWorkers") ? m_Settings.getI("PlotWorkers") : ParallelNLL::GetAvailableCPUs(m_Settings.contains("NumberCPUs") ? m_Settings.getI("NumberCPUs") : 0);
+  Workers = std::max(1, std::min(Workers, static_cast<int>(Categories.size())));
+  auto PlotChunk = [&] (int Chunk) {
+    int Plots = 0;
+    for(std::size_t i = Chunk; i < Categories.size(); i += Workers) {
+      RooAbsData *CategoryData = static_cast<RooAbsData*>(CategoryDataSets->FindObject(Categories[i].c_str()));
+      PlotCategory(category, Categories[i], CategoryData ? *CategoryData : EmptyDataSet, CategoryCounts, FitModel);
+      Plots++;
     }
-    FormatData(Data_RooHist);
-    Data_RooHist->SetMinimum(0.0);
-    if(TagMode == "KSpipiPartReco") {
-      Frame->SetNdivisions(-405);
+    return Plots;
+  };
+  if(Workers == 1) {
+    PlotChunk(0);
+  } else {
+    ROOT::TProcessExecutor Executor(Workers);
+    Executor.Map(PlotChunk, ROOT::TSeqI(Workers));
+  }
+  CategoryDataSets->Delete();
+}
+
+void DoubleTagYield::PlotCategory(Category *category, const std::string &Category, RooAbsData &CategoryData, const RooDataHist &CategoryCounts, BinnedFitModel *FitModel) {
+  using namespace RooFit;
+  auto Model = FitModel->GetPDF();
+  RooCategory *CategoryVariable = category->GetCategoryVariable();
+  int SignalBin = category->GetSignalBinNumber(Category);
+  int TagBin = category->GetTagBinNumber(Category);
+  TCanvas c1((Category + "_c1").c_str(), "", 1600, 1600);
+  TPad Pad1((Category + "_Pad1").c_str(), "", 0.0, 0.25, 1.0, 1.0);
+  TPad Pad2((Category + "_Pad2").c_str(), "", 0.0, 0.0, 1.0, 0.25);
+  Pad1.Draw();
+  Pad2.Draw();
+  /*Pad1.SetBottomMargin(0.1);
+  Pad1.SetTopMargin(0.1);
+  Pad1.SetBorderMode(0);
+  Pad2.SetBorderMode(0);
+  Pad2.SetBottomMargin(0.1);
+  Pad2.SetTopMargin(0.05);*/
+  Pad1.cd();
+  RooPlot *Frame = m_SignalMBC.frame();
+  FormatAxis(Frame->GetXaxis());
+  FormatAxis(Frame->GetYaxis());
+  if(m_Settings.contains("No_x_axis_tick_label") && m_Settings.getB("No_x_axis_tick_label")) {
+    Frame->GetXaxis()->SetLabelSize(0);
+    std::cout << "Removing tick labels\n";
+  }
+  std::string TagMode = m_Settings.get("Mode");
+  TLatex Text;
+  Text.SetTextFont(42);
+  Text.SetTextSize(0.09);
+  Text.SetTextColor(kBlack);
+  Text.SetNDC(true);
+  std::string LabelText = Utilities::GetTagNameLaTeX(TagMode);
+  std::string Title;// = "Double tag fit of ";
+  //Title += Utilities::GetTagNameLaTeX("KKpipi");
+  //Title += " vs ";
+  //Title += Utilities::GetTagNameLaTeX(TagMode);
+  if(SignalBin != 0) {
+    //Title += ", KK#pi#pi bin " + std::to_string(SignalBin);
+    LabelText += ", bin " + std::to_string(SignalBin);
+  /*} else {
+    Title += ", inclusive KK#pi#pi phase space";*/
+  }
+  if(TagMode == "KSpipi" || TagMode == "KSpipiPartReco" || TagMode == "KLpipi" || TagMode == "KSKK" || TagMode == "KLKK" || TagMode == "KKpipi") {
+    //Title += ", tag bin " + std::to_string(TagBin);
+    LabelText = "#splitline{" + LabelText;
+    LabelText += "}{Bin " + std::to_string(TagBin) + "}";
+  }
+  if(TagMode.substr(0, 2) == "KL" || (TagMode.length() > 8 && TagMode.substr(TagMode.length() - 8, TagMode.length()) == "PartReco")) {
+    Title += ";M_{ miss}^{ 2} (GeV^{2}/#it{c}^{4}); Events / ";
+  } else if(TagMode == "KeNu") {
+    Title += ";U_{ miss} (GeV/#it{c}^{2}); Events / ";
+  } else {
+    Title += ";M_{ BC} (GeV/#it{c}^{2}); Events / ";
+  }
+  Text.SetText(0.2, 0.8, LabelText.c_str());
+  if(TagMode.substr(0, 2) == "KL" || (TagMode.length() > 8 && TagMode.substr(TagMode.length() - 8, TagMode.length()) == "PartReco")) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3) << (m_SignalMBC.getMax() - m_SignalMBC.getMin())/m_Settings.getI("Bins_in_plots");
+    Title += ss.str();
+    Title += " GeV^{2}/#it{c}^{4}";
+  } else {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << 1000.0*(m_SignalMBC.getMax() - m_SignalMBC.getMin())/m_Settings.getI("Bins_in_plots");
+    Title += ss.str();
+    Title += " MeV/#it{c}^{2}";
+  }
+  Frame->SetTitle(Title.c_str());
+  RooPlot *Data_RooPlot = CategoryData.plotOn(Frame, Binning(m_Settings.getI("Bins_in_plots")), MarkerSize(3), LineWidth(3));
+  auto Data_RooHist = Data_RooPlot->getHist();
+  // Against my wishes, I had to remove data points of empty bins
+  for(int i = 0; i < Data_RooHist->GetN(); i++) {
+    if(Data_RooHist->GetPointY(i) == 0.0) {
+      Data_RooHist->SetPointY(i, -1000.0);
     }
-    Model->plotOn(Frame, LineColor(kRed), LineWidth(3), Slice(*CategoryVariable, Category.c_str()), ProjWData(*CategoryVariable, *DataSet));
-    RooHist *Pull = Frame->pullHist();
-    if(FitModel->m_PeakingBackgroundShapes.size() > 0) {
-      std::string PeakingList = "Combinatorial*,";
-      for(auto iter = FitModel->m_PeakingBackgroundShapes.begin(); iter != FitModel->m_PeakingBackgroundShapes.end(); iter++) {
-	if(iter != FitModel->m_PeakingBackgroundShapes.begin()) {
-	  PeakingList += std::string(",");
-	}
-	PeakingList += iter->second->GetPDF()->GetName();
+  }
+  FormatData(Data_RooHist);
+  Data_RooHist->SetMinimum(0.0);
+  if(TagMode == "KSpipiPartReco") {
+    Frame->SetNdivisions(-405);
+  }
+  Model->plotOn(Frame, LineColor(kRed), LineWidth(3), Slice(*CategoryVariable, Category.c_str()), ProjWData(*CategoryVariable, CategoryCounts));
+  RooHist *Pull = Frame->pullHist();
+  if(FitModel->m_PeakingBackgroundShapes.size() > 0) {
+    std::string PeakingList = "Combinatorial*,";
+    for(auto iter = FitModel->m_PeakingBackgroundShapes.begin(); iter != FitModel->m_PeakingBackgroundShapes.end(); iter++) {
+      if(iter != FitModel->m_PeakingBackgroundShapes.begin()) {
+	PeakingList += std::string(",");
       }
-      Model->plotOn(Frame, FillStyle(1001), LineColor(kGreen + 2), FillColor(kGreen + 2), LineWidth(3), DrawOption("F"), Slice(*CategoryVariable, Category.c_str()), ProjWData(*CategoryVariable, *DataSet), Components(PeakingList.c_str()));
+      PeakingList += iter->second->GetPDF()->GetName();
     }
-    Model->plotOn(Frame, FillStyle(1001), LineColor(kAzure + 6), FillColor(kAzure + 6), LineWidth(3), DrawOption("F"), Components("Combinatorial*"), LineStyle(kDashed), Slice(*CategoryVariable, Category.c_str()), ProjWData(*CategoryVariable, *DataSet));
-    Data_RooPlot = DataSet->plotOn(Frame, Binning(m_Settings.getI("Bins_in_plots")), MarkerSize(3), LineWidth(3), Cut((std::string(CategoryVariable->GetName()) + "==" + std::string(CategoryVariable->GetName()) + "::" + Category).c_str()));
-    Data_RooHist = Data_RooPlot->getHist();
-    // Against my wishes, I had to remove data points of empty bins
-    for(int i = 0; i < Data_RooHist->GetN(); i++) {
-      if(Data_RooHist->GetPointY(i) == 0.0) {
-	Data_RooHist->SetPointY(i, -1000.0);
-      }
+    Model->plotOn(Frame, FillStyle(1001), LineColor(kGreen + 2), FillColor(kGreen + 2), LineWidth(3), DrawOption("F"), Slice(*CategoryVariable, Category.c_str()), ProjWData(*CategoryVariable, CategoryCounts), Components(PeakingList.c_str()));
+  }
+  Model->plotOn(Frame, FillStyle(1001), LineColor(kAzure + 6), FillColor(kAzure + 6), LineWidth(3), DrawOption("F"), Components("Combinatorial*"), LineStyle(kDashed), Slice(*CategoryVariable, Category.c_str()), ProjWData(*CategoryVariable, CategoryCounts));
+  Data_RooPlot = CategoryData.plotOn(Frame, Binning(m_Settings.getI("Bins_in_plots")), MarkerSize(3), LineWidth(3));
+  Data_RooHist = Data_RooPlot->getHist();
+  // Against my wishes, I had to remove data points of empty bins
+  for(int i = 0; i < Data_RooHist->GetN(); i++) {
+    if(Data_RooHist->GetPointY(i) == 0.0) {
+      Data_RooHist->SetPointY(i, -1000.0);
     }
-    Frame->Draw();
-    //WriteBes3();
-    Text.Draw("SAME");
-    Pad2.cd();
-    RooPlot *PullFrame = m_SignalMBC.frame();
-    PullFrame->addObject(Pull);
-    TLine *Line = new TLine(m_SignalMBC.getMin(), 0.0, m_SignalMBC.getMax(), 0.0);
-    PullFrame->addObject(Line);
-    PullFrame->SetMinimum(-5);
-    PullFrame->SetMaximum(5);
-    PullFrame->SetTitle(";;");
-    /*PullFrame->GetXaxis()->SetLabelFont(0);
-    PullFrame->GetXaxis()->SetLabelSize(0);
-    PullFrame->GetYaxis()->SetLabelFont(62);
-    PullFrame->GetYaxis()->SetLabelSize(0.1);*/
-    PullFrame->Draw();
-    std::string PlotFilename = m_Settings.get("MBCPlotFilenamePrefix") + "_" + Category + ".png";
-    Pad1.SetFrameLineWidth(3);
-    c1.Draw();
-    c1.SaveAs(PlotFilename.c_str());
   }
+  Frame->Draw();
+  //WriteBes3();
+  Text.Draw("SAME");
+  Pad2.cd();
+  RooPlot *PullFrame = m_SignalMBC.frame();
+  PullFrame->addObject(Pull);
+  TLine *Line = new TLine(m_SignalMBC.getMin(), 0.0, m_SignalMBC.getMax(), 0.0);
+  PullFrame->addObject(Line);
+  PullFrame->SetMinimum(-5);
+  PullFrame->SetMaximum(5);
+  PullFrame->SetTitle(";;");
+  /*PullFrame->GetXaxis()->SetLabelFont(0);
+  PullFrame->GetXaxis()->SetLabelSize(0);
+  PullFrame->GetYaxis()->SetLabelFont(62);
+  PullFrame->GetYaxis()->SetLabelSize(0.1);*/
+  PullFrame->Draw();
+  std::string PlotFilename = m_Settings.get("MBCPlotFilenamePrefix") + "_" + Category + ".png";
+  Pad1.SetFrameLineWidth(3);
+  c1.Draw();
+  c1.SaveAs(PlotFilename.c_str());
 }
 
 void DoubleTagYield::SaveSignalYields(const BinnedFitModel &FitModel, RooFitResult *Result, const Category &category) const {
@@ -276,11 +338,16 @@ void DoubleTagYield::SaveSignalYields(const BinnedFitModel &FitModel, RooFitResu
   if(m_Settings.getB("FullyReconstructed")) {
     Outfile << "* These yields are after the sideband has been subtracted off the signal yield\n\n";
   }
+  // Sideband events of all bins are counted in a single pass over the tree
+  std::unique_ptr<TH2D> SidebandCounts;
+  if(m_Settings.getB("FullyReconstructed")) {
+    SidebandCounts = GetSidebandCounts(category);
+  }
   for(const auto & cat : category.GetCategories()) {
     std::string Name = cat + "_SignalYield";
     double Sideband = 0.0;
     if(m_Settings.getB("FullyReconstructed")) {
-      Sideband += GetSidebandYield(category.GetSignalBinNumber(cat), category.GetTagBinNumber(cat));
+      Sideband += GetSidebandYield(category.GetSignalBinNumber(cat), category.GetTagBinNumber(cat), *SidebandCounts);
     }
     auto YieldVariable = static_cast<RooRealVar*>(FitModel.m_Yields.at(Name));
     Outfile << Name << "          " << std::setw(8) << std::right << YieldVariable->getVal() - Sideband << "\n";
@@ -294,15 +361,67 @@ void DoubleTagYield::SaveSignalYields(const BinnedFitModel &FitModel, RooFitResu
   Outfile.close();
 }
 
-double DoubleTagYield::GetSidebandYield(int SignalBin, int TagBin) const {
+void DoubleTagYield::CrossCheckYields(const BinnedFitModel &FitModel, const Category &category) const {
+  if(!m_Settings.contains("CutAndCountCrossCheck") || !m_Settings.getB("CutAndCountCrossCheck") || !m_Settings.getB("FullyReconstructed")) {
+    return;
+  }
+  OldDoubleTagYield CutAndCount(m_Settings, m_Tree);
+  CutAndCount.CalculateBinnedRawYields();
+  if(m_Settings.contains("CutAndCountYieldsFile")) {
+    CutAndCount.SaveYields(m_Settings.get("CutAndCountYieldsFile"));
+  }
+  std::cout << "Cross-check of fitted yields with sideband subtraction in the 2D beam constrained mass plane:\n";
+  auto Flags = std::cout.flags();
+  auto Precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(2);
+  // The fitted yields cover the full fit range, so they are scaled to the signal region used in the cut-and-count
+  const double SignalFraction = FitModel.GetFractionInSignalRegion();
+  for(const auto &cat : category.GetCategories()) {
+    auto FittedYieldVariable = static_cast<RooRealVar*>(FitModel.m_Yields.at(cat + "_SignalYield"));
+    const double FittedYield = SignalFraction*FittedYieldVariable->getVal();
+    const double FittedError = SignalFraction*FittedYieldVariable->getError();
+    auto CountedYield = CutAndCount.GetBinYield(cat);
+    // Both yields are determined from the same events, so the uncertainty of their difference is the quadrature difference of the two uncertainties
+    double Error = TMath::Sqrt(TMath::Abs(CountedYield.second*CountedYield.second - FittedError*FittedError));
+    std::cout << cat << ": fit in signal region " << FittedYield << " +- " << FittedError;
+    std::cout << ", cut-and-count " << CountedYield.first << " +- " << CountedYield.second;
+    std::cout << ", difference " << (Error > 0.0 ? (FittedYield - CountedYield.first)/Error : 0.0) << " sigma\n";
+  }
+  std::cout.flags(Flags);
+  std::cout.precision(Precision);
+  std::cout << "Events outside phase space: " << CutAndCount.GetEventsOutsidePhaseSpace() << "\n";
+  std::cout << "Events outside beam constrained mass regions: " << CutAndCount.GetEventsOutsideMBCSpace() << "\n";
+}
+
+std::unique_ptr<TH2D> DoubleTagYield::GetSidebandCounts(const Category &category) const {
+  int MaxSignalBin = 0, MaxTagBin = 0;
+  for(const auto &Bins : category.GetBinCombinations()) {
+    MaxSignalBin = std::max(MaxSignalBin, std::abs(Bins.first));
+    MaxTagBin = std::max(MaxTagBin, std::abs(Bins.second));
+  }
+  // One bin per integer bin number, events outside the binning end up in the under- and overflow bins
+  std::unique_ptr<TH2D> SidebandCounts(new TH2D("SidebandCounts", "", 2*MaxSignalBin + 1, -MaxSignalBin - 0.5, MaxSignalBin + 0.5, 2*MaxTagBin + 1, -MaxTagBin - 0.5, MaxTagBin + 0.5));
   TCut SidebandCut("TagMBC > 1.84 && TagMBC < 1.85 && SignalMBC > 1.86 && SignalMBC < 1.87");
+  // Inclusive and unbinned tags have a single bin number of zero, and their trees may not have the bin branches
+  std::string SignalBinExpression = MaxSignalBin > 0 ? m_Settings.get("SignalBin_variable") : "0";
+  std::string TagBinExpression = MaxTagBin > 0 ? m_Settings.get("TagBin_variable") : "0";
+  SidebandCounts->SetDirectory(gDirectory);
+  m_Tree->Project("SidebandCounts", (TagBinExpression + ":" + SignalBinExpression).c_str(), SidebandCut);
+  SidebandCounts->SetDirectory(nullptr);
+  return SidebandCounts;
+}
+
+double DoubleTagYield::GetSidebandYield(int SignalBin, int TagBin, const TH2D &SidebandCounts) const {
+  // A bin number of zero means all bins are included
+  int FirstSignalBin = 0, LastSignalBin = SidebandCounts.GetNbinsX() + 1;
   if(SignalBin != 0) {
-    SidebandCut = SidebandCut && TCut(("SignalBin == " + std::to_string(SignalBin)).c_str());
+    FirstSignalBin = LastSignalBin = SidebandCounts.GetXaxis()->FindFixBin(SignalBin);
   }
+  int FirstTagBin = 0, LastTagBin = SidebandCounts.GetNbinsY() + 1;
   if(TagBin != 0) {
-    SidebandCut = SidebandCut && TCut(("TagBin == " + std::to_string(TagBin)).c_str());
+    FirstTagBin = LastTagBin = SidebandCounts.GetYaxis()->FindFixBin(TagBin);
   }
-  return static_cast<double>(m_Tree->GetEntries(SidebandCut));
+  return SidebandCounts.Integral(FirstSignalBin, LastSignalBin, FirstTagBin, LastTagBin);
 }
 
 void DoubleTagYield::sPlotReweight(RooDataSet &Data, BinnedFitModel &FitModel) {
@@ -320,8 +439,8 @@ void DoubleTagYield::sPlotReweight(RooDataSet &Data, BinnedFitModel &FitModel) {
     YieldParameters.add(*YieldParameter);
   }
   RooStats::SPlot("sData", "", Data, FitModel.GetPDF(), YieldParameters);
-  TFile Outfile(m_Settings.get("sPlotFilename").c_str(), "RECREATE");
+  auto Outfile = OutputWriter::OpenFile(m_Settings.get("sPlotFilename"), OutputWriter::Stage::Intermediate);
   auto Tree = RooStats::GetAsTTree(m_Settings.get("TreeName").c_str(), m_Settings.get("TreeName").c_str(), Data);
   Tree->Write();
-  Outfile.Close();
+  Outfile->Close();
 }
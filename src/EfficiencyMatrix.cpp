@@ -0,0 +1,66 @@
+// Martin Duy Tat 19th October 2026
+
+#include<string>
+#include<memory>
+#include<stdexcept>
+#include"TFile.h"
+#include"TMatrixT.h"
+#include"TDecompLU.h"
+#include"TRandom.h"
+#include"EfficiencyMatrix.h"
+
+EfficiencyMatrix::EfficiencyMatrix(const std::string &Filename): m_EffMatrix(LoadMatrix(Filename, "EffMatrix")),
+								 m_EffMatrix_err(LoadMatrix(Filename, "EffMatrix_err", false)),
+								 m_EffMatrixInverse(m_EffMatrix.GetNrows(), m_EffMatrix.GetNcols()) {
+  if(m_EffMatrix.GetNrows() != m_EffMatrix.GetNcols()) {
+    throw std::range_error("Efficiency matrix is not square");
+  }
+  TDecompLU LU(m_EffMatrix);
+  if(!LU.Decompose()) {
+    throw std::runtime_error("Efficiency matrix in " + Filename + " is singular");
+  }
+  LU.Invert(m_EffMatrixInverse);
+}
+
+const TMatrixT<double>& EfficiencyMatrix::GetInverse() const {
+  return m_EffMatrixInverse;
+}
+
+TMatrixT<double> EfficiencyMatrix::GetSmearedInverse() {
+  if(m_EffMatrix_err.GetNrows() != m_EffMatrix.GetNrows() || m_EffMatrix_err.GetNcols() != m_EffMatrix.GetNcols()) {
+    throw std::runtime_error("Efficiency matrix uncertainties are missing, cannot smear efficiency matrix");
+  }
+  // Every element is smeared independently, so the perturbation is full rank and the (small) smeared matrix is decomposed directly
+  TMatrixT<double> SmearedMatrix(m_EffMatrix);
+  for(int i = 0; i < SmearedMatrix.GetNrows(); i++) {
+    for(int j = 0; j < SmearedMatrix.GetNcols(); j++) {
+      SmearedMatrix(i, j) += gRandom->Gaus(0.0, m_EffMatrix_err(i, j));
+    }
+  }
+  TDecompLU SmearedLU(SmearedMatrix);
+  TMatrixT<double> SmearedInverse(SmearedMatrix.GetNrows(), SmearedMatrix.GetNcols());
+  if(!SmearedLU.Decompose()) {
+    throw std::runtime_error("Smeared efficiency matrix is singular");
+  }
+  SmearedLU.Invert(SmearedInverse);
+  return SmearedInverse;
+}
+
+int EfficiencyMatrix::GetNumberBins() const {
+  return m_EffMatrix.GetNrows();
+}
+
+TMatrixT<double> EfficiencyMatrix::LoadMatrix(const std::string &Filename, const std::string &MatrixName, bool Required) {
+  TFile EffMatrixFile(Filename.c_str(), "READ");
+  TMatrixT<double> *Matrix = nullptr;
+  EffMatrixFile.GetObject(MatrixName.c_str(), Matrix);
+  if(!Matrix) {
+    if(!Required) {
+      return TMatrixT<double>();
+    }
+    throw std::runtime_error("Cannot find " + MatrixName + " in " + Filename);
+  }
+  std::unique_ptr<TMatrixT<double>> MatrixPtr(Matrix);
+  EffMatrixFile.Close();
+  return *MatrixPtr;
+}
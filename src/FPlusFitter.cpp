@@ -5,6 +5,10 @@
 #include<fstream>
 #include<utility>
 #include<stdexcept>
+#include<memory>
+#include<vector>
+#include<thread>
+#include<algorithm>
 #include"TString.h"
 #include"TMatrixTSym.h"
 #include"TMatrixT.h"
@@ -21,10 +25,19 @@
 #include"RooDataSet.h"
 #include"RooFitResult.h"
 #include"RooRandom.h"
+#include"RooMinimizer.h"
+#include"RooAbsReal.h"
+#include"ROOT/TProcessExecutor.hxx"
+#include"ROOT/TSeq.hxx"
 #include"Settings.h"
 #include"Unique.h"
+#include"Utilities.h"
 #include"FPlusFitter.h"
 #include"CholeskySmearing.h"
+#include"EfficiencyMatrix.h"
+#include"ToyGenerator.h"
+#include"Instrumentation.h"
+#include"OutputWriter.h"
 
 FPlusFitter::FPlusFitter(const Settings &settings): m_Settings(settings),
 						    m_FPlus_Model(m_Settings["FPlus_TagModes"].getD("KKpipi")),
@@ -68,6 +81,8 @@ void FPlusFitter::InitializeAndFit() {
     DoManyToysOrFits(&Model, RunMode);
   } else if(RunMode == "ManyFits") {
     DoManyToysOrFits(&Model, RunMode);
+  } else if(RunMode == "Scan") {
+    DoScan(&Model);
   }
 }
 
@@ -77,7 +92,10 @@ void FPlusFitter::DoSingleFit(RooMultiVarGaussian *Model) {
   RooDataSet Data("Data", "", m_NormalizedYields);
   Data.add(m_NormalizedYields);
   Data.Print("V");
+  Instrumentation::ScopedTimer Timer("FPlusFitter::SingleFit");
   auto Result = Model->fitTo(Data, RooFit::Save(), RooFit::ExternalConstraints(m_GaussianConstraintPDFs), RooFit::Minos(m_RunMinos));
+  Timer.Stop();
+  Instrumentation::RecordFit("FPlusFit", Result->status(), Result->covQual());
   Result->Print("V");
   SaveFitResults(Result);
 }
@@ -89,9 +107,13 @@ void FPlusFitter::DoSingleToy(RooMultiVarGaussian *Model) {
   RooRandom::randomGenerator()->SetSeed(Seed);
   // Generate dataset
   ResetParameters();
-  RooDataSet *Data = Model->generate(m_NormalizedYields, m_Settings.getI("StatsMultiplier"));
-  Data->Print("V");
-  auto Result = Model->fitTo(*Data, RooFit::Save(), RooFit::ExternalConstraints(m_GaussianConstraintPDFs), RooFit::Minos(m_RunMinos));
+  ToyGenerator Toys(Model->covarianceMatrix(), m_Settings.getI("StatsMultiplier"));
+  Toys.Generate(GetPredictedYields(), 1);
+  std::unique_ptr<RooArgSet> ToyVariables(static_cast<RooArgSet*>(m_NormalizedYields.snapshot()));
+  RooDataSet Data("Data", "", *ToyVariables);
+  Toys.FillDataSet(0, Data, *ToyVariables);
+  Data.Print("V");
+  auto Result = Model->fitTo(Data, RooFit::Save(), RooFit::ExternalConstraints(m_GaussianConstraintPDFs), RooFit::Minos(m_RunMinos));
   Result->Print("V");
   SaveFitResults(Result);
 }
@@ -108,7 +130,7 @@ void FPlusFitter::DoManyToysOrFits(RooMultiVarGaussian *Model, const std::string
     return;
   }
   std::string Filename = m_Settings.get(RunMode + "OutputFilename");
-  TFile OutputFile(Filename.c_str(), "RECREATE");
+  auto OutputFile = OutputWriter::OpenFile(Filename, OutputWriter::Stage::Archival);
   TTree Tree("FPlusTree", "");
   int Status, CovQual;
   double FPlus, FPlus_err, FPlus_pull, Norm_CP, Norm_KSpipi, Norm_KLpipi, Norm_CP_pull, Norm_KSpipi_pull, Norm_KLpipi_pull;
@@ -124,15 +146,27 @@ void FPlusFitter::DoManyToysOrFits(RooMultiVarGaussian *Model, const std::string
   Tree.Branch("KKpipi_BF_KSpipi_pull", &Norm_KSpipi_pull);
   Tree.Branch("KKpipi_BF_KLpipi_pull", &Norm_KLpipi_pull);
   int nToys = m_Settings.getI("NumberRuns");
+  // For toys, generate all datasets in one batch from the model at the initial parameter values
+  std::unique_ptr<ToyGenerator> Toys;
+  std::unique_ptr<RooArgSet> ToyVariables;
+  std::unique_ptr<RooDataSet> ToyData;
+  if(RunMode == "ManyToys") {
+    ResetParameters();
+    Toys = std::unique_ptr<ToyGenerator>(new ToyGenerator(Model->covarianceMatrix(), m_Settings.getI("StatsMultiplier")));
+    Toys->Generate(GetPredictedYields(), nToys);
+    ToyVariables = std::unique_ptr<RooArgSet>(static_cast<RooArgSet*>(m_NormalizedYields.snapshot()));
+    ToyData = std::unique_ptr<RooDataSet>(new RooDataSet("Data", "", *ToyVariables));
+  }
+  Instrumentation::ScopedTimer Timer(RunMode == "ManyToys" ? "FPlusFitter::ManyToys" : "FPlusFitter::ManyFits");
   for(int i = 0; i < nToys; i++) {
     std::cout << "Run number " << i << "\n";
     ResetParameters();
     // Generate or smear dataset
     RooFitResult *Result = nullptr;
     if(RunMode == "ManyToys") {
-      RooDataSet *Data = Model->generate(m_NormalizedYields, m_Settings.getI("StatsMultiplier"));
-      Result = Model->fitTo(*Data, RooFit::Save(), RooFit::ExternalConstraints(m_GaussianConstraintPDFs), RooFit::Minos(m_RunMinos));
-      Data->Print("V");
+      Toys->FillDataSet(i, *ToyData, *ToyVariables);
+      Result = Model->fitTo(*ToyData, RooFit::Save(), RooFit::ExternalConstraints(m_GaussianConstraintPDFs), RooFit::Minos(m_RunMinos));
+      ToyData->Print("V");
     } else {
       ResetMeasurements();
       RooDataSet Data("Data", "", m_NormalizedYields);
@@ -143,6 +177,8 @@ void FPlusFitter::DoManyToysOrFits(RooMultiVarGaussian *Model, const std::string
     Result->Print("V");
     Status = Result->status();
     CovQual = Result->covQual();
+    Instrumentation::RecordFit("FPlusFit", Status, CovQual);
+    Timer.AddEvents();
     FPlus = m_FPlus.getVal();
     FPlus_err = m_FPlus.getError();
     FPlus_pull = (FPlus - m_FPlus_Model)/FPlus_err;
@@ -153,13 +189,178 @@ void FPlusFitter::DoManyToysOrFits(RooMultiVarGaussian *Model, const std::string
     Norm_KSpipi_pull = (Norm_KSpipi - m_KKpipi_BF_PDG)/m_KKpipi_BF_KSpipi.getError();
     Norm_KLpipi_pull = (Norm_KLpipi - m_KKpipi_BF_PDG)/m_KKpipi_BF_KLpipi.getError();
     Tree.Fill();
+    delete Result;
   }
-  OutputFile.cd();
+  OutputFile->cd();
   Tree.Write();
-  OutputFile.Close();
+  OutputFile->Close();
 }
   
 
+void FPlusFitter::DoScan(RooMultiVarGaussian *Model) {
+  std::cout << "Run mode: Likelihood scan\n";
+  RooDataSet Data("Data", "", m_NormalizedYields);
+  Data.add(m_NormalizedYields);
+  std::unique_ptr<RooAbsReal> NLL(Model->createNLL(Data, RooFit::ExternalConstraints(m_GaussianConstraintPDFs)));
+  std::unique_ptr<RooArgSet> Parameters(NLL->getParameters(Data));
+  // Find the scan parameters and set up the grid
+  std::vector<std::string> ScanNames = Utilities::ConvertStringToVector(m_Settings.get("ScanParameters"));
+  if(ScanNames.size() != 1 && ScanNames.size() != 2) {
+    throw std::invalid_argument("Likelihood scan needs one or two scan parameters");
+  }
+  std::vector<RooRealVar*> ScanVars;
+  std::vector<std::vector<double>> ScanValues;
+  for(const auto &Name : ScanNames) {
+    auto ScanVar = dynamic_cast<RooRealVar*>(Parameters->find(Name.c_str()));
+    if(!ScanVar) {
+      throw std::invalid_argument(Name + " is not a parameter of the F+ fit");
+    }
+    ScanVars.push_back(ScanVar);
+    double Low = m_Settings.getD(Name + "_ScanLow");
+    double High = m_Settings.getD(Name + "_ScanHigh");
+    int Points = m_Settings.getI(Name + "_ScanPoints");
+    if(Points < 1) {
+      throw std::invalid_argument("Need at least one scan point for " + Name);
+    }
+    ScanValues.push_back(std::vector<double>());
+    for(int i = 0; i < Points; i++) {
+      ScanValues.back().push_back(Points == 1 ? Low : Low + i*(High - Low)/(Points - 1));
+    }
+  }
+  // Order grid points in a snake pattern so that consecutive points are always neighbours
+  std::vector<std::vector<double>> Grid;
+  if(ScanVars.size() == 1) {
+    for(double x : ScanValues[0]) {
+      Grid.push_back({x});
+    }
+  } else {
+    for(std::size_t i = 0; i < ScanValues[0].size(); i++) {
+      for(std::size_t j = 0; j < ScanValues[1].size(); j++) {
+	std::size_t k = i % 2 == 0 ? j : ScanValues[1].size() - 1 - j;
+	Grid.push_back({ScanValues[0][i], ScanValues[1][k]});
+      }
+    }
+  }
+  // Global fit, which is the reference point of the profile likelihood
+  ResetParameters();
+  auto GlobalFit = MinimizeNLL(NLL.get(), Parameters.get());
+  Instrumentation::RecordFit("FPlusScanGlobalFit", GlobalFit.first, GlobalFit.second);
+  double MinNLL = NLL->getVal();
+  std::unique_ptr<RooArgSet> BestFit(static_cast<RooArgSet*>(Parameters->snapshot()));
+  std::cout << "Global fit status: " << GlobalFit.first << ", minimum NLL: " << MinNLL << "\n";
+  for(auto ScanVar : ScanVars) {
+    std::cout << "Best fit " << ScanVar->GetName() << ": " << ScanVar->getVal() << "\n";
+  }
+  // Each worker takes a contiguous chunk of the grid and warm-starts each fit from the previous grid point
+  std::vector<bool> WasConstant;
+  for(auto ScanVar : ScanVars) {
+    WasConstant.push_back(ScanVar->isConstant());
+    ScanVar->setConstant(true);
+  }
+  int Workers = m_Settings.contains("ScanWorkers") ? m_Settings.getI("ScanWorkers") : static_cast<int>(std::thread::hardware_concurrency());
+  Workers = std::max(1, std::min(Workers, static_cast<int>(Grid.size())));
+  const std::size_t RowSize = ScanVars.size() + 7;
+  auto ScanChunk = [&] (int Chunk) {
+    std::size_t First = Chunk*Grid.size()/Workers;
+    std::size_t Last = (Chunk + 1)*Grid.size()/Workers;
+    std::vector<double> Rows;
+    for(std::size_t i = First; i < Last; i++) {
+      if(i == First) {
+	*Parameters = *BestFit;
+      }
+      for(std::size_t j = 0; j < ScanVars.size(); j++) {
+	ScanVars[j]->setVal(Grid[i][j]);
+      }
+      auto FitStatus = MinimizeNLL(NLL.get(), Parameters.get());
+      if(FitStatus.first != 0 && i != First) {
+	// Warm start failed, try again from the global minimum
+	*Parameters = *BestFit;
+	for(std::size_t j = 0; j < ScanVars.size(); j++) {
+	  ScanVars[j]->setVal(Grid[i][j]);
+	}
+	FitStatus = MinimizeNLL(NLL.get(), Parameters.get());
+      }
+      Rows.insert(Rows.end(), Grid[i].begin(), Grid[i].end());
+      Rows.push_back(NLL->getVal());
+      Rows.push_back(FitStatus.first);
+      Rows.push_back(FitStatus.second);
+      Rows.push_back(m_FPlus.getVal());
+      Rows.push_back(m_KKpipi_BF_CP.getVal());
+      Rows.push_back(m_KKpipi_BF_KSpipi.getVal());
+      Rows.push_back(m_KKpipi_BF_KLpipi.getVal());
+    }
+    return Rows;
+  };
+  std::cout << "Scanning " << Grid.size() << " points with " << Workers << " workers\n";
+  std::vector<std::vector<double>> Results;
+  if(Workers == 1) {
+    Results.push_back(ScanChunk(0));
+  } else {
+    ROOT::TProcessExecutor Executor(Workers);
+    Results = Executor.Map(ScanChunk, ROOT::TSeqI(Workers));
+  }
+  for(std::size_t j = 0; j < ScanVars.size(); j++) {
+    ScanVars[j]->setConstant(WasConstant[j]);
+  }
+  *Parameters = *BestFit;
+  // The workers are separate processes, so the final fit of each scan point is recorded here from the returned statuses
+  for(const auto &Rows : Results) {
+    for(std::size_t i = 0; i + RowSize <= Rows.size(); i += RowSize) {
+      std::size_t k = i + ScanVars.size();
+      Instrumentation::RecordFit("FPlusScanPoint", static_cast<int>(Rows[k + 1]), static_cast<int>(Rows[k + 2]));
+    }
+  }
+  // Save the scan
+  auto OutputFile = OutputWriter::OpenFile(m_Settings.get("ScanOutputFilename"), OutputWriter::Stage::Archival);
+  TTree Tree("FPlusScanTree", "");
+  std::vector<double> ScanPoint(ScanVars.size());
+  double ScanNLL, DeltaNLL, FPlus, Norm_CP, Norm_KSpipi, Norm_KLpipi;
+  int Status, CovQual;
+  for(std::size_t j = 0; j < ScanVars.size(); j++) {
+    Tree.Branch(ScanNames[j].c_str(), &ScanPoint[j]);
+  }
+  Tree.Branch("NLL", &ScanNLL);
+  Tree.Branch("DeltaNLL", &DeltaNLL);
+  Tree.Branch("Status", &Status);
+  Tree.Branch("CovQual", &CovQual);
+  Tree.Branch("FPlus_fit", &FPlus);
+  Tree.Branch("KKpipi_BF_CP_fit", &Norm_CP);
+  Tree.Branch("KKpipi_BF_KSpipi_fit", &Norm_KSpipi);
+  Tree.Branch("KKpipi_BF_KLpipi_fit", &Norm_KLpipi);
+  for(const auto &Rows : Results) {
+    for(std::size_t i = 0; i + RowSize <= Rows.size(); i += RowSize) {
+      std::copy(Rows.begin() + i, Rows.begin() + i + ScanVars.size(), ScanPoint.begin());
+      std::size_t k = i + ScanVars.size();
+      ScanNLL = Rows[k];
+      DeltaNLL = ScanNLL - MinNLL;
+      Status = static_cast<int>(Rows[k + 1]);
+      CovQual = static_cast<int>(Rows[k + 2]);
+      FPlus = Rows[k + 3];
+      Norm_CP = Rows[k + 4];
+      Norm_KSpipi = Rows[k + 5];
+      Norm_KLpipi = Rows[k + 6];
+      Tree.Fill();
+    }
+  }
+  OutputFile->cd();
+  Tree.Write();
+  OutputFile->Close();
+}
+
+std::pair<int, int> FPlusFitter::MinimizeNLL(RooAbsReal *NLL, const RooArgSet *Parameters) const {
+  // If every parameter is fixed there is nothing to minimize
+  std::unique_ptr<RooAbsCollection> FloatingParameters(Parameters->selectByAttrib("Constant", false));
+  if(FloatingParameters->getSize() == 0) {
+    return std::make_pair(0, -1);
+  }
+  RooMinimizer Minimizer(*NLL);
+  Minimizer.setPrintLevel(-1);
+  Minimizer.migrad();
+  Minimizer.hesse();
+  std::unique_ptr<RooFitResult> Result(Minimizer.save());
+  return std::make_pair(Result->status(), Result->covQual());
+}
+
 RooRealVar* FPlusFitter::GetFPlusTag(const std::string &TagMode) {
   double FPlus_Tag = m_Settings["FPlus_TagModes"].getD(TagMode);
   auto Mean = Unique::create<RooRealVar*>((TagMode + "_FPlus_Mean").c_str(), "", FPlus_Tag);
@@ -282,7 +483,7 @@ void FPlusFitter::AddPrediction_KShh(const std::string &TagMode) {
       K0hhParameters.add(m_KKpipi_BF_KLpipi);
       K0hhParameters.add(m_cisi_K0pipi.m_Ki_KLpipi[2*(i - 1)]); // Ki
       K0hhParameters.add(m_cisi_K0pipi.m_Ki_KLpipi[2*(i - 1) + 1]); // Kbari
-      K0hhParameters.add(m_cisi_K0pipi.m_cisi[i - 1 + 16]); // ci
+      K0hhParameters.add(m_cisi_K0pipi.m_cisi[i - 1 + 2*m_cisi_K0pipi.m_NumberBins]); // ci
     } else {
       K0hhParameters.add(m_KKpipi_BF_KSpipi);
       K0hhParameters.add(m_cisi_K0pipi.m_Ki_KSpipi[2*(i - 1)]); // Ki
@@ -336,6 +537,14 @@ void FPlusFitter::ResetParameters() {
   m_KKpipi_BF_KLpipi.setVal(m_KKpipi_BF_PDG);
 }
 
+std::vector<double> FPlusFitter::GetPredictedYields() const {
+  std::vector<double> PredictedYields;
+  for(const auto PredictedYield : m_PredictedYields) {
+    PredictedYields.push_back(static_cast<RooAbsReal*>(PredictedYield)->getVal());
+  }
+  return PredictedYields;
+}
+
 void FPlusFitter::ResetMeasurements() {
   m_NormalizedYields.removeAll();
   m_Uncertainties.clear();
@@ -364,22 +573,15 @@ double FPlusFitter::GetEfficiency(std::string TagMode, const std::string &TagTyp
   return Eff;
 }
 
-TMatrixT<double>* FPlusFitter::GetEfficiencyMatrix(const std::string &TagMode, bool Smearing) const {
-  TFile EffMatrixFile(m_Settings.get(TagMode + "_EfficiencyMatrix").c_str(), "READ");
-  TMatrixT<double> *EffMatrix = nullptr;
-  EffMatrixFile.GetObject("EffMatrix", EffMatrix);
+TMatrixT<double> FPlusFitter::GetEfficiencyMatrix(const std::string &TagMode, bool Smearing) {
+  if(m_EfficiencyMatrices.find(TagMode) == m_EfficiencyMatrices.end()) {
+    m_EfficiencyMatrices.insert({TagMode, EfficiencyMatrix(m_Settings.get(TagMode + "_EfficiencyMatrix"))});
+  }
   if(Smearing && m_Settings.get("Systematics") == "Efficiency") {
-    TMatrixT<double> *EffMatrix_err = nullptr;
-    EffMatrixFile.GetObject("EffMatrix_err", EffMatrix_err);
-    for(int i = 0; i < EffMatrix->GetNrows(); i++) {
-      for(int j = 0; j < EffMatrix->GetNcols(); j++) {
-	(*EffMatrix)(i, j) += gRandom->Gaus(0.0, (*EffMatrix_err)(i, j));
-      }
-    }
+    return m_EfficiencyMatrices.at(TagMode).GetSmearedInverse();
+  } else {
+    return m_EfficiencyMatrices.at(TagMode).GetInverse();
   }
-  EffMatrixFile.Close();
-  EffMatrix->Invert();
-  return EffMatrix;
 }
 
 std::pair<double, double> FPlusFitter::GetTagYield(const std::string &TagMode, const std::string &TagType, bool Smearing) const {
@@ -423,10 +625,10 @@ std::pair<TMatrixT<double>, TMatrixT<double>> FPlusFitter::GetBinnedTagYield(con
   if(Smearing && m_Settings.get("Systematics") == "PeakingBackgrounds") {
     SmearBinnedTagYield(TagMode, DT_Yields);
   }
-  auto EffMatrix = GetEfficiencyMatrix(TagMode, Smearing);
-  TMatrixT<double> DT_Yields_EffCorrected = *EffMatrix*DT_Yields;
+  TMatrixT<double> EffMatrix = GetEfficiencyMatrix(TagMode, Smearing);
+  TMatrixT<double> DT_Yields_EffCorrected = EffMatrix*DT_Yields;
   for(int i = 0; i < Bins; i++) {
-    DT_Yields_err(i, 0) *= (*EffMatrix)(i, i);
+    DT_Yields_err(i, 0) *= EffMatrix(i, i);
   }
   return std::make_pair(DT_Yields_EffCorrected, DT_Yields_err);
 }
@@ -0,0 +1,151 @@
+// Martin Duy Tat 19th October 2026
+
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<vector>
+#include<map>
+#include<memory>
+#include<algorithm>
+#include<stdexcept>
+#include"TChain.h"
+#include"RooRealVar.h"
+#include"RooCategory.h"
+#include"RooDataSet.h"
+#include"RooArgSet.h"
+#include"RooSimultaneous.h"
+#include"RooFitResult.h"
+#include"RooMsgService.h"
+#include"GlobalDoubleTagYield.h"
+#include"DoubleTagYield.h"
+#include"BinnedDataLoader.h"
+#include"BinnedFitModel.h"
+#include"Category.h"
+#include"ParallelNLL.h"
+#include"Settings.h"
+#include"Utilities.h"
+
+GlobalDoubleTagYield::GlobalDoubleTagYield(const Settings &settings): m_Settings(settings),
+								      m_Modes(Utilities::ConvertStringToVector(m_Settings.get("Modes"))),
+								      m_SignalMBC("SignalMBC", "", 1.83, 1.8865) {
+  if(m_Modes.empty()) {
+    throw std::invalid_argument("Global double tag fit needs at least one tag mode");
+  }
+  for(int i = 0; i < 2; i++) {
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Eval);
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Caching);
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Minimization);
+    RooMsgService::instance().getStream(i).removeTopic(RooFit::Plotting);
+  }
+  // All tag modes must share the same fit variable
+  const Settings &FirstMode = m_Settings[m_Modes[0]];
+  for(const auto &Mode : m_Modes) {
+    const Settings &ModeSettings = m_Settings[Mode];
+    if(ModeSettings.get("Mode") != Mode) {
+      throw std::invalid_argument("Subsettings " + Mode + " are for tag mode " + ModeSettings.get("Mode"));
+    }
+    if(ModeSettings.getB("FullyReconstructed") != FirstMode.getB("FullyReconstructed")) {
+      throw std::invalid_argument("Cannot combine fully and partially reconstructed tag modes in a global fit");
+    }
+    if(!ModeSettings.getB("FullyReconstructed")) {
+      if(ModeSettings.get("FitVariable") != FirstMode.get("FitVariable") ||
+	 ModeSettings.getD("FitRange_low") != FirstMode.getD("FitRange_low") ||
+	 ModeSettings.getD("FitRange_high") != FirstMode.getD("FitRange_high")) {
+	throw std::invalid_argument("All tag modes in a global fit must have the same fit variable and fit range");
+      }
+    }
+  }
+  if(!FirstMode.getB("FullyReconstructed")) {
+    m_SignalMBC = RooRealVar(FirstMode.get("FitVariable").c_str(), "", FirstMode.getD("FitRange_low"), FirstMode.getD("FitRange_high"));
+  }
+  m_SignalMBC.setBins(500, "cache");
+  // Shared parameters are filled in by the first fit model that needs them
+  if(m_Settings.contains("SharedParameters")) {
+    for(const auto &Name : Utilities::ConvertStringToVector(m_Settings.get("SharedParameters"))) {
+      m_SharedParameters.insert({Name, nullptr});
+    }
+  }
+}
+
+void GlobalDoubleTagYield::DoFit() {
+  using namespace RooFit;
+  std::vector<std::unique_ptr<TChain>> Chains;
+  std::vector<std::unique_ptr<BinnedDataLoader>> DataLoaders;
+  std::vector<std::unique_ptr<BinnedFitModel>> FitModels;
+  RooCategory GlobalCategory("DoubleTag_Global_Categories", "");
+  std::vector<std::string> Categories;
+  // Set up the dataset and fit model of each tag mode
+  for(const auto &Mode : m_Modes) {
+    std::cout << "Loading " << Mode << " double tags\n";
+    const Settings &ModeSettings = m_Settings[Mode];
+    Chains.emplace_back(new TChain(ModeSettings.get("TreeName").c_str()));
+    std::string Filename = Utilities::ReplaceString(ModeSettings["BinnedDataSets"].get("BinnedDataSet"), "TAG", Mode);
+    Chains.back()->Add(Filename.c_str());
+    DataLoaders.emplace_back(new BinnedDataLoader(ModeSettings, Chains.back().get(), &m_SignalMBC));
+    FitModels.emplace_back(new BinnedFitModel(ModeSettings, &m_SignalMBC, &m_SharedParameters));
+    for(const auto &Category : DataLoaders.back()->GetCategoryObject()->GetCategories()) {
+      GlobalCategory.defineType(Category.c_str());
+      Categories.push_back(Category);
+    }
+  }
+  for(const auto &SharedParameter : m_SharedParameters) {
+    if(!SharedParameter.second) {
+      throw std::invalid_argument("Shared parameter " + SharedParameter.first + " is not a parameter of the fit");
+    }
+  }
+  // Combine the categories of all tag modes into one simultaneous PDF and one dataset
+  RooSimultaneous Model("Simultaneous_PDF_Global", "", GlobalCategory);
+  RooDataSet DataSet("GlobalInputData", "", RooArgSet(m_SignalMBC, GlobalCategory));
+  for(std::size_t i = 0; i < m_Modes.size(); i++) {
+    RooSimultaneous *ModePDF = FitModels[i]->GetPDF();
+    for(const auto &Category : DataLoaders[i]->GetCategoryObject()->GetCategories()) {
+      Model.addPdf(*ModePDF->getPdf(Category.c_str()), Category.c_str());
+    }
+    RooDataSet *ModeDataSet = DataLoaders[i]->GetDataSet();
+    std::string CategoryName = DataLoaders[i]->GetCategoryObject()->GetCategoryVariable()->GetName();
+    for(int j = 0; j < ModeDataSet->numEntries(); j++) {
+      const RooArgSet *Row = ModeDataSet->get(j);
+      m_SignalMBC.setVal(Row->getRealValue(m_SignalMBC.GetName()));
+      GlobalCategory.setLabel(Row->getCatLabel(CategoryName.c_str()));
+      DataSet.add(RooArgSet(m_SignalMBC, GlobalCategory));
+    }
+  }
+  std::cout << "Global fit of " << m_Modes.size() << " tag modes with " << Categories.size() << " categories and " << DataSet.numEntries() << " events\n";
+  // The likelihood is split into chunks of events in each category and shared between all cores
+  int nCPUs = ParallelNLL::GetAvailableCPUs(m_Settings.contains("NumberCPUs") ? m_Settings.getI("NumberCPUs") : 0);
+  int ChunkSize = m_Settings.contains("NLLChunkSize") ? m_Settings.getI("NLLChunkSize") : 0;
+  ParallelNLL NLL("DoubleTag_Global_NLL", Model, DataSet, nCPUs, ChunkSize);
+  auto Result = NLL.Fit(false);
+  // Any bins with less than 0.5 combinatorial background events are set constant
+  for(std::size_t i = 0; i < m_Modes.size(); i++) {
+    for(const auto &Category : DataLoaders[i]->GetCategoryObject()->GetCategories()) {
+      RooRealVar *CombinatorialYield = static_cast<RooRealVar*>(FitModels[i]->m_Yields[Category + "_CombinatorialYield"]);
+      if(CombinatorialYield->getVal() < 0.5) {
+	CombinatorialYield->setConstant();
+      }
+    }
+  }
+  delete Result;
+  Result = NLL.Fit(m_Settings.getB("RunMinos"));
+  Result->Print("V");
+  SaveSharedParameters(Result);
+  // Save the yields and plots of each tag mode in the same format as the single mode fit
+  for(std::size_t i = 0; i < m_Modes.size(); i++) {
+    DoubleTagYield ModeYield(m_Settings[m_Modes[i]], Chains[i].get());
+    ModeYield.PlotProjections(DataLoaders[i].get(), FitModels[i].get());
+    ModeYield.SaveSignalYields(*FitModels[i], Result, *DataLoaders[i]->GetCategoryObject());
+    ModeYield.CrossCheckYields(*FitModels[i], *DataLoaders[i]->GetCategoryObject());
+  }
+}
+
+void GlobalDoubleTagYield::SaveSharedParameters(RooFitResult *Result) const {
+  std::ofstream Outfile(m_Settings.get("FittedSharedParametersFile"));
+  Outfile << "* Global double tag yield fit of " << m_Settings.get("Modes") << "\n\n";
+  Outfile << "status " << Result->status() << "\n";
+  Outfile << "covQual " << Result->covQual() << "\n\n";
+  for(const auto &SharedParameter : m_SharedParameters) {
+    Outfile << "DoubleTag_" << SharedParameter.first << " " << SharedParameter.second->getVal() << "\n";
+    Outfile << "DoubleTag_" << SharedParameter.first << "_err " << SharedParameter.second->getError() << "\n";
+  }
+  Outfile.close();
+}
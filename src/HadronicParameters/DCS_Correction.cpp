@@ -0,0 +1,150 @@
+// Martin Duy Tat 19th October 2026
+
+#include<vector>
+#include<cmath>
+#include<stdexcept>
+#include<algorithm>
+#include<omp.h>
+#include"TMatrixT.h"
+#include"TMath.h"
+#include"TRandom3.h"
+#include"TDecompChol.h"
+#include"HadronicParameters/Ki.h"
+#include"HadronicParameters/cisi.h"
+#include"HadronicParameters/DCS_Parameters.h"
+#include"HadronicParameters/DCS_Correction.h"
+
+DCS_Correction::DCS_Correction(const Ki &Ki_m, const cisi &cisi_m, const DCS_Parameters &DCS, int NumberBins):
+  m_Mean(DCS.GetMean()),
+  m_Covariance(DCS.GetCovariance()) {
+  for(int Bin = -NumberBins; Bin <= NumberBins; Bin++) {
+    if(Bin == 0) {
+      continue;
+    }
+    m_K.push_back(Ki_m.Get_Ki(Bin));
+    m_Kbar.push_back(Ki_m.Get_Ki(-Bin));
+    m_c.push_back(cisi_m.Get_ci(Bin));
+    m_s.push_back(cisi_m.Get_si(Bin));
+  }
+}
+
+std::vector<double> DCS_Correction::GetCorrections() const {
+  std::vector<double> Corrections;
+  Evaluate(m_Mean.data(), Corrections);
+  return Corrections;
+}
+
+void DCS_Correction::Evaluate(const double *Parameters, std::vector<double> &Corrections, std::vector<double> *Jacobian) const {
+  const double rD = Parameters[0];
+  const double R = Parameters[1];
+  const double deltaD = TMath::Pi()*Parameters[2]/180.0;
+  const double cosDelta = std::cos(deltaD);
+  const double sinDelta = std::sin(deltaD);
+  const int Size = m_K.size();
+  Corrections.resize(Size);
+  if(Jacobian) {
+    Jacobian->resize(3*Size);
+  }
+  for(int i = 0; i < Size; i++) {
+    const double K2 = m_K[i]*m_K[i];
+    const double KKbar = m_K[i]*m_Kbar[i];
+    const double X = m_c[i]*cosDelta - m_s[i]*sinDelta;
+    const double Denominator = K2 + rD*rD*m_Kbar[i]*m_Kbar[i] - 2*rD*R*KKbar*X;
+    Corrections[i] = K2/Denominator;
+    if(Jacobian) {
+      // dC/dp = -C/D*dD/dp, with the phase derivative converted back to degrees
+      const double Factor = -Corrections[i]/Denominator;
+      (*Jacobian)[3*i] = Factor*(2*rD*m_Kbar[i]*m_Kbar[i] - 2*R*KKbar*X);
+      (*Jacobian)[3*i + 1] = Factor*(-2*rD*KKbar*X);
+      (*Jacobian)[3*i + 2] = Factor*(2*rD*R*KKbar*(m_c[i]*sinDelta + m_s[i]*cosDelta))*TMath::Pi()/180.0;
+    }
+  }
+}
+
+TMatrixT<double> DCS_Correction::GetLinearCovariance() const {
+  std::vector<double> Corrections, Jacobian;
+  Evaluate(m_Mean.data(), Corrections, &Jacobian);
+  const int Size = Corrections.size();
+  TMatrixT<double> Covariance(Size, Size);
+  for(int i = 0; i < Size; i++) {
+    for(int j = 0; j <= i; j++) {
+      double Sum = 0.0;
+      for(int a = 0; a < 3; a++) {
+	for(int b = 0; b < 3; b++) {
+	  Sum += Jacobian[3*i + a]*m_Covariance[3*a + b]*Jacobian[3*j + b];
+	}
+      }
+      Covariance(i, j) = Covariance(j, i) = Sum;
+    }
+  }
+  return Covariance;
+}
+
+TMatrixT<double> DCS_Correction::GetMonteCarloCovariance(int Samples, unsigned int Seed, int NumberThreads) const {
+  if(Samples < 2) {
+    throw std::invalid_argument("Need at least two samples to estimate the DCS correction covariance");
+  }
+  TMatrixT<double> DCS_Cov(3, 3);
+  for(int a = 0; a < 3; a++) {
+    for(int b = 0; b < 3; b++) {
+      DCS_Cov(a, b) = m_Covariance[3*a + b];
+    }
+  }
+  TDecompChol CholeskyDecomposition(DCS_Cov);
+  if(!CholeskyDecomposition.Decompose()) {
+    throw std::runtime_error("DCS parameter covariance matrix not positive definite");
+  }
+  const TMatrixT<double> &U = CholeskyDecomposition.GetU();
+  const int Size = m_K.size();
+  const std::vector<double> Central = GetCorrections();
+  // Each chunk has its own generator and sums, which are added up in chunk order so the result does not depend on the threads
+  const int ChunkSize = 10000;
+  const int Chunks = (Samples + ChunkSize - 1)/ChunkSize;
+  std::vector<std::vector<double>> ChunkSums(Chunks, std::vector<double>(Size, 0.0));
+  std::vector<std::vector<double>> ChunkProducts(Chunks, std::vector<double>(Size*Size, 0.0));
+  #pragma omp parallel for schedule(dynamic) num_threads(NumberThreads)
+  for(int Chunk = 0; Chunk < Chunks; Chunk++) {
+    TRandom3 Generator(Seed*1000003u + static_cast<unsigned int>(Chunk) + 1u);
+    std::vector<double> Corrections;
+    std::vector<double> &Sums = ChunkSums[Chunk];
+    std::vector<double> &Products = ChunkProducts[Chunk];
+    const int Last = std::min(Samples, (Chunk + 1)*ChunkSize);
+    for(int n = Chunk*ChunkSize; n < Last; n++) {
+      double Normal[3], Parameters[3];
+      for(int a = 0; a < 3; a++) {
+	Normal[a] = Generator.Gaus(0.0, 1.0);
+      }
+      for(int a = 0; a < 3; a++) {
+	Parameters[a] = m_Mean[a];
+	for(int b = 0; b <= a; b++) {
+	  Parameters[a] += U(b, a)*Normal[b];
+	}
+      }
+      Evaluate(Parameters, Corrections);
+      // Accumulate relative to the central corrections for numerical stability
+      for(int i = 0; i < Size; i++) {
+	Corrections[i] -= Central[i];
+	Sums[i] += Corrections[i];
+	for(int j = 0; j <= i; j++) {
+	  Products[i*Size + j] += Corrections[i]*Corrections[j];
+	}
+      }
+    }
+  }
+  std::vector<double> Sums(Size, 0.0), Products(Size*Size, 0.0);
+  for(int Chunk = 0; Chunk < Chunks; Chunk++) {
+    for(int i = 0; i < Size; i++) {
+      Sums[i] += ChunkSums[Chunk][i];
+    }
+    for(int k = 0; k < Size*Size; k++) {
+      Products[k] += ChunkProducts[Chunk][k];
+    }
+  }
+  TMatrixT<double> Covariance(Size, Size);
+  for(int i = 0; i < Size; i++) {
+    for(int j = 0; j <= i; j++) {
+      Covariance(i, j) = Covariance(j, i) = (Products[i*Size + j] - Sums[i]*Sums[j]/Samples)/(Samples - 1);
+    }
+  }
+  return Covariance;
+}
@@ -38,3 +38,11 @@ DCS_Parameters::DCS_Parameters(const Settings &settings): m_DCS(3), m_DCS_Cov(9)
 std::vector<udouble> DCS_Parameters::GetDCSParameters() const {
   return ureals<std::vector<udouble>>(m_DCS, m_DCS_Cov);
 }
+
+const std::vector<double>& DCS_Parameters::GetMean() const {
+  return m_DCS;
+}
+
+const std::vector<double>& DCS_Parameters::GetCovariance() const {
+  return m_DCS_Cov;
+}
@@ -0,0 +1,184 @@
+// Martin Duy Tat 19th October 2026
+
+#include<string>
+#include<map>
+#include<mutex>
+#include<chrono>
+#include<ctime>
+#include<cstdlib>
+#include<cstdio>
+#include<fstream>
+#include<iostream>
+#include<iomanip>
+#include<sys/resource.h>
+#include<unistd.h>
+#include"TFile.h"
+#include"Instrumentation.h"
+
+namespace Instrumentation {
+  namespace Detail {
+    bool g_Enabled = false;
+
+    namespace {
+      /**
+       * Accumulated time of a stage
+       */
+      struct StageSummary {
+	long long Calls = 0;
+	double WallTime = 0.0;
+	double CPUTime = 0.0;
+	long long Events = 0;
+      };
+      /**
+       * Everything recorded so far, in a single struct so that it is only constructed when needed
+       */
+      struct Summary {
+	std::mutex Mutex;
+	std::string Filename;
+	std::string Application;
+	pid_t ProcessID;
+	std::chrono::steady_clock::time_point Start;
+	double CPUStart;
+	std::map<std::string, StageSummary> Stages;
+	std::map<std::string, long long> Counters;
+	std::map<std::string, std::map<std::string, long long>> Fits;
+      };
+      Summary& GetSummary() {
+	static Summary *summary = new Summary;
+	return *summary;
+      }
+      /**
+       * Escape a string for JSON
+       */
+      std::string Escape(const std::string &String) {
+	std::string Escaped;
+	for(char c : String) {
+	  if(c == '"' || c == '\\') {
+	    Escaped += '\\';
+	    Escaped += c;
+	  } else if(static_cast<unsigned char>(c) < 0x20) {
+	    char Buffer[8];
+	    std::snprintf(Buffer, sizeof(Buffer), "\\u%04x", c);
+	    Escaped += Buffer;
+	  } else {
+	    Escaped += c;
+	  }
+	}
+	return Escaped;
+      }
+      void WriteAtExit() {
+	WriteSummary();
+      }
+    }
+
+    void AddStage(const char *Stage, double WallTime, double CPUTime, long long Events) {
+      Summary &summary = GetSummary();
+      std::lock_guard<std::mutex> Lock(summary.Mutex);
+      StageSummary &Entry = summary.Stages[Stage];
+      Entry.Calls++;
+      Entry.WallTime += WallTime;
+      Entry.CPUTime += CPUTime;
+      Entry.Events += Events;
+    }
+
+    void AddCount(const char *Name, long long Count) {
+      Summary &summary = GetSummary();
+      std::lock_guard<std::mutex> Lock(summary.Mutex);
+      summary.Counters[Name] += Count;
+    }
+
+    void AddFit(const char *Name, int Status, int CovQual) {
+      Summary &summary = GetSummary();
+      std::lock_guard<std::mutex> Lock(summary.Mutex);
+      summary.Fits[Name]["Status" + std::to_string(Status) + "_CovQual" + std::to_string(CovQual)]++;
+    }
+
+    double GetCPUTime() {
+      timespec Time;
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &Time);
+      return Time.tv_sec + 1e-9*Time.tv_nsec;
+    }
+  }
+
+  void Enable(const std::string &Filename, const std::string &Application) {
+    Detail::Summary &summary = Detail::GetSummary();
+    {
+      std::lock_guard<std::mutex> Lock(summary.Mutex);
+      summary.Filename = Filename;
+      summary.Application = Application;
+      summary.ProcessID = getpid();
+      summary.Start = std::chrono::steady_clock::now();
+      summary.CPUStart = Detail::GetCPUTime();
+    }
+    if(!Detail::g_Enabled) {
+      Detail::g_Enabled = true;
+      std::atexit(Detail::WriteAtExit);
+    }
+  }
+
+  void WriteSummary() {
+    if(!Detail::g_Enabled) {
+      return;
+    }
+    Detail::Summary &summary = Detail::GetSummary();
+    std::lock_guard<std::mutex> Lock(summary.Mutex);
+    // Forked worker processes inherit the exit handler, but only the main process writes
+    if(summary.ProcessID != getpid()) {
+      return;
+    }
+    double WallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - summary.Start).count();
+    double CPUTime = Detail::GetCPUTime() - summary.CPUStart;
+    rusage Usage;
+    getrusage(RUSAGE_SELF, &Usage);
+    std::ofstream Outfile(summary.Filename);
+    if(!Outfile.is_open()) {
+      std::cout << "WARNING: Cannot write instrumentation summary to " << summary.Filename << "\n";
+      return;
+    }
+    Outfile << std::setprecision(6);
+    Outfile << "{\n";
+    Outfile << "  \"Application\": \"" << Detail::Escape(summary.Application) << "\",\n";
+    Outfile << "  \"WallTime\": " << WallTime << ",\n";
+    Outfile << "  \"CPUTime\": " << CPUTime << ",\n";
+    Outfile << "  \"PeakRSS_kB\": " << Usage.ru_maxrss << ",\n";
+    Outfile << "  \"BytesRead\": " << TFile::GetFileBytesRead() << ",\n";
+    Outfile << "  \"Stages\": {";
+    bool First = true;
+    for(const auto &Stage : summary.Stages) {
+      Outfile << (First ? "\n" : ",\n");
+      First = false;
+      const auto &Entry = Stage.second;
+      Outfile << "    \"" << Detail::Escape(Stage.first) << "\": {";
+      Outfile << "\"Calls\": " << Entry.Calls << ", ";
+      Outfile << "\"WallTime\": " << Entry.WallTime << ", ";
+      Outfile << "\"CPUTime\": " << Entry.CPUTime << ", ";
+      Outfile << "\"Events\": " << Entry.Events << ", ";
+      Outfile << "\"EventsPerSecond\": " << (Entry.WallTime > 0.0 ? Entry.Events/Entry.WallTime : 0.0) << "}";
+    }
+    Outfile << (First ? "},\n" : "\n  },\n");
+    Outfile << "  \"Counters\": {";
+    First = true;
+    for(const auto &Counter : summary.Counters) {
+      Outfile << (First ? "\n" : ",\n");
+      First = false;
+      Outfile << "    \"" << Detail::Escape(Counter.first) << "\": " << Counter.second;
+    }
+    Outfile << (First ? "},\n" : "\n  },\n");
+    Outfile << "  \"Fits\": {";
+    First = true;
+    for(const auto &Fit : summary.Fits) {
+      Outfile << (First ? "\n" : ",\n");
+      First = false;
+      Outfile << "    \"" << Detail::Escape(Fit.first) << "\": {";
+      bool FirstStatus = true;
+      for(const auto &Status : Fit.second) {
+	Outfile << (FirstStatus ? "" : ", ");
+	FirstStatus = false;
+	Outfile << "\"" << Status.first << "\": " << Status.second;
+      }
+      Outfile << "}";
+    }
+    Outfile << (First ? "}\n" : "\n  }\n");
+    Outfile << "}\n";
+  }
+}
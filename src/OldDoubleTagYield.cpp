@@ -1,22 +1,34 @@
 // Martin Duy Tat 28th April 2021
 
+#include<iostream>
+#include<fstream>
+#include<iomanip>
+#include<string>
 #include<vector>
+#include<array>
+#include<utility>
+#include<algorithm>
+#include<cstdlib>
 #include<stdexcept>
-#include<numeric>
 #include"TTree.h"
-#include"TCut.h"
-#include"TEntryList.h"
 #include"TMath.h"
-#include"AmplitudePhaseSpace.h"
-#include"Event.h"
-#include"DoubleTagYield.h"
+#include"OldDoubleTagYield.h"
+#include"Category.h"
+#include"Settings.h"
+#include"Instrumentation.h"
 
-DoubleTagYield::DoubleTagYield(int NBins, TCut Cuts): m_NBins(NBins), m_AmplitudePhaseSpace(AmplitudePhaseSpace(m_NBins)), m_BinYieldS(std::vector<int>(2*m_NBins)), m_BinYieldA(std::vector<int>(2*m_NBins)), m_BinYieldB(std::vector<int>(2*m_NBins)), m_BinYieldC(std::vector<int>(2*m_NBins)), m_BinYieldD(std::vector<int>(2*m_NBins)), m_EventsOutsidePhaseSpace(0), m_EventsOutsideMBCSpace(0), m_Cuts(Cuts) {
-  m_AmplitudePhaseSpace.SetBinEdges(std::vector<double>{1.20923});
-  m_AmplitudePhaseSpace.UseVariableBinWidths(true);
+OldDoubleTagYield::OldDoubleTagYield(const Settings &settings, TTree *Tree): m_Settings(settings),
+									     m_Tree(Tree),
+									     m_Category(m_Settings),
+									     m_BinYields(m_Category.GetCategories().size(), RegionYields{}),
+									     m_EventsOutsidePhaseSpace(0),
+									     m_EventsOutsideMBCSpace(0) {
+  if(!m_Settings.getB("FullyReconstructed")) {
+    throw std::invalid_argument("Sideband subtraction in the beam constrained mass plane is only possible for fully reconstructed tags");
+  }
 }
 
-char DoubleTagYield::DetermineMBCRegion(double SignalMBC, double TagMBC) const {
+char OldDoubleTagYield::DetermineMBCRegion(double SignalMBC, double TagMBC) {
   if(SignalMBC > 1.86 && SignalMBC < 1.87 && TagMBC > 1.86 && TagMBC < 1.87) {
     return 'S';
   } else if(SignalMBC > 1.86 && SignalMBC < 1.87 && TagMBC > 1.83 && TagMBC < 1.855) {
@@ -36,135 +48,141 @@ char DoubleTagYield::DetermineMBCRegion(double SignalMBC, double TagMBC) const {
   }
 }
 
-void DoubleTagYield::SetDaughterBranchAddresses(TTree *Tree, std::vector<double> &Momenta, std::vector<double> &MomentaKalmanFit) const {
-  Momenta = std::vector<double>(16);
-  MomentaKalmanFit = std::vector<double>(16);
-  Tree->SetBranchAddress("SignalKPluspx", Momenta.data() + 0);
-  Tree->SetBranchAddress("SignalKPluspy", Momenta.data() + 1);
-  Tree->SetBranchAddress("SignalKPluspz", Momenta.data() + 2);
-  Tree->SetBranchAddress("SignalKPlusenergy", Momenta.data() + 3);
-  Tree->SetBranchAddress("SignalKMinuspx", Momenta.data() + 4);
-  Tree->SetBranchAddress("SignalKMinuspy", Momenta.data() + 5);
-  Tree->SetBranchAddress("SignalKMinuspz", Momenta.data() + 6);
-  Tree->SetBranchAddress("SignalKMinusenergy", Momenta.data() + 7);
-  Tree->SetBranchAddress("SignalPiPluspx", Momenta.data() + 8);
-  Tree->SetBranchAddress("SignalPiPluspy", Momenta.data() + 9);
-  Tree->SetBranchAddress("SignalPiPluspz", Momenta.data() + 10);
-  Tree->SetBranchAddress("SignalPiPlusenergy", Momenta.data() + 11);
-  Tree->SetBranchAddress("SignalPiMinuspx", Momenta.data() + 12);
-  Tree->SetBranchAddress("SignalPiMinuspy", Momenta.data() + 13);
-  Tree->SetBranchAddress("SignalPiMinuspz", Momenta.data() + 14);
-  Tree->SetBranchAddress("SignalPiMinusenergy", Momenta.data() + 15);
-  Tree->SetBranchAddress("SignalKPluspxKalmanFit", MomentaKalmanFit.data() + 0);
-  Tree->SetBranchAddress("SignalKPluspyKalmanFit", MomentaKalmanFit.data() + 1);
-  Tree->SetBranchAddress("SignalKPluspzKalmanFit", MomentaKalmanFit.data() + 2);
-  Tree->SetBranchAddress("SignalKPlusenergyKalmanFit", MomentaKalmanFit.data() + 3);
-  Tree->SetBranchAddress("SignalKMinuspxKalmanFit", MomentaKalmanFit.data() + 4);
-  Tree->SetBranchAddress("SignalKMinuspyKalmanFit", MomentaKalmanFit.data() + 5);
-  Tree->SetBranchAddress("SignalKMinuspzKalmanFit", MomentaKalmanFit.data() + 6);
-  Tree->SetBranchAddress("SignalKMinusenergyKalmanFit", MomentaKalmanFit.data() + 7);
-  Tree->SetBranchAddress("SignalPiPluspxKalmanFit", MomentaKalmanFit.data() + 8);
-  Tree->SetBranchAddress("SignalPiPluspyKalmanFit", MomentaKalmanFit.data() + 9);
-  Tree->SetBranchAddress("SignalPiPluspzKalmanFit", MomentaKalmanFit.data() + 10);
-  Tree->SetBranchAddress("SignalPiPlusenergyKalmanFit", MomentaKalmanFit.data() + 11);
-  Tree->SetBranchAddress("SignalPiMinuspxKalmanFit", MomentaKalmanFit.data() + 12);
-  Tree->SetBranchAddress("SignalPiMinuspyKalmanFit", MomentaKalmanFit.data() + 13);
-  Tree->SetBranchAddress("SignalPiMinuspzKalmanFit", MomentaKalmanFit.data() + 14);
-  Tree->SetBranchAddress("SignalPiMinusenergyKalmanFit", MomentaKalmanFit.data() + 15);
-}
-
-void DoubleTagYield::CalculateBinnedRawYields(TTree *Tree) {
-  Tree->Draw(">> elist", m_Cuts, "entrylist");
-  TEntryList *elist = (TEntryList*)gDirectory->Get("elist");
-  Tree->SetEntryList(elist);
-  double SignalMBC, TagMBC;
-  int KalmanFitSuccess;
-  Tree->SetBranchAddress("SignalMBC", &SignalMBC);
-  Tree->SetBranchAddress("TagMBC", &TagMBC);
-  Tree->SetBranchAddress("SignalKalmanFitSuccess", &KalmanFitSuccess);
-  std::vector<double> Momenta, MomentaKalmanFit;
-  SetDaughterBranchAddresses(Tree, Momenta, MomentaKalmanFit);
-  for(int i = 0; i < elist->GetN(); i++) {
-    Tree->GetEntry(Tree->GetEntryNumber(i));
-    char Region = DetermineMBCRegion(SignalMBC, TagMBC);
-    if(Region == 'F') {
-      m_EventsOutsideMBCSpace++;
+void OldDoubleTagYield::CalculateBinnedRawYields() {
+  Instrumentation::ScopedTimer Timer("OldDoubleTagYield::CalculateBinnedRawYields");
+  // Dense lookup table from signal and tag bin numbers to the category index
+  const auto BinCombinations = m_Category.GetBinCombinations();
+  int MaxSignalBin = 0, MaxTagBin = 0;
+  for(const auto &Bins : BinCombinations) {
+    MaxSignalBin = std::max(MaxSignalBin, std::abs(Bins.first));
+    MaxTagBin = std::max(MaxTagBin, std::abs(Bins.second));
+  }
+  const int TagBinRange = 2*MaxTagBin + 1;
+  std::vector<int> CategoryLookup((2*MaxSignalBin + 1)*TagBinRange, -1);
+  for(std::size_t i = 0; i < BinCombinations.size(); i++) {
+    CategoryLookup[(BinCombinations[i].first + MaxSignalBin)*TagBinRange + BinCombinations[i].second + MaxTagBin] = i;
+  }
+  // Only the branches needed for counting are read
+  const bool Inclusive = m_Settings.contains("Inclusive_fit") && m_Settings.getB("Inclusive_fit");
+  const bool MassCut = m_Settings.contains("InvariantMassVariable");
+  double SignalMBC, TagMBC, InvariantMass = 0.0;
+  int SignalBin, TagBin;
+  // The tree is shared with the fit, so the status of its branches is saved and restored afterwards
+  std::vector<std::pair<std::string, bool>> BranchStatus;
+  m_Tree->LoadTree(0);
+  if(m_Tree->GetListOfBranches()) {
+    for(auto Branch : *m_Tree->GetListOfBranches()) {
+      BranchStatus.push_back({Branch->GetName(), m_Tree->GetBranchStatus(Branch->GetName())});
+    }
+  }
+  m_Tree->SetBranchStatus("*", 0);
+  for(const auto &Branch : {std::string("SignalMBC"), std::string("TagMBC"), m_Settings.get("SignalBin_variable"), m_Settings.get("TagBin_variable")}) {
+    m_Tree->SetBranchStatus(Branch.c_str(), 1);
+  }
+  m_Tree->SetBranchAddress("SignalMBC", &SignalMBC);
+  m_Tree->SetBranchAddress("TagMBC", &TagMBC);
+  m_Tree->SetBranchAddress(m_Settings.get("SignalBin_variable").c_str(), &SignalBin);
+  m_Tree->SetBranchAddress(m_Settings.get("TagBin_variable").c_str(), &TagBin);
+  double LowMassCut = 0.0, HighMassCut = 0.0;
+  if(MassCut) {
+    m_Tree->SetBranchStatus(m_Settings.get("InvariantMassVariable").c_str(), 1);
+    m_Tree->SetBranchAddress(m_Settings.get("InvariantMassVariable").c_str(), &InvariantMass);
+    LowMassCut = m_Settings.getD("InvariantMassVariable_low");
+    HighMassCut = m_Settings.getD("InvariantMassVariable_high");
+  }
+  // Events are counted while they are read, with regions indexed in the order S, A, B, C, D
+  const std::string RegionNames("SABCD");
+  const Long64_t Entries = m_Tree->GetEntries();
+  int EventsOutsidePhaseSpace = 0, EventsOutsideMBCSpace = 0;
+  for(Long64_t i = 0; i < Entries; i++) {
+    m_Tree->GetEntry(i);
+    if(MassCut && (InvariantMass <= LowMassCut || InvariantMass >= HighMassCut)) {
       continue;
     }
-    int BinNumber = KalmanFitSuccess == 1 ? m_AmplitudePhaseSpace.WhichBin(Event(MomentaKalmanFit)) : m_AmplitudePhaseSpace.WhichBin(Event(Momenta));
-    if(BinNumber == 0) {
-      m_EventsOutsidePhaseSpace++;
+    auto Region = RegionNames.find(DetermineMBCRegion(SignalMBC, TagMBC));
+    if(Region == std::string::npos) {
+      EventsOutsideMBCSpace++;
       continue;
     }
-    if(Region == 'S') {
-      m_BinYieldS[BinIndex(BinNumber)]++;
-    } else if(Region == 'A') {
-      m_BinYieldA[BinIndex(BinNumber)]++;
-    } else if(Region == 'B') {
-      m_BinYieldB[BinIndex(BinNumber)]++;
-    } else if(Region == 'C') {
-      m_BinYieldC[BinIndex(BinNumber)]++;
-    } else if(Region == 'D') {
-      m_BinYieldD[BinIndex(BinNumber)]++;
+    if(Inclusive) {
+      SignalBin = 0;
     }
+    int Index = -1;
+    if(std::abs(SignalBin) <= MaxSignalBin && std::abs(TagBin) <= MaxTagBin) {
+      Index = CategoryLookup[(SignalBin + MaxSignalBin)*TagBinRange + TagBin + MaxTagBin];
+    }
+    if(Index == -1) {
+      EventsOutsidePhaseSpace++;
+      continue;
+    }
+    m_BinYields[Index][Region]++;
+  }
+  m_Tree->ResetBranchAddresses();
+  for(const auto &Status : BranchStatus) {
+    m_Tree->SetBranchStatus(Status.first.c_str(), Status.second);
   }
+  Timer.AddEvents(Entries);
+  m_EventsOutsidePhaseSpace += EventsOutsidePhaseSpace;
+  m_EventsOutsideMBCSpace += EventsOutsideMBCSpace;
 }
 
-double DoubleTagYield::GetBinYield(int i) const {
+std::pair<double, double> OldDoubleTagYield::SubtractSidebands(const RegionYields &Yields) {
   // Area in beam constrained 2D plane
-  double A_S = 10*10;
-  double A_A = 10*25;
-  double A_B = 25*10;
-  double A_C = 25*25 - 21.5*21.5;
-  double A_D = 19.5*19.5;
-  double Background = (A_S/A_D)*m_BinYieldD[BinIndex(i)]
-                    + (A_S/A_A)*(m_BinYieldA[BinIndex(i)] - (A_A/A_D)*m_BinYieldD[BinIndex(i)])
-                    + (A_S/A_B)*(m_BinYieldB[BinIndex(i)] - (A_B/A_D)*m_BinYieldD[BinIndex(i)])
-                    + (A_S/A_C)*(m_BinYieldC[BinIndex(i)] - (A_C/A_D)*m_BinYieldD[BinIndex(i)]);
-  /*  double Background = (A_S/A_D)*m_BinYieldD[BinIndex(i)]
-                    + (A_S/A_A)*(m_BinYieldA[BinIndex(i)] - (A_S/A_A)*m_BinYieldD[BinIndex(i)])
-                    + (A_S/A_B)*(m_BinYieldB[BinIndex(i)] - (A_S/A_B)*m_BinYieldD[BinIndex(i)])
-                    + (A_S/A_C)*(m_BinYieldC[BinIndex(i)] - (A_S/A_C)*m_BinYieldD[BinIndex(i)]);*/
-  return m_BinYieldS[BinIndex(i)] - Background;
+  const double A_S = 10*10;
+  const double A_A = 10*25;
+  const double A_B = 25*10;
+  const double A_C = 25*25 - 21.5*21.5;
+  const double A_D = 19.5*19.5;
+  // The combinatorial background is subtracted from the A, B and C regions before they are scaled to the signal region
+  // Background = (A_S/A_D)*D + (A_S/A_A)*(A - (A_A/A_D)*D) + (A_S/A_B)*(B - (A_B/A_D)*D) + (A_S/A_C)*(C - (A_C/A_D)*D)
+  const std::array<double, 5> Coefficients{1.0, -A_S/A_A, -A_S/A_B, -A_S/A_C, 2.0*A_S/A_D};
+  double Yield = 0.0, Variance = 0.0;
+  for(std::size_t i = 0; i < Coefficients.size(); i++) {
+    Yield += Coefficients[i]*Yields[i];
+    Variance += Coefficients[i]*Coefficients[i]*Yields[i];
+  }
+  return {Yield, TMath::Sqrt(Variance)};
 }
 
-double DoubleTagYield::GetTotalYield() const {
-  // Area in beam constrained 2D plane
-  double A_S = 10*10;
-  double A_A = 10*25;
-  double A_B = 25*10;
-  double A_C = 25*25 - 21.5*21.5;
-  double A_D = 19.5*19.5;
-  double YieldS = std::accumulate(m_BinYieldS.begin(), m_BinYieldS.end(), 0.0);
-  double YieldA = std::accumulate(m_BinYieldA.begin(), m_BinYieldA.end(), 0.0);
-  double YieldB = std::accumulate(m_BinYieldB.begin(), m_BinYieldB.end(), 0.0);
-  double YieldC = std::accumulate(m_BinYieldC.begin(), m_BinYieldC.end(), 0.0);
-  double YieldD = std::accumulate(m_BinYieldD.begin(), m_BinYieldD.end(), 0.0);
-  double Background = (A_S/A_D)*YieldD
-                    + (A_S/A_A)*(YieldA - (A_A/A_D)*YieldD)
-                    + (A_S/A_B)*(YieldB - (A_B/A_D)*YieldD)
-                    + (A_S/A_C)*(YieldC - (A_C/A_D)*YieldD);
-  /*  double Background = (A_S/A_D)*YieldD
-                    + (A_S/A_A)*(YieldA - (A_S/A_A)*YieldD)
-                    + (A_S/A_B)*(YieldB - (A_S/A_B)*YieldD)
-                    + (A_S/A_C)*(YieldC - (A_S/A_C)*YieldD);*/
-  return YieldS - Background;
+std::pair<double, double> OldDoubleTagYield::GetBinYield(const std::string &category) const {
+  int Index = m_Category.GetCategoryIndex(category);
+  if(Index == -1) {
+    throw std::invalid_argument("Category " + category + " does not exist");
+  }
+  return SubtractSidebands(m_BinYields[Index]);
 }
 
-int DoubleTagYield::GetEventsOutsidePhaseSpace() const {
+std::pair<double, double> OldDoubleTagYield::GetTotalYield() const {
+  RegionYields TotalYields{};
+  for(const auto &Yields : m_BinYields) {
+    for(std::size_t i = 0; i < Yields.size(); i++) {
+      TotalYields[i] += Yields[i];
+    }
+  }
+  return SubtractSidebands(TotalYields);
+}
+
+int OldDoubleTagYield::GetEventsOutsidePhaseSpace() const {
   return m_EventsOutsidePhaseSpace;
 }
 
-int DoubleTagYield::GetEventsOutsideMBCSpace() const {
+int OldDoubleTagYield::GetEventsOutsideMBCSpace() const {
   return m_EventsOutsideMBCSpace;
 }
 
-int DoubleTagYield::BinIndex(int i) const {
-  if(i == 0) {
-    throw std::invalid_argument("Bin number 0 given");
-  } else if(i > 0) {
-    return i - 1;
-  } else {
-    return -i - 1 + m_NBins;
+void OldDoubleTagYield::SaveYields(const std::string &Filename) const {
+  std::ofstream Outfile(Filename);
+  Outfile << std::fixed << std::setprecision(4);
+  Outfile << "* KKpipi vs " << m_Settings.get("Mode") << " double tag yields from sideband subtraction in the beam constrained mass plane\n\n";
+  const auto Categories = m_Category.GetCategories();
+  for(std::size_t i = 0; i < Categories.size(); i++) {
+    std::string Name = Categories[i] + "_SignalYield";
+    auto Yield = SubtractSidebands(m_BinYields[i]);
+    Outfile << Name << "     " << std::setw(8) << std::right << Yield.first << "\n";
+    Outfile << Name << "_err " << std::setw(8) << std::right << Yield.second << "\n";
   }
+  auto TotalYield = GetTotalYield();
+  Outfile << "\nTotalSignalYield     " << std::setw(8) << std::right << TotalYield.first << "\n";
+  Outfile << "TotalSignalYield_err " << std::setw(8) << std::right << TotalYield.second << "\n";
+  Outfile.close();
 }
@@ -0,0 +1,112 @@
+// Martin Duy Tat 19th October 2026
+
+#include<string>
+#include<vector>
+#include<memory>
+#include<algorithm>
+#include<stdexcept>
+#include"TFile.h"
+#include"TTree.h"
+#include"TBranch.h"
+#include"TROOT.h"
+#include"Compression.h"
+#include"Settings.h"
+#include"OutputWriter.h"
+
+namespace OutputWriter {
+  namespace {
+    /**
+     * LZ4 at its default level, which decompresses several times faster than ZLIB
+     */
+    int g_IntermediateCompression = ROOT::CompressionSettings(ROOT::RCompressionSetting::EAlgorithm::kLZ4, 4);
+    /**
+     * ZSTD at its default level, which gives smaller files than ZLIB at a similar speed
+     */
+    int g_ArchivalCompression = ROOT::CompressionSettings(ROOT::RCompressionSetting::EAlgorithm::kZSTD, 5);
+    /**
+     * Initial basket size of the hot branches in bytes
+     */
+    int g_HotBasketSize = 256000;
+    /**
+     * Number of threads used for compression, where 0 means all available cores
+     */
+    int g_OutputThreads = 0;
+    /**
+     * Give the hot branches baskets of at least the hot basket size
+     * @param Tree The output tree
+     * @param HotBranches The hot branches, where branches that are not in the tree are ignored
+     */
+    void SetHotBasketSizes(TTree *Tree, const std::vector<std::string> &HotBranches) {
+      for(const auto &HotBranch : HotBranches) {
+	TBranch *Branch = Tree->GetBranch(HotBranch.c_str());
+	if(Branch) {
+	  Branch->SetBasketSize(std::max(Branch->GetBasketSize(), g_HotBasketSize));
+	}
+      }
+    }
+  }
+
+  void Configure(const Settings &settings) {
+    if(settings.contains("IntermediateCompression")) {
+      g_IntermediateCompression = settings.getI("IntermediateCompression");
+    }
+    if(settings.contains("ArchivalCompression")) {
+      g_ArchivalCompression = settings.getI("ArchivalCompression");
+    }
+    if(settings.contains("HotBasketSize")) {
+      g_HotBasketSize = settings.getI("HotBasketSize");
+    }
+    if(settings.contains("OutputThreads")) {
+      g_OutputThreads = settings.getI("OutputThreads");
+    }
+  }
+
+  int GetCompressionSettings(Stage stage) {
+    return stage == Stage::Intermediate ? g_IntermediateCompression : g_ArchivalCompression;
+  }
+
+  std::unique_ptr<TFile> OpenFile(const std::string &Filename, Stage stage) {
+    std::unique_ptr<TFile> File{new TFile(Filename.c_str(), "RECREATE", "", GetCompressionSettings(stage))};
+    if(File->IsZombie()) {
+      throw std::runtime_error("Could not open output file " + Filename);
+    }
+    return File;
+  }
+
+  const std::vector<std::string>& GetHotBranches() {
+    // The fit variables, weights and bins that the fits and efficiencies read from every event
+    static const std::vector<std::string> HotBranches{"MBC", "SignalMBC", "TagMBC", "DeltaE", "SignalDeltaE", "TagDeltaE", "LuminosityWeight", "DataSetType", "iDcyTr", "SignalBin", "TagBin"};
+    return HotBranches;
+  }
+
+  void ConfigureTree(TTree *Tree, const std::vector<std::string> &HotBranches) {
+    TFile *File = Tree->GetCurrentFile();
+    if(!File) {
+      throw std::invalid_argument("Tree " + std::string(Tree->GetName()) + " must be in an output file before it is configured");
+    }
+    const int Compression = File->GetCompressionSettings();
+    for(auto Branch : *Tree->GetListOfBranches()) {
+      static_cast<TBranch*>(Branch)->SetCompressionSettings(Compression);
+    }
+    // Clusters of 30 MB, where ROOT resizes all baskets to fit the first cluster when it is flushed
+    Tree->SetAutoFlush(-30000000);
+    SetHotBasketSizes(Tree, HotBranches);
+    Tree->SetImplicitMT(true);
+  }
+
+  int FillTree(TTree *Tree, const std::vector<std::string> &HotBranches) {
+    // The auto flush setting changes from bytes (negative) to entries (positive) when the first cluster is flushed
+    const bool FirstCluster = Tree->GetAutoFlush() < 0;
+    int Bytes = Tree->Fill();
+    if(FirstCluster && Tree->GetAutoFlush() > 0) {
+      SetHotBasketSizes(Tree, HotBranches);
+    }
+    return Bytes;
+  }
+
+  void EnableParallelCompression() {
+    if(g_OutputThreads != 1 && !ROOT::IsImplicitMTEnabled()) {
+      ROOT::EnableImplicitMT(g_OutputThreads > 0 ? g_OutputThreads : 0);
+    }
+  }
+}
@@ -0,0 +1,347 @@
+// Martin Duy Tat 19th October 2026
+
+#include<vector>
+#include<string>
+#include<map>
+#include<memory>
+#include<algorithm>
+#include<numeric>
+#include<thread>
+#include<cmath>
+#include<stdexcept>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/wait.h>
+#include"TObject.h"
+#include"RooAbsReal.h"
+#include"RooAbsPdf.h"
+#include"RooAbsCategory.h"
+#include"RooRealVar.h"
+#include"RooArgSet.h"
+#include"RooSimultaneous.h"
+#include"RooDataSet.h"
+#include"RooFitResult.h"
+#include"RooMinimizer.h"
+#include"ParallelNLL.h"
+#include"Instrumentation.h"
+
+namespace {
+  /**
+   * Write a whole buffer to a pipe
+   */
+  bool WriteAll(int FileDescriptor, const void *Buffer, std::size_t Size) {
+    const char *Position = static_cast<const char*>(Buffer);
+    while(Size > 0) {
+      ssize_t Written = write(FileDescriptor, Position, Size);
+      if(Written <= 0) {
+	return false;
+      }
+      Position += Written;
+      Size -= Written;
+    }
+    return true;
+  }
+  /**
+   * Read a whole buffer from a pipe
+   */
+  bool ReadAll(int FileDescriptor, void *Buffer, std::size_t Size) {
+    char *Position = static_cast<char*>(Buffer);
+    while(Size > 0) {
+      ssize_t Read = read(FileDescriptor, Position, Size);
+      if(Read <= 0) {
+	return false;
+      }
+      Position += Read;
+      Size -= Read;
+    }
+    return true;
+  }
+  /**
+   * Map anonymous memory that is shared with forked processes
+   */
+  void* MapShared(std::size_t Size) {
+    void *Memory = mmap(nullptr, std::max<std::size_t>(Size, 1), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(Memory == MAP_FAILED) {
+      throw std::runtime_error("Cannot allocate shared memory for parallel likelihood");
+    }
+    return Memory;
+  }
+}
+
+ParallelNLL::ParallelNLL(const char *Name, RooSimultaneous &Model, RooDataSet &Data, int NumberCPUs, int ChunkSize):
+  RooAbsReal(Name, Name),
+  m_Model(&Model),
+  m_Data(&Data),
+  m_ParameterProxy("Parameters", "Parameters", this),
+  m_NumberCPUs(std::max(1, NumberCPUs)),
+  m_ChunkSize(ChunkSize) {
+  Initialize();
+}
+
+ParallelNLL::ParallelNLL(const ParallelNLL &Other, const char *Name):
+  RooAbsReal(Other, Name),
+  m_Model(Other.m_Model),
+  m_Data(Other.m_Data),
+  m_ParameterProxy("Parameters", "Parameters", this),
+  m_NumberCPUs(Other.m_NumberCPUs),
+  m_ChunkSize(Other.m_ChunkSize) {
+  Initialize();
+}
+
+ParallelNLL::~ParallelNLL() {
+  Terminate();
+}
+
+TObject* ParallelNLL::clone(const char *NewName) const {
+  return new ParallelNLL(*this, NewName);
+}
+
+Double_t ParallelNLL::defaultErrorLevel() const {
+  return 0.5;
+}
+
+RooFitResult* ParallelNLL::Fit(bool RunMinos, const std::string &MinimizerType) {
+  RooMinimizer Minimizer(*this);
+  Minimizer.setMinimizerType(MinimizerType.c_str());
+  Minimizer.setStrategy(2);
+  Minimizer.migrad();
+  Minimizer.hesse();
+  if(RunMinos) {
+    Minimizer.minos();
+  }
+  RooFitResult *Result = Minimizer.save();
+  Instrumentation::RecordFit(GetName(), Result->status(), Result->covQual());
+  return Result;
+}
+
+int ParallelNLL::GetNumberCPUs() const {
+  return m_NumberCPUs;
+}
+
+int ParallelNLL::GetNumberWorkItems() const {
+  return static_cast<int>(m_Items.size());
+}
+
+int ParallelNLL::GetAvailableCPUs(int RequestedCPUs) {
+  if(RequestedCPUs > 0) {
+    return RequestedCPUs;
+  }
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+void ParallelNLL::Initialize() {
+  // Parameters are all leaves of the PDF that are not in the dataset
+  std::unique_ptr<RooArgSet> Parameters(m_Model->getParameters(*m_Data));
+  for(auto Parameter : *Parameters) {
+    m_ParameterProxy.add(*Parameter);
+    RooRealVar *RealParameter = dynamic_cast<RooRealVar*>(Parameter);
+    if(RealParameter) {
+      m_Parameters.push_back(RealParameter);
+    }
+  }
+  // Observables are the real leaves of the PDF that are in the dataset
+  std::unique_ptr<RooArgSet> Observables(m_Model->getObservables(*m_Data));
+  for(auto Observable : *Observables) {
+    RooRealVar *RealObservable = dynamic_cast<RooRealVar*>(Observable);
+    if(RealObservable) {
+      m_Observables.push_back(RealObservable);
+      m_NormSet.add(*RealObservable);
+    }
+  }
+  // Split the dataset by category, copying the observables into plain arrays
+  const RooAbsCategory &IndexCategory = m_Model->indexCat();
+  std::map<std::string, int> ComponentIndex;
+  for(const auto &Type : IndexCategory) {
+    RooAbsPdf *PDF = m_Model->getPdf(Type.first.c_str());
+    if(!PDF) {
+      continue;
+    }
+    if(PDF->extendMode() == RooAbsPdf::CanNotBeExtended) {
+      throw std::invalid_argument("Parallel likelihood requires extended PDFs in all categories");
+    }
+    ComponentIndex.insert({Type.first, static_cast<int>(m_ComponentPDFs.size())});
+    m_ComponentPDFs.push_back(PDF);
+  }
+  m_ComponentValues.resize(m_ComponentPDFs.size());
+  m_ComponentWeights.resize(m_ComponentPDFs.size());
+  m_ComponentSumWeights.assign(m_ComponentPDFs.size(), 0.0);
+  for(int i = 0; i < m_Data->numEntries(); i++) {
+    const RooArgSet *Row = m_Data->get(i);
+    auto Component = ComponentIndex.find(Row->getCatLabel(IndexCategory.GetName()));
+    if(Component == ComponentIndex.end()) {
+      continue;
+    }
+    for(const auto Observable : m_Observables) {
+      m_ComponentValues[Component->second].push_back(Row->getRealValue(Observable->GetName()));
+    }
+    m_ComponentWeights[Component->second].push_back(m_Data->weight());
+    m_ComponentSumWeights[Component->second] += m_Data->weight();
+  }
+  // Split each category into chunks, making sure every category has an item with the extended term
+  if(m_ChunkSize <= 0) {
+    m_ChunkSize = std::max(200, m_Data->numEntries()/(4*m_NumberCPUs) + 1);
+  }
+  for(std::size_t Component = 0; Component < m_ComponentPDFs.size(); Component++) {
+    int NumberEvents = static_cast<int>(m_ComponentWeights[Component].size());
+    int First = 0;
+    do {
+      int Last = std::min(First + m_ChunkSize, NumberEvents);
+      m_Items.push_back(WorkItem{static_cast<int>(Component), First, Last, First == 0});
+      First = Last;
+    } while(First < NumberEvents);
+  }
+  // Largest items first so that the small ones fill the gaps at the end
+  std::stable_sort(m_Items.begin(), m_Items.end(), [] (const WorkItem &a, const WorkItem &b) {
+    return a.Last - a.First > b.Last - b.First;
+  });
+  // Never start more processes than there are items
+  m_NumberCPUs = std::min(m_NumberCPUs, static_cast<int>(m_Items.size()));
+  m_Shared = new (MapShared(sizeof(SharedState))) SharedState;
+  m_Shared->NextItem = static_cast<int>(m_Items.size());
+  m_Results = static_cast<double*>(MapShared(m_Items.size()*sizeof(double)));
+  m_Errors = static_cast<int*>(MapShared(m_Items.size()*sizeof(int)));
+  if(pipe(m_DonePipe) != 0) {
+    throw std::runtime_error("Cannot create pipe for parallel likelihood");
+  }
+  for(int i = 1; i < m_NumberCPUs; i++) {
+    int CommandPipe[2];
+    if(pipe(CommandPipe) != 0) {
+      throw std::runtime_error("Cannot create pipe for parallel likelihood");
+    }
+    pid_t Worker = fork();
+    if(Worker < 0) {
+      throw std::runtime_error("Cannot start worker process for parallel likelihood");
+    } else if(Worker == 0) {
+      close(CommandPipe[1]);
+      close(m_DonePipe[0]);
+      for(auto Pipe : m_CommandPipes) {
+	close(Pipe);
+      }
+      RunWorker(CommandPipe[0]);
+    }
+    close(CommandPipe[0]);
+    m_CommandPipes.push_back(CommandPipe[1]);
+    m_Workers.push_back(Worker);
+  }
+}
+
+void ParallelNLL::Terminate() {
+  int Command = 0;
+  for(auto Pipe : m_CommandPipes) {
+    WriteAll(Pipe, &Command, sizeof(int));
+    close(Pipe);
+  }
+  for(auto Worker : m_Workers) {
+    waitpid(Worker, nullptr, 0);
+  }
+  m_CommandPipes.clear();
+  m_Workers.clear();
+  for(auto &Pipe : m_DonePipe) {
+    if(Pipe >= 0) {
+      close(Pipe);
+      Pipe = -1;
+    }
+  }
+  if(m_Shared) {
+    m_Shared->~SharedState();
+    munmap(m_Shared, sizeof(SharedState));
+    munmap(m_Results, std::max<std::size_t>(m_Items.size()*sizeof(double), 1));
+    munmap(m_Errors, std::max<std::size_t>(m_Items.size()*sizeof(int), 1));
+    m_Shared = nullptr;
+  }
+}
+
+Double_t ParallelNLL::evaluate() const {
+  m_Shared->NextItem = 0;
+  if(!m_Workers.empty()) {
+    // Send the command followed by the current value of all parameters
+    std::vector<char> Message(sizeof(int) + m_Parameters.size()*sizeof(double));
+    int Command = 1;
+    std::copy_n(reinterpret_cast<const char*>(&Command), sizeof(int), Message.begin());
+    double *Values = reinterpret_cast<double*>(Message.data() + sizeof(int));
+    for(std::size_t i = 0; i < m_Parameters.size(); i++) {
+      Values[i] = m_Parameters[i]->getVal();
+    }
+    for(auto Pipe : m_CommandPipes) {
+      if(!WriteAll(Pipe, Message.data(), Message.size())) {
+	throw std::runtime_error("Lost contact with parallel likelihood worker");
+      }
+    }
+  }
+  // The main process takes work items as well
+  ProcessItems();
+  Instrumentation::AddCount("LikelihoodEvaluations");
+  for(std::size_t i = 0; i < m_Workers.size(); i++) {
+    char Done;
+    if(!ReadAll(m_DonePipe[0], &Done, 1)) {
+      throw std::runtime_error("Lost contact with parallel likelihood worker");
+    }
+  }
+  double NLL = 0.0;
+  int Errors = 0;
+  for(std::size_t i = 0; i < m_Items.size(); i++) {
+    NLL += m_Results[i];
+    Errors += m_Errors[i];
+  }
+  if(Errors > 0) {
+    logEvalError(("PDF value is zero or negative for " + std::to_string(Errors) + " events").c_str());
+  }
+  return NLL;
+}
+
+void ParallelNLL::ProcessItems() const {
+  const int NumberItems = static_cast<int>(m_Items.size());
+  int Item;
+  while((Item = m_Shared->NextItem.fetch_add(1)) < NumberItems) {
+    m_Results[Item] = EvaluateItem(m_Items[Item], m_Errors[Item]);
+  }
+}
+
+double ParallelNLL::EvaluateItem(const WorkItem &Item, int &Errors) const {
+  RooAbsPdf *PDF = m_ComponentPDFs[Item.Component];
+  const std::vector<double> &Values = m_ComponentValues[Item.Component];
+  const std::vector<double> &Weights = m_ComponentWeights[Item.Component];
+  const std::size_t NumberObservables = m_Observables.size();
+  double NLL = 0.0;
+  Errors = 0;
+  for(int i = Item.First; i < Item.Last; i++) {
+    for(std::size_t j = 0; j < NumberObservables; j++) {
+      m_Observables[j]->setVal(Values[i*NumberObservables + j]);
+    }
+    double Probability = PDF->getVal(&m_NormSet);
+    if(!(Probability > 0.0) || !std::isfinite(Probability)) {
+      Errors++;
+      continue;
+    }
+    NLL -= Weights[i]*std::log(Probability);
+  }
+  if(Item.Extended) {
+    double Expected = PDF->expectedEvents(&m_NormSet);
+    if(Expected > 0.0) {
+      NLL += Expected - m_ComponentSumWeights[Item.Component]*std::log(Expected);
+    } else if(m_ComponentSumWeights[Item.Component] > 0.0) {
+      Errors++;
+    }
+  }
+  return NLL;
+}
+
+void ParallelNLL::RunWorker(int CommandPipe) {
+  std::vector<double> Values(m_Parameters.size());
+  int Command;
+  while(ReadAll(CommandPipe, &Command, sizeof(int)) && Command != 0) {
+    if(!ReadAll(CommandPipe, Values.data(), Values.size()*sizeof(double))) {
+      break;
+    }
+    for(std::size_t i = 0; i < m_Parameters.size(); i++) {
+      m_Parameters[i]->setVal(Values[i]);
+    }
+    ProcessItems();
+    char Done = 1;
+    if(!WriteAll(m_DonePipe[1], &Done, 1)) {
+      break;
+    }
+  }
+  // Skip all destructors and exit handlers, the main process owns everything
+  _exit(0);
+}
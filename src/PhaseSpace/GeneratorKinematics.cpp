@@ -0,0 +1,64 @@
+// Martin Duy Tat 29th November 2021
+
+#include<vector>
+#include<string>
+#include<stdexcept>
+#include"TTree.h"
+#include"TBranch.h"
+#include"PhaseSpace/GeneratorKinematics.h"
+
+void GeneratorKinematics::SetBranchAddresses(TTree *Tree) {
+  m_Tree = Tree;
+  m_LoadedEntry = -1;
+  m_Tree->SetBranchAddress("NumberOfParticles", &NumberParticles);
+  SetArrayAddresses();
+  // The truth branches are the largest in the tree, so only read them when they are needed
+  for(const auto &Name : {"NumberOfParticles", "ParticleIDs", "MotherIndex", "True_Px", "True_Py", "True_Pz", "True_Energy"}) {
+    m_Tree->SetBranchStatus(Name, 0);
+  }
+}
+
+void GeneratorKinematics::SetArrayAddresses() {
+  m_Tree->SetBranchAddress("ParticleIDs", ParticleIDs.data());
+  m_Tree->SetBranchAddress("MotherIndex", MotherIndex.data());
+  m_Tree->SetBranchAddress("True_Px", TruePx.data());
+  m_Tree->SetBranchAddress("True_Py", TruePy.data());
+  m_Tree->SetBranchAddress("True_Pz", TruePz.data());
+  m_Tree->SetBranchAddress("True_Energy", TrueEnergy.data());
+}
+
+void GeneratorKinematics::LoadEntry() {
+  if(!m_Tree) {
+    throw std::logic_error("Generator kinematics are not connected to a TTree");
+  }
+  // For a TChain, the branches belong to the tree of the file currently loaded
+  Long64_t Entry = m_Tree->GetReadEntry();
+  if(Entry < 0 || Entry == m_LoadedEntry) {
+    return;
+  }
+  TTree *CurrentTree = m_Tree->GetTree();
+  Long64_t LocalEntry = CurrentTree->GetReadEntry();
+  auto ReadBranch = [&] (const char *Name) {
+    TBranch *Branch = CurrentTree->GetBranch(Name);
+    if(!Branch || Branch->GetEntry(LocalEntry, 1) < 0) {
+      throw std::runtime_error(std::string("Could not read truth branch ") + Name);
+    }
+  };
+  ReadBranch("NumberOfParticles");
+  if(NumberParticles < 0) {
+    throw std::runtime_error("Negative number of generated particles in entry " + std::to_string(Entry));
+  }
+  if(static_cast<std::vector<int>::size_type>(NumberParticles) > ParticleIDs.size()) {
+    ParticleIDs.resize(NumberParticles);
+    MotherIndex.resize(NumberParticles);
+    TruePx.resize(NumberParticles);
+    TruePy.resize(NumberParticles);
+    TruePz.resize(NumberParticles);
+    TrueEnergy.resize(NumberParticles);
+    SetArrayAddresses();
+  }
+  for(const auto &Name : {"ParticleIDs", "MotherIndex", "True_Px", "True_Py", "True_Pz", "True_Energy"}) {
+    ReadBranch(Name);
+  }
+  m_LoadedEntry = Entry;
+}
@@ -73,13 +73,7 @@ void KKpipi_PhaseSpace::SetBranchAddresses_Rec(TTree *Tree) {
 }
 
 void KKpipi_PhaseSpace::SetBranchAddresses_True(TTree *Tree) {
-  Tree->SetBranchAddress("NumberOfParticles", &m_TrueKinematics.NumberParticles);
-  Tree->SetBranchAddress("ParticleIDs", m_TrueKinematics.ParticleIDs.data());
-  Tree->SetBranchAddress("MotherIndex", m_TrueKinematics.MotherIndex.data());
-  Tree->SetBranchAddress("True_Px", m_TrueKinematics.TruePx.data());
-  Tree->SetBranchAddress("True_Py", m_TrueKinematics.TruePy.data());
-  Tree->SetBranchAddress("True_Pz", m_TrueKinematics.TruePz.data());
-  Tree->SetBranchAddress("True_Energy", m_TrueKinematics.TrueEnergy.data());
+  m_TrueKinematics.SetBranchAddresses(Tree);
 }
   
 int KKpipi_PhaseSpace::KKpipiBin() const {
@@ -87,6 +81,7 @@ int KKpipi_PhaseSpace::KKpipiBin() const {
 }
 
 int KKpipi_PhaseSpace::TrueKKpipiBin() {
+  m_TrueKinematics.LoadEntry();
   if(m_KSKKBinning) {
     FindDIndex();
   }
@@ -135,6 +130,8 @@ int KKpipi_PhaseSpace::TrueKKpipiBin() {
 }
 
 void KKpipi_PhaseSpace::FindDIndex() {
+  // Truth information is only read from the TTree when it's needed
+  m_TrueKinematics.LoadEntry();
   // Copy the particle ID vector with the correct number of particles
   std::vector<int> IDs(m_TrueKinematics.ParticleIDs.begin(), m_TrueKinematics.ParticleIDs.begin() + m_TrueKinematics.NumberParticles);
   // Find the D0
@@ -0,0 +1,163 @@
+// Martin Duy Tat 19th October 2026
+
+#include<vector>
+#include<string>
+#include<cmath>
+#include<algorithm>
+#include<stdexcept>
+#include"TH1D.h"
+#include"ResolutionAccumulator.h"
+
+ResolutionAccumulator::ResolutionAccumulator(int Components, double Range, int GridBins): m_Entries(0.0),
+											   m_Range(Range),
+											   m_GridBins(GridBins),
+											   m_Moments(Components),
+											   m_Grid(Components*(GridBins + 2), 0.0) {
+  if(Components <= 0 || Range <= 0.0 || GridBins <= 0) {
+    throw std::invalid_argument("Resolution accumulator needs a positive number of components, range and grid bins");
+  }
+}
+
+void ResolutionAccumulator::Fill(const std::vector<double> &Values) {
+  if(Values.size() != m_Moments.size()) {
+    throw std::invalid_argument("Expected " + std::to_string(m_Moments.size()) + " resolution components, got " + std::to_string(Values.size()));
+  }
+  m_Entries += 1.0;
+  const double BinWidth = 2.0*m_Range/m_GridBins;
+  for(std::size_t i = 0; i < Values.size(); i++) {
+    // Welford's algorithm for the mean and variance
+    Moments &moments = m_Moments[i];
+    double Delta = Values[i] - moments.Mean;
+    moments.Mean += Delta/m_Entries;
+    moments.M2 += Delta*(Values[i] - moments.Mean);
+    if(m_Entries == 1.0) {
+      moments.Min = moments.Max = Values[i];
+    } else {
+      moments.Min = std::min(moments.Min, Values[i]);
+      moments.Max = std::max(moments.Max, Values[i]);
+    }
+    // Grid bin 0 is underflow and bin GridBins + 1 is overflow
+    double Position = (Values[i] + m_Range)/BinWidth;
+    int GridBin = Position < 0.0 ? 0 : (Position >= m_GridBins ? m_GridBins + 1 : static_cast<int>(Position) + 1);
+    m_Grid[i*(m_GridBins + 2) + GridBin] += 1.0;
+  }
+}
+
+void ResolutionAccumulator::Merge(const ResolutionAccumulator &Other) {
+  if(Other.m_Moments.size() != m_Moments.size() || Other.m_Range != m_Range || Other.m_GridBins != m_GridBins) {
+    throw std::invalid_argument("Cannot merge resolution accumulators with different components or grids");
+  }
+  if(Other.m_Entries == 0.0) {
+    return;
+  }
+  if(m_Entries == 0.0) {
+    *this = Other;
+    return;
+  }
+  // Combine the moments of the two samples (Chan et al.)
+  const double Entries = m_Entries + Other.m_Entries;
+  for(std::size_t i = 0; i < m_Moments.size(); i++) {
+    Moments &moments = m_Moments[i];
+    const Moments &OtherMoments = Other.m_Moments[i];
+    double Delta = OtherMoments.Mean - moments.Mean;
+    moments.Mean += Delta*Other.m_Entries/Entries;
+    moments.M2 += OtherMoments.M2 + Delta*Delta*m_Entries*Other.m_Entries/Entries;
+    moments.Min = std::min(moments.Min, OtherMoments.Min);
+    moments.Max = std::max(moments.Max, OtherMoments.Max);
+  }
+  for(std::size_t i = 0; i < m_Grid.size(); i++) {
+    m_Grid[i] += Other.m_Grid[i];
+  }
+  m_Entries = Entries;
+}
+
+std::vector<double> ResolutionAccumulator::Serialize() const {
+  std::vector<double> Packed{static_cast<double>(m_Moments.size()), m_Range, static_cast<double>(m_GridBins), m_Entries};
+  for(const auto &moments : m_Moments) {
+    Packed.insert(Packed.end(), {moments.Mean, moments.M2, moments.Min, moments.Max});
+  }
+  Packed.insert(Packed.end(), m_Grid.begin(), m_Grid.end());
+  return Packed;
+}
+
+ResolutionAccumulator ResolutionAccumulator::Deserialize(const std::vector<double> &Packed) {
+  if(Packed.size() < 4) {
+    throw std::invalid_argument("Packed resolution accumulator is too short");
+  }
+  ResolutionAccumulator Accumulator(static_cast<int>(Packed[0]), Packed[1], static_cast<int>(Packed[2]));
+  if(Packed.size() != 4 + 4*Accumulator.m_Moments.size() + Accumulator.m_Grid.size()) {
+    throw std::invalid_argument("Packed resolution accumulator has the wrong size");
+  }
+  Accumulator.m_Entries = Packed[3];
+  auto iter = Packed.begin() + 4;
+  for(auto &moments : Accumulator.m_Moments) {
+    moments.Mean = *iter++;
+    moments.M2 = *iter++;
+    moments.Min = *iter++;
+    moments.Max = *iter++;
+  }
+  std::copy(iter, Packed.end(), Accumulator.m_Grid.begin());
+  return Accumulator;
+}
+
+int ResolutionAccumulator::GetNumberComponents() const {
+  return m_Moments.size();
+}
+
+double ResolutionAccumulator::GetEntries() const {
+  return m_Entries;
+}
+
+double ResolutionAccumulator::GetMean(int i) const {
+  return m_Moments.at(i).Mean;
+}
+
+double ResolutionAccumulator::GetStdDev(int i) const {
+  return m_Entries > 0.0 ? std::sqrt(m_Moments.at(i).M2/m_Entries) : 0.0;
+}
+
+double ResolutionAccumulator::GetQuantile(int i, double q) const {
+  const Moments &moments = m_Moments.at(i);
+  if(m_Entries == 0.0) {
+    return 0.0;
+  }
+  const double *Grid = m_Grid.data() + i*(m_GridBins + 2);
+  const double BinWidth = 2.0*m_Range/m_GridBins;
+  const double Target = q*m_Entries;
+  double Cumulative = Grid[0];
+  if(Target <= Cumulative) {
+    return moments.Min;
+  }
+  for(int j = 1; j <= m_GridBins; j++) {
+    if(Cumulative + Grid[j] >= Target) {
+      // Interpolate linearly inside the grid bin, without going outside the observed range
+      double Quantile = -m_Range + (j - 1 + (Target - Cumulative)/Grid[j])*BinWidth;
+      return std::min(std::max(Quantile, moments.Min), moments.Max);
+    }
+    Cumulative += Grid[j];
+  }
+  return moments.Max;
+}
+
+TH1D ResolutionAccumulator::MakeHistogram(int i, const std::string &Name, int Bins) const {
+  double Low = GetQuantile(i, 0.001);
+  double High = GetQuantile(i, 0.999);
+  double Margin = std::max(0.1*(High - Low), 1e-6);
+  TH1D Histogram(Name.c_str(), "", Bins, Low - Margin, High + Margin);
+  // The grid is fine compared with the histogram, so each grid bin is filled at its centre
+  const double *Grid = m_Grid.data() + i*(m_GridBins + 2);
+  const double BinWidth = 2.0*m_Range/m_GridBins;
+  for(int j = 1; j <= m_GridBins; j++) {
+    if(Grid[j] > 0.0) {
+      Histogram.Fill(-m_Range + (j - 0.5)*BinWidth, Grid[j]);
+    }
+  }
+  Histogram.SetBinContent(0, Histogram.GetBinContent(0) + Grid[0]);
+  Histogram.SetBinContent(Bins + 1, Histogram.GetBinContent(Bins + 1) + Grid[m_GridBins + 1]);
+  // The statistics are the exact moments of all events, so that the mean and standard deviation include the tails outside the range
+  const Moments &moments = m_Moments.at(i);
+  double Stats[4] = {m_Entries, m_Entries, m_Entries*moments.Mean, moments.M2 + m_Entries*moments.Mean*moments.Mean};
+  Histogram.PutStats(Stats);
+  Histogram.SetEntries(m_Entries);
+  return Histogram;
+}
@@ -4,7 +4,7 @@
 #include"RooGaussian.h"
 #include"RooAddPdf.h"
 #include"RooArgList.h"
-#include"RooFormulaVar.h"
+#include"RooProduct.h"
 #include"RooShapes/FitShape.h"
 #include"RooShapes/DoubleGaussianRatio_Shape.h"
 #include"Utilities.h"
@@ -19,8 +19,8 @@ void DoubleGaussianRatio_Shape::Initialize() {
   m_Parameters.insert({"sigma", Utilities::load_param(m_Settings, m_Name + "_sigma")});
   m_Parameters.insert({"sigma_f", Utilities::load_param(m_Settings, m_Name + "_sigma_f")});
   m_Parameters.insert({"frac", Utilities::load_param(m_Settings, m_Name + "_frac")});
-  auto mu2 = Unique::create<RooFormulaVar*>(m_Name + "_mu2", "@0*@1", RooArgList(*m_Parameters["mu"], *m_Parameters["mu_f"]));
-  auto sigma2 = Unique::create<RooFormulaVar*>(m_Name + "_sigma2", "@0*@1", RooArgList(*m_Parameters["sigma"], *m_Parameters["sigma_f"]));
+  auto mu2 = Unique::create<RooProduct*>(m_Name + "_mu2", "", RooArgList(*m_Parameters["mu"], *m_Parameters["mu_f"]));
+  auto sigma2 = Unique::create<RooProduct*>(m_Name + "_sigma2", "", RooArgList(*m_Parameters["sigma"], *m_Parameters["sigma_f"]));
   auto Gaussian1 = Unique::create<RooGaussian*>(m_Name + "_Gaussian1", "", *m_x, *m_Parameters["mu"], *m_Parameters["sigma"]);
   auto Gaussian2 = Unique::create<RooGaussian*>(m_Name + "_Gaussian2", "", *m_x, *mu2, *sigma2);
   m_PDF = Unique::create<RooAddPdf*>(m_Name + "_DoubleGaussian", "", *Gaussian1, *Gaussian2, *m_Parameters["frac"]);
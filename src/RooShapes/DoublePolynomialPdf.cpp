@@ -0,0 +1,190 @@
+// Martin Duy Tat 19th October 2026
+
+#include<vector>
+#include<cmath>
+#include<algorithm>
+#include<stdexcept>
+#include"RooAbsPdf.h"
+#include"RooAbsReal.h"
+#include"RooRealProxy.h"
+#include"RooListProxy.h"
+#include"RooArgList.h"
+#include"RooArgSet.h"
+#include"RooShapes/DoublePolynomialPdf.h"
+
+ClassImp(DoublePolynomialPdf)
+
+DoublePolynomialPdf::DoublePolynomialPdf() {
+}
+
+DoublePolynomialPdf::DoublePolynomialPdf(const char *Name, const char *Title, RooAbsReal &x, const RooArgList &LeftCoefficients, const RooArgList &RightFractions):
+  RooAbsPdf(Name, Title),
+  m_x("x", "Observable", this, x),
+  m_LeftCoefficients("LeftCoefficients", "Coefficients for x < 0", this),
+  m_RightFractions("RightFractions", "Coefficient fractions for x >= 0", this) {
+  if(LeftCoefficients.getSize() != RightFractions.getSize()) {
+    throw std::invalid_argument("Double polynomial needs the same number of coefficients on each side");
+  }
+  m_LeftCoefficients.add(LeftCoefficients);
+  m_RightFractions.add(RightFractions);
+}
+
+DoublePolynomialPdf::DoublePolynomialPdf(const DoublePolynomialPdf &Other, const char *Name):
+  RooAbsPdf(Other, Name),
+  m_x("x", this, Other.m_x),
+  m_LeftCoefficients("LeftCoefficients", this, Other.m_LeftCoefficients),
+  m_RightFractions("RightFractions", this, Other.m_RightFractions) {
+}
+
+TObject* DoublePolynomialPdf::clone(const char *NewName) const {
+  return new DoublePolynomialPdf(*this, NewName);
+}
+
+void DoublePolynomialPdf::UpdateCoefficients() const {
+  // The expansion only changes when a coefficient changes, so it is cached between events
+  const int Order = m_LeftCoefficients.getSize();
+  bool Changed = m_CachedParameters.size() != static_cast<std::size_t>(2*Order);
+  if(Changed) {
+    m_CachedParameters.assign(2*Order, 0.0);
+  }
+  for(int j = 0; j < Order; j++) {
+    const double a = static_cast<const RooAbsReal&>(m_LeftCoefficients[j]).getVal();
+    const double f = static_cast<const RooAbsReal&>(m_RightFractions[j]).getVal();
+    if(Changed || m_CachedParameters[2*j] != a || m_CachedParameters[2*j + 1] != f) {
+      m_CachedParameters[2*j] = a;
+      m_CachedParameters[2*j + 1] = f;
+      Changed = true;
+    }
+  }
+  if(!Changed && !m_LeftMonomials.empty()) {
+    return;
+  }
+  m_LeftMonomials.assign(Order + 2, 0.0);
+  m_RightMonomials.assign(Order + 2, 0.0);
+  m_LeftMonomials[0] = m_RightMonomials[0] = 1.0;
+  // Monomial expansion of the basis polynomials x, T2, T3 and T4
+  const std::vector<std::vector<double>> Basis{{0.0, 1.0}, {-1.0, 0.0, 2.0}, {0.0, -3.0, 0.0, 4.0}, {1.0, 0.0, -8.0, 0.0, 8.0}};
+  // The normalisation at zero uses the even-numbered coefficients with alternating signs, the same as the original formula
+  double LeftAtZero = 1.0, RightAtZero = 1.0;
+  for(int j = 0; j < Order; j++) {
+    const double a = m_CachedParameters[2*j];
+    const double fa = a*m_CachedParameters[2*j + 1];
+    if(j < 4) {
+      for(std::size_t k = 0; k < Basis[j].size(); k++) {
+	m_LeftMonomials[k] += a*Basis[j][k];
+	m_RightMonomials[k] += fa*Basis[j][k];
+      }
+    } else {
+      m_LeftMonomials[j + 1] += a;
+      m_RightMonomials[j + 1] += fa;
+    }
+    if(j%2 == 1) {
+      const double Sign = j%4 == 1 ? -1.0 : 1.0;
+      LeftAtZero += Sign*a;
+      RightAtZero += Sign*fa;
+    }
+  }
+  if(Order >= 2) {
+    const double Normalisation = std::abs(LeftAtZero)/std::abs(RightAtZero);
+    for(auto &Coefficient : m_RightMonomials) {
+      Coefficient *= Normalisation;
+    }
+  }
+}
+
+double DoublePolynomialPdf::EvaluatePolynomial(const std::vector<double> &Coefficients, double x) {
+  double Value = 0.0;
+  for(auto iter = Coefficients.rbegin(); iter != Coefficients.rend(); iter++) {
+    Value = Value*x + *iter;
+  }
+  return Value;
+}
+
+std::vector<double> DoublePolynomialPdf::FindRoots(std::vector<double> Coefficients, double Low, double High) {
+  while(!Coefficients.empty() && Coefficients.back() == 0.0) {
+    Coefficients.pop_back();
+  }
+  std::vector<double> Roots;
+  if(Coefficients.size() < 2) {
+    return Roots;
+  }
+  // Between consecutive roots of the derivative the polynomial is monotonic, so each of these intervals has at most one root
+  std::vector<double> Derivative(Coefficients.size() - 1);
+  for(std::size_t k = 1; k < Coefficients.size(); k++) {
+    Derivative[k - 1] = k*Coefficients[k];
+  }
+  std::vector<double> Edges{Low};
+  for(auto CriticalPoint : FindRoots(Derivative, Low, High)) {
+    Edges.push_back(CriticalPoint);
+  }
+  Edges.push_back(High);
+  for(std::size_t i = 0; i + 1 < Edges.size(); i++) {
+    double a = Edges[i], b = Edges[i + 1];
+    double Value_a = EvaluatePolynomial(Coefficients, a);
+    const double Value_b = EvaluatePolynomial(Coefficients, b);
+    if(Value_a*Value_b > 0.0 || b <= a) {
+      continue;
+    }
+    // A root exactly at an edge is found by the bisection converging to that edge
+    for(int j = 0; j < 100 && a < b; j++) {
+      const double Middle = 0.5*(a + b);
+      if(Middle <= a || Middle >= b) {
+	break;
+      }
+      const double Value_Middle = EvaluatePolynomial(Coefficients, Middle);
+      if(Value_a*Value_Middle <= 0.0) {
+	b = Middle;
+      } else {
+	a = Middle;
+	Value_a = Value_Middle;
+      }
+    }
+    const double Root = 0.5*(a + b);
+    if(Roots.empty() || Root > Roots.back()) {
+      Roots.push_back(Root);
+    }
+  }
+  return Roots;
+}
+
+double DoublePolynomialPdf::IntegrateAbsolutePolynomial(const std::vector<double> &Coefficients, double Low, double High) {
+  if(High <= Low) {
+    return 0.0;
+  }
+  // Antiderivative of the polynomial
+  std::vector<double> Primitive(Coefficients.size() + 1, 0.0);
+  for(std::size_t k = 0; k < Coefficients.size(); k++) {
+    Primitive[k + 1] = Coefficients[k]/(k + 1);
+  }
+  // The polynomial has a constant sign between its roots
+  double Integral = 0.0;
+  double Start = Low;
+  for(auto Root : FindRoots(Coefficients, Low, High)) {
+    Integral += std::abs(EvaluatePolynomial(Primitive, Root) - EvaluatePolynomial(Primitive, Start));
+    Start = Root;
+  }
+  Integral += std::abs(EvaluatePolynomial(Primitive, High) - EvaluatePolynomial(Primitive, Start));
+  return Integral;
+}
+
+Double_t DoublePolynomialPdf::evaluate() const {
+  UpdateCoefficients();
+  return m_x < 0.0 ? std::abs(EvaluatePolynomial(m_LeftMonomials, m_x)) : std::abs(EvaluatePolynomial(m_RightMonomials, m_x));
+}
+
+Int_t DoublePolynomialPdf::getAnalyticalIntegral(RooArgSet &AllVars, RooArgSet &AnalVars, const char*) const {
+  if(matchArgs(AllVars, AnalVars, m_x)) {
+    return 1;
+  }
+  return 0;
+}
+
+Double_t DoublePolynomialPdf::analyticalIntegral(Int_t Code, const char *RangeName) const {
+  if(Code != 1) {
+    throw std::invalid_argument("Unknown integration code for double polynomial");
+  }
+  UpdateCoefficients();
+  const double Low = m_x.min(RangeName);
+  const double High = m_x.max(RangeName);
+  return IntegrateAbsolutePolynomial(m_LeftMonomials, Low, std::min(High, 0.0)) + IntegrateAbsolutePolynomial(m_RightMonomials, std::max(Low, 0.0), High);
+}
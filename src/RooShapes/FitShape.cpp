@@ -3,8 +3,8 @@
 #include<string>
 #include"RooAbsPdf.h"
 #include"RooRealVar.h"
-#include"RooFormulaVar.h"
-#include"RooArgSet.h"
+#include"RooProduct.h"
+#include"RooArgList.h"
 #include"Settings.h"
 #include"Utilities.h"
 #include"Unique.h"
@@ -43,5 +43,5 @@ void FitShape::UseRelativeYield(RooRealVar *SignalYield, double BackgroundToSign
     delete m_Yield;
   }
   auto BkgToSigRatioVar = Unique::create<RooRealVar*>(m_Name + "_BackgroundToSignalYieldRatio", "", BackgroundToSignalYieldRatio);
-  m_Yield = Unique::create<RooFormulaVar*>(m_Name + "_yield", "@0*@1", RooArgSet(*SignalYield, *BkgToSigRatioVar));
+  m_Yield = Unique::create<RooProduct*>(m_Name + "_yield", "", RooArgList(*SignalYield, *BkgToSigRatioVar));
 }
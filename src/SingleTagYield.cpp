@@ -20,6 +20,7 @@
 #include"RooRealVar.h"
 #include"RooDataSet.h"
 #include"RooDataHist.h"
+#include"RooAbsData.h"
 #include"RooArgList.h"
 #include"RooArgSet.h"
 #include"RooKeysPdf.h"
@@ -37,6 +38,7 @@
 #include"Unique.h"
 #include"Utilities.h"
 #include"Bes3plotstyle.h"
+#include"OutputWriter.h"
 #include"RooShapes/FitShape.h"
 #include"RooShapes/DoubleGaussian_Shape.h"
 #include"RooShapes/DoubleCrystalBall_Shape.h"
@@ -145,33 +147,31 @@ void SingleTagYield::InitializeFitShape() {
 
 void SingleTagYield::FitYield() {
   using namespace RooFit;
-  RooArgList Variables(m_MBC, m_LuminosityWeight);
-  std::string MassCut(""), MassCutBinned("");
-  std::unique_ptr<RooRealVar> InvMassVar;
   if(m_Settings.contains("InvariantMassVariable")) {
     std::string MassVarName = m_Settings.get("InvariantMassVariable");
     m_DataTree->SetBranchStatus(MassVarName.c_str(), 1);
     double LowMassCut = m_Settings.getD("InvariantMassVariable_low");
     double HighMassCut = m_Settings.getD("InvariantMassVariable_high");
-    InvMassVar = std::unique_ptr<RooRealVar>(new RooRealVar(MassVarName.c_str(), "", LowMassCut, HighMassCut));
-    MassCut = MassVarName + " > " + std::to_string(LowMassCut) + " && " + MassVarName + " < " + std::to_string(HighMassCut);
-    MassCutBinned = MassCut + "*LuminosityWeight";
-    Variables.add(*InvMassVar);
+    m_InvMassVar = std::unique_ptr<RooRealVar>(new RooRealVar(MassVarName.c_str(), "", LowMassCut, HighMassCut));
   }
+  // Read the data once, and only keep the events in memory if an unbinned dataset is needed
+  bool UnbinnedFit = m_Settings.get("FitType") == "UnbinnedFit";
+  bool sPlot = m_Settings.contains("sPlotReweight") && m_Settings.getB("sPlotReweight");
   TH1D h1("h1", "h1", m_Settings.getI("Bins_in_fit"), 1.83, 1.8865);
-  m_DataTree->Draw("MBC >> h1", MassCutBinned.c_str(), "goff");
+  TH1D h_Plot("h_Plot", "h_Plot", 200, 1.83, 1.8865);
+  ReadData(h1, h_Plot, UnbinnedFit || sPlot);
   RooDataHist BinnedData("BinnedData", "BinnedData", RooArgList(m_MBC), &h1);
-  RooDataSet Data("Data", "Data", m_DataTree, Variables, MassCut.c_str(), "LuminosityWeight");
+  RooDataHist PlotData("PlotData", "PlotData", RooArgList(m_MBC), &h_Plot);
   RooArgSet *Parameters = m_FullModel->getParameters(m_MBC);
   m_InitialParameters = Parameters->snapshot();
   if(m_Settings.get("FitType") != "NoFit") {
     m_Result = m_FullModel->fitTo(BinnedData, Save(), Strategy(2));
-    if(m_Settings.get("FitType") == "UnbinnedFit") {
-      m_Result = m_FullModel->fitTo(Data, Save(), Strategy(2), NumCPU(4));
+    if(UnbinnedFit) {
+      m_Result = m_FullModel->fitTo(*GetUnbinnedData(), Save(), Strategy(2), NumCPU(4));
     }
     SaveFitParameters();
   }
-  PlotSingleTagYield(Data);
+  PlotSingleTagYield(PlotData);
   if(m_Settings.getB("YieldSystematics")) {
     double SystError;
     int PeakingBackgrounds = m_Settings["MBC_Shape"].getI(m_Settings.get("Mode") + "_PeakingBackgrounds");
@@ -195,12 +195,70 @@ void SingleTagYield::FitYield() {
     OutputFile << YieldName << "_syst_err " << SystError << "\n";
     OutputFile.close();
   }
-  if(m_Settings.contains("sPlotReweight") && m_Settings.getB("sPlotReweight")) {
-    sPlotReweight(Data);
+  if(sPlot) {
+    sPlotReweight(*GetUnbinnedData());
   }
 }
 
-void SingleTagYield::PlotSingleTagYield(const RooDataSet &Data) const {
+void SingleTagYield::ReadData(TH1D &FitHistogram, TH1D &PlotHistogram, bool KeepEvents) {
+  double MBC, LuminosityWeight, InvMass = 0.0;
+  m_DataTree->SetBranchAddress("MBC", &MBC);
+  m_DataTree->SetBranchAddress("LuminosityWeight", &LuminosityWeight);
+  if(m_InvMassVar) {
+    m_DataTree->SetBranchAddress(m_InvMassVar->GetName(), &InvMass);
+  }
+  PlotHistogram.Sumw2();
+  m_MBCColumn.clear();
+  m_WeightColumn.clear();
+  m_InvMassColumn.clear();
+  Long64_t Entries = m_DataTree->GetEntries();
+  for(Long64_t i = 0; i < Entries; i++) {
+    m_DataTree->GetEntry(i);
+    if(m_InvMassVar && !(InvMass > m_InvMassVar->getMin() && InvMass < m_InvMassVar->getMax())) {
+      continue;
+    }
+    // The fit histogram is only weighted when there is an invariant mass cut, as it always has been
+    FitHistogram.Fill(MBC, m_InvMassVar ? LuminosityWeight : 1.0);
+    // Same selection as importing the tree into an unbinned dataset, where events outside the variable ranges are dropped
+    if(!m_MBC.inRange(MBC, nullptr) || !m_LuminosityWeight.inRange(LuminosityWeight, nullptr)) {
+      continue;
+    }
+    PlotHistogram.Fill(MBC, LuminosityWeight);
+    if(KeepEvents) {
+      m_MBCColumn.push_back(static_cast<float>(MBC));
+      m_WeightColumn.push_back(static_cast<float>(LuminosityWeight));
+      if(m_InvMassVar) {
+	m_InvMassColumn.push_back(static_cast<float>(InvMass));
+      }
+    }
+  }
+  m_DataTree->ResetBranchAddresses();
+}
+
+RooDataSet* SingleTagYield::GetUnbinnedData() {
+  using namespace RooFit;
+  if(!m_UnbinnedData) {
+    RooArgSet Variables(m_MBC, m_LuminosityWeight);
+    if(m_InvMassVar) {
+      Variables.add(*m_InvMassVar);
+    }
+    m_UnbinnedData = std::unique_ptr<RooDataSet>(new RooDataSet("Data", "Data", Variables, WeightVar(m_LuminosityWeight)));
+    for(std::size_t i = 0; i < m_MBCColumn.size(); i++) {
+      m_MBC.setVal(m_MBCColumn[i]);
+      if(m_InvMassVar) {
+	m_InvMassVar->setVal(m_InvMassColumn[i]);
+      }
+      m_UnbinnedData->add(Variables, m_WeightColumn[i]);
+    }
+    // The column store is not needed any more once the dataset exists
+    std::vector<float>().swap(m_MBCColumn);
+    std::vector<float>().swap(m_WeightColumn);
+    std::vector<float>().swap(m_InvMassColumn);
+  }
+  return m_UnbinnedData.get();
+}
+
+void SingleTagYield::PlotSingleTagYield(const RooAbsData &Data) const {
   using namespace RooFit;
   SetStyle();
   SetPrelimStyle();
@@ -305,10 +363,10 @@ void SingleTagYield::sPlotReweight(RooDataSet &Data) {
     }
   }
   RooStats::SPlot("sData", "", Data, m_FullModel, sPlotYields);
-  TFile Outfile(m_Settings.get("sPlotFilename").c_str(), "RECREATE");
+  auto Outfile = OutputWriter::OpenFile(m_Settings.get("sPlotFilename"), OutputWriter::Stage::Intermediate);
   auto Tree = RooStats::GetAsTTree(m_Settings.get("TreeName").c_str(), m_Settings.get("TreeName").c_str(), Data);
   Tree->Write();
-  Outfile.Close();
+  Outfile->Close();
 }
 
 void SingleTagYield::SmearArgusEndPoint() {
@@ -8,11 +8,14 @@
 #include<cctype>
 #include<tuple>
 #include<utility>
+#include<memory>
+#include<unordered_map>
 #include"TFile.h"
 #include"TTree.h"
 #include"TopoAnaReader.h"
+#include"OutputWriter.h"
 
-TopoAnaReader::TopoAnaReader(const std::string &Filename) {
+TopoAnaReader::TopoAnaReader(const std::string &Filename): m_MaxDescriptorLength(0) {
   std::ifstream Infile(Filename);
   std::string line;
   m_OtherComponent.first = "Other";
@@ -26,6 +29,9 @@ TopoAnaReader::TopoAnaReader(const std::string &Filename) {
 	continue;
       }
       DecayDescriptor = DecayDescriptor.substr(0, DecayEndPosition);
+      // If the same descriptor appears twice, the first component takes priority
+      m_DescriptorLookup.insert({DecayDescriptor, static_cast<int>(m_DecayComponents.size())});
+      m_MaxDescriptorLength = std::max(m_MaxDescriptorLength, DecayDescriptor.size());
       m_DecayComponents.push_back(std::make_tuple(ComponentLabel, DecayDescriptor, std::vector<int>()));
     } else {
       std::string::iterator EndPosition = std::remove(line.begin(), line.end(), ' ');
@@ -55,21 +61,45 @@ void TopoAnaReader::AnalyzeComponents(const std::string &Filename) {
     std::getline(Infile, line);
     std::getline(Infile, D0Decay);
     std::getline(Infile, D0barDecay);
-    bool FoundDecay = false;
-    for(auto DecayComponent_iter = m_DecayComponents.begin(); DecayComponent_iter != m_DecayComponents.end(); DecayComponent_iter++) {
-      std::string DecayDescriptor = std::get<1>(*DecayComponent_iter);
-      std::string::size_type FoundD0Decay = D0Decay.find(DecayDescriptor + "  &");
-      std::string::size_type FoundD0barDecay = D0barDecay.find(DecayDescriptor + "  &");
-      if(FoundD0Decay != std::string::npos || FoundD0barDecay != std::string::npos) {
-	std::get<2>(*DecayComponent_iter).push_back(DecayTopology);
-	FoundDecay = true;
-	break;
-      }
-    }
-    if(!FoundDecay) {
+    int Component = std::min(FindComponent(D0Decay), FindComponent(D0barDecay));
+    if(Component < static_cast<int>(m_DecayComponents.size())) {
+      std::get<2>(m_DecayComponents[Component]).push_back(DecayTopology);
+    } else {
       m_OtherComponent.second.push_back(DecayTopology);
     }
+    SetTopologyComponent(DecayTopology, Component);
+  }
+}
+
+int TopoAnaReader::FindComponent(const std::string &Decay) const {
+  int Component = m_DecayComponents.size();
+  if(m_DescriptorLookup.empty()) {
+    return Component;
+  }
+  std::string::size_type SeparatorPosition = Decay.find("  &");
+  while(SeparatorPosition != std::string::npos) {
+    // Try every substring that ends just before "  &" and is not longer than the longest descriptor
+    // This matches the same descriptors as searching for each descriptor followed by "  &", even if they span several "  &" or start inside a particle name
+    std::string::size_type FirstStart = SeparatorPosition > m_MaxDescriptorLength ? SeparatorPosition - m_MaxDescriptorLength : 0;
+    for(std::string::size_type Start = FirstStart; Start <= SeparatorPosition; Start++) {
+      auto iter = m_DescriptorLookup.find(Decay.substr(Start, SeparatorPosition - Start));
+      if(iter != m_DescriptorLookup.end()) {
+	Component = std::min(Component, iter->second);
+      }
+    }
+    SeparatorPosition = Decay.find("  &", SeparatorPosition + 1);
+  }
+  return Component;
+}
+
+void TopoAnaReader::SetTopologyComponent(int DecayTopology, int Component) {
+  if(DecayTopology < 0) {
+    return;
+  }
+  if(DecayTopology >= static_cast<int>(m_TopologyComponent.size())) {
+    m_TopologyComponent.resize(DecayTopology + 1, -1);
   }
+  m_TopologyComponent[DecayTopology] = Component;
 }
 
 void TopoAnaReader::SaveAllComponentCuts() const {
@@ -89,29 +119,45 @@ void TopoAnaReader::SaveComponentCuts(const std::string &Label, const std::vecto
   }
 }
 
-void TopoAnaReader::SaveTree(TTree *InTree, const std::string &Label, const std::vector<int> &DecayTopologies) const {
-  TFile OutputFile((Label + std::string(".root")).c_str(), "RECREATE");
-  TTree *Tree = InTree->CloneTree(0);
+void TopoAnaReader::SaveAllTrees(TTree *InTree) const {
+  // One output file and tree per component with at least one topology, where the last one is "Other"
+  std::vector<std::pair<std::string, bool>> Components;
+  for(const auto &DecayComponent : m_DecayComponents) {
+    Components.push_back({std::get<0>(DecayComponent), !std::get<2>(DecayComponent).empty()});
+  }
+  Components.push_back({m_OtherComponent.first, !m_OtherComponent.second.empty()});
+  std::vector<std::unique_ptr<TFile>> OutputFiles(Components.size());
+  std::vector<TTree*> OutputTrees(Components.size(), nullptr);
+  for(std::size_t i = 0; i < Components.size(); i++) {
+    if(Components[i].second) {
+      OutputFiles[i] = OutputWriter::OpenFile(Components[i].first + std::string(".root"), OutputWriter::Stage::Intermediate);
+      OutputTrees[i] = InTree->CloneTree(0);
+      OutputTrees[i]->SetDirectory(OutputFiles[i].get());
+      OutputWriter::ConfigureTree(OutputTrees[i]);
+    }
+  }
   int iDcyTr;
   InTree->SetBranchAddress("iDcyTr", &iDcyTr);
-  for(int i = 0; i < InTree->GetEntries(); i++) {
-    InTree->GetEntry(i);
-    if(std::find(DecayTopologies.begin(), DecayTopologies.end(), iDcyTr) != DecayTopologies.end()) {
-      Tree->Fill();
+  Long64_t Entries = InTree->GetEntries();
+  for(Long64_t i = 0; i < Entries; i++) {
+    // Read the topology number first, and only read the whole event if it belongs to a component
+    Long64_t LocalEntry = InTree->LoadTree(i);
+    if(LocalEntry < 0) {
+      break;
     }
-  }
-  Tree->Write();
-  OutputFile.Close();
-}
-    
-
-void TopoAnaReader::SaveAllTrees(TTree *InTree) const {
-  for(auto iter = m_DecayComponents.begin(); iter != m_DecayComponents.end(); iter++) {
-    if(std::get<2>(*iter).size() != 0) {
-      SaveTree(InTree, std::get<0>(*iter), std::get<2>(*iter));
+    InTree->GetTree()->GetBranch("iDcyTr")->GetEntry(LocalEntry);
+    if(iDcyTr < 0 || iDcyTr >= static_cast<int>(m_TopologyComponent.size()) || m_TopologyComponent[iDcyTr] < 0) {
+      continue;
     }
+    InTree->GetEntry(i);
+    OutputWriter::FillTree(OutputTrees[m_TopologyComponent[iDcyTr]]);
   }
-  if(m_OtherComponent.second.size() != 0) {
-    SaveTree(InTree, m_OtherComponent.first, m_OtherComponent.second);
+  for(std::size_t i = 0; i < Components.size(); i++) {
+    if(OutputTrees[i]) {
+      OutputFiles[i]->cd();
+      OutputTrees[i]->Write();
+      OutputFiles[i]->Close();
+    }
   }
+  InTree->ResetBranchAddresses();
 }
@@ -0,0 +1,81 @@
+// Martin Duy Tat 19th October 2026
+
+#include<vector>
+#include<string>
+#include<stdexcept>
+#include"TMatrixT.h"
+#include"TMatrixTSym.h"
+#include"TDecompChol.h"
+#include"TRandom.h"
+#include"RooArgSet.h"
+#include"RooDataSet.h"
+#include"RooRealVar.h"
+#include"RooRandom.h"
+#include"ToyGenerator.h"
+
+ToyGenerator::ToyGenerator(const TMatrixTSym<double> &CovMatrix, int EventsPerToy): m_CholeskyMatrixT(GetCholeskyDecomposition(CovMatrix)),
+										      m_EventsPerToy(EventsPerToy),
+										      m_NumberToys(0) {
+  if(m_EventsPerToy <= 0) {
+    throw std::invalid_argument("Number of events per toy must be positive");
+  }
+}
+
+void ToyGenerator::Generate(const std::vector<double> &Mean, int NumberToys) {
+  int Dimension = m_CholeskyMatrixT.GetNrows();
+  if(static_cast<int>(Mean.size()) != Dimension) {
+    throw std::invalid_argument("Mean vector and covariance matrix have different dimensions");
+  }
+  m_NumberToys = NumberToys;
+  // Fill an (events x dimension) matrix with standard normal numbers
+  TMatrixT<double> Normals(m_NumberToys*m_EventsPerToy, Dimension);
+  TRandom *Random = RooRandom::randomGenerator();
+  double *NormalsArray = Normals.GetMatrixArray();
+  for(int i = 0; i < Normals.GetNoElements(); i++) {
+    NormalsArray[i] = Random->Gaus(0.0, 1.0);
+  }
+  // Each row z is transformed as z*U, where U is the upper triangular Cholesky matrix, so that the covariance is U^T*U
+  m_Toys.ResizeTo(Normals.GetNrows(), Dimension);
+  m_Toys.Mult(Normals, m_CholeskyMatrixT);
+  double *ToysArray = m_Toys.GetMatrixArray();
+  for(int i = 0; i < m_Toys.GetNrows(); i++) {
+    for(int j = 0; j < Dimension; j++) {
+      ToysArray[i*Dimension + j] += Mean[j];
+    }
+  }
+}
+
+int ToyGenerator::GetNumberToys() const {
+  return m_NumberToys;
+}
+
+const double* ToyGenerator::GetToy(int Toy) const {
+  if(Toy < 0 || Toy >= m_NumberToys) {
+    throw std::out_of_range("Toy " + std::to_string(Toy) + " has not been generated");
+  }
+  return m_Toys.GetMatrixArray() + static_cast<std::size_t>(Toy)*m_EventsPerToy*m_Toys.GetNcols();
+}
+
+void ToyGenerator::FillDataSet(int Toy, RooDataSet &Data, RooArgSet &Variables) const {
+  int Dimension = m_Toys.GetNcols();
+  if(Variables.getSize() != Dimension) {
+    throw std::invalid_argument("Number of variables does not match the dimension of the toys");
+  }
+  const double *ToyArray = GetToy(Toy);
+  Data.reset();
+  for(int i = 0; i < m_EventsPerToy; i++) {
+    for(int j = 0; j < Dimension; j++) {
+      static_cast<RooRealVar*>(Variables[j])->setVal(ToyArray[i*Dimension + j]);
+    }
+    Data.add(Variables);
+  }
+}
+
+TMatrixT<double> ToyGenerator::GetCholeskyDecomposition(const TMatrixTSym<double> &CovMatrix) {
+  TDecompChol CholeskyDecomposition(CovMatrix);
+  bool Success = CholeskyDecomposition.Decompose();
+  if(!Success) {
+    throw std::runtime_error("Covariance matrix not positive definite");
+  }
+  return CholeskyDecomposition.GetU();
+}
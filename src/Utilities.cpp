@@ -2,11 +2,25 @@
 
 #include<iostream>
 #include<fstream>
+#include<sstream>
 #include<string>
+#include<vector>
+#include<map>
+#include<utility>
+#include<memory>
+#include<algorithm>
 #include<regex>
 #include<stdexcept>
+#include<cstdlib>
+#include<cstdio>
+#include<sys/stat.h>
+#include<unistd.h>
 #include"TChain.h"
 #include"TTree.h"
+#include"TFile.h"
+#include"TROOT.h"
+#include"ROOT/TProcessExecutor.hxx"
+#include"ROOT/TSeq.hxx"
 #include"TEntryList.h"
 #include"RooRealVar.h"
 #include"Utilities.h"
@@ -15,13 +29,168 @@
 #include"TruthMatchingCuts.h"
 #include"Settings.h"
 #include"Unique.h"
+#include"Instrumentation.h"
+#include"OutputWriter.h"
+#include"ParallelNLL.h"
 #include"PhaseSpace/KKpipi_PhaseSpace.h"
 #include"PhaseSpace/KKpipi_vs_CP_PhaseSpace.h"
 #include"PhaseSpace/KKpipi_vs_Flavour_PhaseSpace.h"
 #include"PhaseSpace/KKpipi_vs_K0hh_PhaseSpace.h"
 
 namespace Utilities {
-  void LoadChain(TChain *Chain, int NumberFiles, const std::string &Filename, const std::string &TreeName) {
+  namespace {
+    /**
+     * Number of entries of a tree in a file, and the modification time and size of the file when it was counted
+     */
+    struct ChainIndexEntry {
+      long long ModificationTime = 0;
+      long long Size = 0;
+      Long64_t Entries = -1;
+    };
+
+    /**
+     * The chain index maps the tree name and path of each file to its entry
+     */
+    using ChainIndex = std::map<std::pair<std::string, std::string>, ChainIndexEntry>;
+
+    /**
+     * Get the modification time in nanoseconds and the size of a local file, and return false if it cannot be found
+     */
+    bool GetFileStatus(const std::string &Path, long long &ModificationTime, long long &Size) {
+      struct stat Status;
+      if(stat(Path.c_str(), &Status) != 0) {
+	return false;
+      }
+      ModificationTime = static_cast<long long>(Status.st_mtim.tv_sec)*1000000000LL + Status.st_mtim.tv_nsec;
+      Size = Status.st_size;
+      return true;
+    }
+
+    /**
+     * Read the chain index, where each line is the tree name, modification time, size, number of entries and path
+     */
+    ChainIndex ReadChainIndex(const std::string &IndexFilename) {
+      ChainIndex Index;
+      std::ifstream Infile(IndexFilename);
+      std::string Line;
+      while(std::getline(Infile, Line)) {
+	std::stringstream ss(Line);
+	std::string TreeName, Path;
+	ChainIndexEntry Entry;
+	if(ss >> TreeName >> Entry.ModificationTime >> Entry.Size >> Entry.Entries && std::getline(ss >> std::ws, Path)) {
+	  Index[{TreeName, Path}] = Entry;
+	}
+      }
+      return Index;
+    }
+
+    /**
+     * Write the chain index to a temporary file that is renamed, so that jobs reading the index never see half a file
+     */
+    void WriteChainIndex(const std::string &IndexFilename, const ChainIndex &Index) {
+      std::string TemporaryFilename = IndexFilename + ".tmp" + std::to_string(getpid());
+      std::ofstream Outfile(TemporaryFilename);
+      for(const auto &Entry : Index) {
+	Outfile << Entry.first.first << " " << Entry.second.ModificationTime << " " << Entry.second.Size << " " << Entry.second.Entries << " " << Entry.first.second << "\n";
+      }
+      Outfile.close();
+      if(!Outfile || std::rename(TemporaryFilename.c_str(), IndexFilename.c_str()) != 0) {
+	std::remove(TemporaryFilename.c_str());
+	std::cout << "WARNING: Could not write chain index " << IndexFilename << "\n";
+      }
+    }
+
+    /**
+     * Count the entries of a tree in a file, which is -1 if the file or tree cannot be opened
+     */
+    Long64_t CountEntries(const std::string &Path, const std::string &TreeName) {
+      std::unique_ptr<TFile> File{TFile::Open(Path.c_str(), "READ")};
+      if(!File || File->IsZombie()) {
+	return -1;
+      }
+      TTree *Tree = nullptr;
+      File->GetObject(TreeName.c_str(), Tree);
+      return Tree ? Tree->GetEntries() : -1;
+    }
+
+    /**
+     * Add files to a TChain with their number of entries, so that the TChain does not open them to find the tree offsets
+     * The entries are taken from the chain index if the file has not changed, and the rest are counted in parallel
+     * Paths with wildcards, and files that cannot be counted, are added in the usual way
+     */
+    void AddFilesToChain(TChain *Chain, const std::vector<std::string> &Filenames, const std::string &IndexFilename, int NumberCPUs) {
+      Instrumentation::ScopedTimer Timer("Utilities::LoadChain");
+      Timer.AddEvents(Filenames.size());
+      const std::string TreeName = Chain->GetName();
+      ChainIndex Index = ReadChainIndex(IndexFilename);
+      std::vector<Long64_t> Entries(Filenames.size(), -1);
+      std::vector<ChainIndexEntry> FileStatus(Filenames.size());
+      std::vector<bool> IsLocal(Filenames.size(), false);
+      std::vector<std::size_t> ToCount;
+      for(std::size_t i = 0; i < Filenames.size(); i++) {
+	if(Filenames[i].find_first_of("*?[") != std::string::npos) {
+	  continue;
+	}
+	IsLocal[i] = GetFileStatus(Filenames[i], FileStatus[i].ModificationTime, FileStatus[i].Size);
+	auto iter = Index.find({TreeName, Filenames[i]});
+	if(IsLocal[i] && iter != Index.end() && iter->second.ModificationTime == FileStatus[i].ModificationTime && iter->second.Size == FileStatus[i].Size) {
+	  Entries[i] = iter->second.Entries;
+	} else {
+	  ToCount.push_back(i);
+	}
+      }
+      Instrumentation::AddCount("ChainFilesCached", Filenames.size() - ToCount.size());
+      Instrumentation::AddCount("ChainFilesCounted", ToCount.size());
+      if(!ToCount.empty()) {
+	// Opening files is limited by the latency of the file system, so each worker opens a range of files
+	// Forking with an active thread pool is not safe, so files are counted serially when implicit multithreading is switched on
+	int Workers = ROOT::IsImplicitMTEnabled() ? 1 : ParallelNLL::GetAvailableCPUs(NumberCPUs);
+	Workers = std::max(1, std::min(Workers, static_cast<int>(ToCount.size())));
+	auto CountRange = [&] (int Worker) {
+	  std::vector<Long64_t> Counts;
+	  const std::size_t First = Worker*ToCount.size()/Workers;
+	  const std::size_t Last = (Worker + 1)*ToCount.size()/Workers;
+	  for(std::size_t j = First; j < Last; j++) {
+	    Counts.push_back(CountEntries(Filenames[ToCount[j]], TreeName));
+	  }
+	  return Counts;
+	};
+	std::vector<std::vector<Long64_t>> Results;
+	if(Workers == 1) {
+	  Results.push_back(CountRange(0));
+	} else {
+	  ROOT::TProcessExecutor Executor(Workers);
+	  Results = Executor.Map(CountRange, ROOT::TSeqI(Workers));
+	}
+	std::size_t j = 0;
+	bool IndexChanged = false;
+	for(const auto &Result : Results) {
+	  for(auto Count : Result) {
+	    const std::size_t i = ToCount[j++];
+	    Entries[i] = Count;
+	    if(IsLocal[i] && Count >= 0) {
+	      ChainIndexEntry Entry = FileStatus[i];
+	      Entry.Entries = Count;
+	      Index[{TreeName, Filenames[i]}] = Entry;
+	      IndexChanged = true;
+	    }
+	  }
+	}
+	if(IndexChanged) {
+	  WriteChainIndex(IndexFilename, Index);
+	}
+      }
+      for(std::size_t i = 0; i < Filenames.size(); i++) {
+	if(Entries[i] > 0) {
+	  Chain->Add(Filenames[i].c_str(), Entries[i]);
+	} else {
+	  Chain->Add(Filenames[i].c_str());
+	}
+      }
+    }
+  }
+
+  void LoadChain(TChain *Chain, int NumberFiles, const std::string &Filename, const std::string &TreeName, int NumberCPUs) {
     std::cout << "Initializing TChain with files...\n";
     if(TreeName != "") {
       Chain->SetName(TreeName.c_str());
@@ -30,24 +199,30 @@ namespace Utilities {
       std::cout << "Need more than 0 input files...\n";
       return;
     }
+    std::vector<std::string> Filenames;
     for(int i = 0; i < NumberFiles; i++) {
-      Chain->Add((Filename + std::to_string(i) + ".root").c_str());
+      Filenames.push_back(Filename + std::to_string(i) + ".root");
     }
+    AddFilesToChain(Chain, Filenames, Filename + ".index", NumberCPUs);
     std::cout << "ROOT files added to TChain\n";
     return;
   }
 
-  void LoadChain(TChain *Chain, const std::string &Filename, const std::string &TreeName) {
+  void LoadChain(TChain *Chain, const std::string &Filename, const std::string &TreeName, int NumberCPUs) {
     std::cout << "Initializing TChain with files...\n";
     if(TreeName != "") {
       Chain->SetName(TreeName.c_str());
     }
     std::ifstream Infile(Filename);
     std::string line;
+    std::vector<std::string> Filenames;
     while(std::getline(Infile, line)) {
-      Chain->Add(line.c_str());
+      if(!line.empty()) {
+	Filenames.push_back(line);
+      }
     }
     Infile.close();
+    AddFilesToChain(Chain, Filenames, Filename + ".index", NumberCPUs);
     std::cout << "ROOT files added to TChain\n";
     return;
   }
@@ -124,6 +299,14 @@ namespace Utilities {
 	i = i + 2; // don't process args with key/value
       }   
     }
+    // Switch on timers and counters if a summary file is requested
+    if(settings.contains("InstrumentationOutput")) {
+      Instrumentation::Enable(settings.get("InstrumentationOutput"), argv[0]);
+    } else if(std::getenv("KKPIPI_INSTRUMENTATION")) {
+      Instrumentation::Enable(std::getenv("KKPIPI_INSTRUMENTATION"), argv[0]);
+    }
+    // Compression and basket settings of the output files
+    OutputWriter::Configure(settings);
     return settings;
   }
 
@@ -7,13 +7,17 @@
 #include"TMatrixT.h"
 #include"RooRealVar.h"
 #include"RooGaussian.h"
-#include"RooMultiVarGaussian.h"
 #include"RooArgList.h"
 #include"cisiK0pipi.h"
+#include"CholeskyGaussianConstraint.h"
 #include"Unique.h"
 #include"Settings.h"
 
 void cisiK0pipi::Initialise(const Settings &settings) {
+  m_NumberBins = settings["KSpipi_BinningScheme"].getI("NumberBins");
+  if(settings["KLpipi_BinningScheme"].getI("NumberBins") != m_NumberBins) {
+    throw std::invalid_argument("KSpipi and KLpipi must have the same number of bins");
+  }
   // First initialise Ki
   InitialiseKi(settings, "KSpipi");
   InitialiseKi(settings, "KLpipi");
@@ -24,7 +28,7 @@ void cisiK0pipi::Initialise(const Settings &settings) {
 }
 
 void cisiK0pipi::InitialiseKi(const Settings &settings, const std::string &TagMode) {
-  for(int i = 1; i <= 8; i++) {
+  for(int i = 1; i <= m_NumberBins; i++) {
     std::string pName = TagMode + "_K_p" + std::to_string(i);
     std::string mName = TagMode + "_K_m" + std::to_string(i);
     double Ki = settings[TagMode + "_BinningScheme"]["Ki"].getD(pName);
@@ -56,52 +60,53 @@ void cisiK0pipi::InitialiseKi(const Settings &settings, const std::string &TagMo
 }
 
 void cisiK0pipi::Initialisecisi(const Settings &settings) {
-  RooArgList cisi_Mean;
+  std::vector<double> cisi_Mean;
   std::vector<double> cisi_Sigma;
   std::vector<std::string> TagModes{"KSpipi", "KLpipi"};
   std::vector<std::string> c_or_s{"c", "s"};
   for(const auto &Tag : TagModes) {
     for(const auto &cs : c_or_s) {
-      for(int i = 1; i <= 8; i++) {
+      for(int i = 1; i <= m_NumberBins; i++) {
 	std::string Name = Tag + "_" + cs + std::to_string(i);
 	double cisi = settings[Tag + "_BinningScheme"]["cisi"].getD(Name);
 	double cisi_err = settings[Tag + "_BinningScheme"]["cisi"].getD(Name + "_err");
-	auto Mean = Unique::create<RooRealVar*>((Name + "_Mean").c_str(), "", cisi);
+	cisi_Mean.push_back(cisi);
 	cisi_Sigma.push_back(cisi_err);
 	auto Var = Unique::create<RooRealVar*>((Name + "_Var").c_str(), "", cisi, -1.5, 1.5);
 	Var->setConstant(true);
-	cisi_Mean.add(*Mean);
 	m_cisi.add(*Var);
       }
     }
   }
   auto CorrMatrix = ParseCorrelationMatrix(settings);
-  TMatrixDSym CovMatrix(32);
-  for(int i = 0; i < 32; i++) {
-    for(int j = 0; j < 32; j++) {
+  const int Size = cisi_Mean.size();
+  TMatrixT<double> CovMatrix(Size, Size);
+  for(int i = 0; i < Size; i++) {
+    for(int j = 0; j < Size; j++) {
       CovMatrix(i, j) = CorrMatrix(i, j)*cisi_Sigma[i]*cisi_Sigma[j];
     }
   }
-  auto cisi_Gaussian = Unique::create<RooMultiVarGaussian*>("K0pipi_cisi_Gaussian", "", m_cisi, cisi_Mean, CovMatrix);
+  // The Cholesky factor is computed once here, so the constraint is cheap to evaluate for any number of bins
+  auto cisi_Gaussian = Unique::create<CholeskyGaussianConstraint*>("K0pipi_cisi_Gaussian", "", m_cisi, cisi_Mean, CovMatrix);
   m_GaussianConstraintPDFs.push_back(cisi_Gaussian);
 }
 
 TMatrixT<double> cisiK0pipi::ParseCorrelationMatrix(const Settings &settings) const {
-  TMatrixT<double> CorrMatrix(32, 32);
-  std::ifstream CorrFile(settings.get("KSpipi_KLpipi_cisi_Correlation"));
-  for(int i = 0; i < 32; i++) {
-    std::string Line;
-    std::getline(CorrFile, Line);
-    std::stringstream ss(Line);
-    for(int j = 0; j < 32; j++) {
-      if(j >= i) {
-	double Value;
-	ss >> Value;
-	Value /= 100.0;
-	CorrMatrix(i, j) = Value;
-      } else {
-	CorrMatrix(i, j) = CorrMatrix(j, i);
+  const int Size = 4*m_NumberBins;
+  TMatrixT<double> CorrMatrix(Size, Size);
+  std::string Filename = settings.get("KSpipi_KLpipi_cisi_Correlation");
+  std::ifstream CorrFile(Filename);
+  if(!CorrFile.is_open()) {
+    throw std::runtime_error("Cannot open correlation matrix file " + Filename);
+  }
+  // Row i of the upper triangle has Size - i numbers, so the values can be read in sequence regardless of line breaks
+  for(int i = 0; i < Size; i++) {
+    for(int j = i; j < Size; j++) {
+      double Value;
+      if(!(CorrFile >> Value)) {
+	throw std::runtime_error("Correlation matrix in " + Filename + " has fewer entries than " + std::to_string(Size) + " parameters need");
       }
+      CorrMatrix(i, j) = CorrMatrix(j, i) = Value/100.0;
     }
   }
   CorrFile.close();